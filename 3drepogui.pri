@@ -28,14 +28,32 @@ HEADERS +=  \
 	src/repo/gui/primitives/repo_idbcache.h \
 	src/repo/gui/primitives/repo_sort_filter_proxy_model.h \
 	src/repo/gui/primitives/repo_standard_item.h \
+	src/repo/gui/renderers/repo_accumulation_buffer.h \
+	src/repo/gui/renderers/repo_batch_renderer.h \
 	src/repo/gui/renderers/repo_fpscounter.h \
+	src/repo/gui/renderers/repo_frame_governor.h \
+	src/repo/gui/renderers/repo_frame_profiler.h \
+	src/repo/gui/renderers/repo_geometry_registry.h \
+	src/repo/gui/renderers/repo_geometry_streamer.h \
+	src/repo/gui/renderers/repo_image_stream_writer.h \
+	src/repo/gui/renderers/repo_line_overlay.h \
+	src/repo/gui/renderers/repo_mesh_batch.h \
+	src/repo/gui/renderers/repo_mesh_codec.h \
+	src/repo/gui/renderers/repo_occlusion_culler.h \
+	src/repo/gui/renderers/repo_pixel_readback.h \
+	src/repo/gui/renderers/repo_point_cloud.h \
+	src/repo/gui/renderers/repo_render_queue.h \
 	src/repo/gui/renderers/repo_renderer_abstract.h \
 	src/repo/gui/renderers/repo_renderer_glc.h \
 	src/repo/gui/renderers/repo_renderer_graph.h \
+	src/repo/gui/renderers/repo_shader_cache.h \
+	src/repo/gui/renderers/repo_visibility_index.h \
 	src/repo/gui/renderers/repo_webview.h \
 	src/repo/gui/widgets/repo_line_edit.h \
+	src/repo/gui/widgets/repo_linked_camera.h \
 	src/repo/gui/widgets/repo_mdi_area.h \
 	src/repo/gui/widgets/repo_mdi_subwindow.h \
+	src/repo/gui/widgets/repo_memory_budget_manager.h \
 	src/repo/gui/widgets/repo_text_browser.h \
 	src/repo/gui/widgets/repo_widget_flags.h \
 	src/repo/gui/widgets/repo_widget_manager_3ddiff.h \
@@ -67,14 +85,20 @@ HEADERS +=  \
 	src/repo/workers/repo_worker_diff.h \
 	src/repo/workers/repo_worker_file_export.h \
 	src/repo/workers/repo_worker_file_import.h \
+	src/repo/workers/repo_worker_geometry_stream.h \
 	src/repo/workers/repo_worker_glc_export.h \
 	src/repo/workers/repo_worker_history.h \
+	src/repo/workers/repo_worker_mesh_bounding_boxes.h \
+	src/repo/workers/repo_worker_mesh_index.h \
 	src/repo/workers/repo_worker_modified_nodes.h \
 	src/repo/workers/repo_worker_optimize.h \
+	src/repo/workers/repo_worker_point_cloud.h \
 	src/repo/workers/repo_worker_projects.h \
 	src/repo/workers/repo_worker_project_settings.h \
 	src/repo/workers/repo_worker_roles.h \
 	src/repo/workers/repo_worker_scene_graph.h \
+	src/repo/workers/repo_worker_scene_mesh.h \
+	src/repo/workers/repo_worker_scene_partitioning.h \
 	src/repo/workers/repo_worker_users.h
 
 SOURCES +=  \
@@ -102,14 +126,32 @@ SOURCES +=  \
 	src/repo/gui/primitives/repo_idbcache.cpp \
 	src/repo/gui/primitives/repo_sort_filter_proxy_model.cpp \
 	src/repo/gui/primitives/repo_standard_item.cpp \
+	src/repo/gui/renderers/repo_accumulation_buffer.cpp \
+	src/repo/gui/renderers/repo_batch_renderer.cpp \
 	src/repo/gui/renderers/repo_fpscounter.cpp \
+	src/repo/gui/renderers/repo_frame_governor.cpp \
+	src/repo/gui/renderers/repo_frame_profiler.cpp \
+	src/repo/gui/renderers/repo_geometry_registry.cpp \
+	src/repo/gui/renderers/repo_geometry_streamer.cpp \
+	src/repo/gui/renderers/repo_image_stream_writer.cpp \
+	src/repo/gui/renderers/repo_line_overlay.cpp \
+	src/repo/gui/renderers/repo_mesh_batch.cpp \
+	src/repo/gui/renderers/repo_mesh_codec.cpp \
+	src/repo/gui/renderers/repo_occlusion_culler.cpp \
+	src/repo/gui/renderers/repo_pixel_readback.cpp \
+	src/repo/gui/renderers/repo_point_cloud.cpp \
+	src/repo/gui/renderers/repo_render_queue.cpp \
 	src/repo/gui/renderers/repo_renderer_abstract.cpp \
 	src/repo/gui/renderers/repo_renderer_glc.cpp \
 	src/repo/gui/renderers/repo_renderer_graph.cpp \
+	src/repo/gui/renderers/repo_shader_cache.cpp \
+	src/repo/gui/renderers/repo_visibility_index.cpp \
 	src/repo/gui/renderers/repo_webview.cpp \
 	src/repo/gui/widgets/repo_line_edit.cpp \
+	src/repo/gui/widgets/repo_linked_camera.cpp \
 	src/repo/gui/widgets/repo_mdi_area.cpp \
 	src/repo/gui/widgets/repo_mdi_subwindow.cpp \
+	src/repo/gui/widgets/repo_memory_budget_manager.cpp \
 	src/repo/gui/widgets/repo_text_browser.cpp \
 	src/repo/gui/widgets/repo_widget_flags.cpp \
 	src/repo/gui/widgets/repo_widget_manager_3ddiff.cpp \
@@ -140,14 +182,20 @@ SOURCES +=  \
 	src/repo/workers/repo_worker_diff.cpp \
 	src/repo/workers/repo_worker_file_export.cpp \
 	src/repo/workers/repo_worker_file_import.cpp \
+	src/repo/workers/repo_worker_geometry_stream.cpp \
 	src/repo/workers/repo_worker_glc_export.cpp \
 	src/repo/workers/repo_worker_history.cpp \
+	src/repo/workers/repo_worker_mesh_bounding_boxes.cpp \
+	src/repo/workers/repo_worker_mesh_index.cpp \
 	src/repo/workers/repo_worker_modified_nodes.cpp \
 	src/repo/workers/repo_worker_optimize.cpp \
+	src/repo/workers/repo_worker_point_cloud.cpp \
 	src/repo/workers/repo_worker_projects.cpp \
 	src/repo/workers/repo_worker_project_settings.cpp \
 	src/repo/workers/repo_worker_roles.cpp \
 	src/repo/workers/repo_worker_scene_graph.cpp \
+	src/repo/workers/repo_worker_scene_mesh.cpp \
+	src/repo/workers/repo_worker_scene_partitioning.cpp \
 	src/repo/workers/repo_worker_users.cpp
 
 FORMS +=  \
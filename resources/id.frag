@@ -0,0 +1,8 @@
+
+varying vec4    v_id_color;
+
+void main()
+{
+    // Unlit and unblended so that every channel reaches the framebuffer as is
+    gl_FragColor= v_id_color;
+}
@@ -0,0 +1,27 @@
+// Writes component IDs of false colour images, all 32 bits of them.
+// The low 24 bits come as the diffuse colour, the high 8 bits inverted as
+// the emissive red, since GLC replaces the alpha of material colours by
+// their opacity.
+
+struct material{
+    vec4    ambient_color;
+    vec4    diffuse_color;
+    vec4    specular_color;
+    vec4    emissive_color;
+    float   specular_exponent;
+};
+
+// Matrix
+uniform mat4    mvp_matrix;            // Combined model view + projection matrix
+
+uniform material    material_state;
+
+attribute vec4  a_position;
+
+varying vec4    v_id_color;
+
+void main()
+{
+    v_id_color= vec4(material_state.diffuse_color.rgb, material_state.emissive_color.r);
+    gl_Position= mvp_matrix * a_position;
+}
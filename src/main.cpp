@@ -19,20 +19,29 @@
 
 #include <QApplication>
 #include <QResource>
+#include <QScopedPointer>
 
 #include <repo/repo_controller.h>
 #include <repo/lib/repo_listener_abstract.h>
 
 #include "repo/gui/repo_gui.h"
+#include "repo/gui/renderers/repo_batch_renderer.h"
 #include "repo/logger/repo_logger.h"
 
 
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
-//    a.setAttribute(Qt::AA_UseDesktopOpenGL); // Qt5.5 support
-    a.setAttribute(Qt::AA_ShareOpenGLContexts); // https://blog.qt.io/blog/2014/09/10/qt-weekly-19-qopenglwidget/
+    // Batch mode renders offscreen without any widgets
+    const bool isBatch = repo::gui::renderer::RepoBatchRenderer::isBatch(argc, argv);
+
+    // Only honoured when set before the application is constructed
+//    QCoreApplication::setAttribute(Qt::AA_UseDesktopOpenGL); // Qt5.5 support
+    QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts); // https://blog.qt.io/blog/2014/09/10/qt-weekly-19-qopenglwidget/
+
+    QScopedPointer<QGuiApplication> a(isBatch ?
+                                          new QGuiApplication(argc, argv) :
+                                          new QApplication(argc, argv));
 
     QCoreApplication::setOrganizationName("3D Repo");
     QCoreApplication::setOrganizationDomain("3drepo.org");
@@ -64,11 +73,14 @@ int main(int argc, char *argv[])
 
 	if (verbose) free(verbose);
 	if (debug)   free(debug);
+
+    if (isBatch)
+        return repo::gui::renderer::RepoBatchRenderer::exec(controller);
 	
     repo::gui::RepoGUI w(controller);
 
     w.show();
     w.startup();
-    return a.exec();
+    return a->exec();
 }
 
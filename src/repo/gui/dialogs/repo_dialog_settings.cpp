@@ -19,6 +19,13 @@
 #include "repo_dialog_settings.h"
 #include "ui_repo_dialog_settings.h"
 #include "../primitives/repo_fontawesome.h"
+#include "../renderers/repo_accumulation_buffer.h"
+#include "../renderers/repo_frame_governor.h"
+#include "../renderers/repo_geometry_streamer.h"
+#include "../renderers/repo_point_cloud.h"
+#include "../widgets/repo_memory_budget_manager.h"
+
+#include <QSettings>
 
 using namespace repo::gui::dialog;
 
@@ -60,6 +67,34 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
                       repo::gui::primitive::RepoFontAwesome::fa_upload, QColor(Qt::darkGreen)));
     options.append(item);
 
+    //--------------------------------------------------------------------------
+    // Rendering
+    item = new QStandardItem(tr("Rendering"));
+    item->setEditable(false);
+    item->setIcon(repo::gui::primitive::RepoFontAwesome::getInstance().getIcon(
+                      repo::gui::primitive::RepoFontAwesome::fa_cube, QColor(Qt::darkBlue)));
+    options.append(item);
+
+    QSettings settings;
+    ui->targetFPSSpinBox->setValue(settings.value(
+        repo::gui::renderer::RepoFrameGovernor::REPO_SETTINGS_TARGET_FPS,
+        ui->targetFPSSpinBox->value()).toInt());
+    ui->memoryBudgetSpinBox->setValue(settings.value(
+        repo::gui::widget::RepoMemoryBudgetManager::REPO_SETTINGS_MEMORY_BUDGET,
+        ui->memoryBudgetSpinBox->value()).toInt());
+    ui->offscreenSamplesSpinBox->setValue(settings.value(
+        repo::gui::renderer::RepoAccumulationBuffer::REPO_SETTINGS_OFFSCREEN_SAMPLES,
+        ui->offscreenSamplesSpinBox->value()).toInt());
+    ui->pointBudgetSpinBox->setValue(settings.value(
+        repo::gui::renderer::RepoPointCloud::REPO_SETTINGS_POINT_BUDGET,
+        ui->pointBudgetSpinBox->value()).toInt());
+    ui->streamGeometryCheckBox->setChecked(settings.value(
+        repo::gui::renderer::RepoGeometryStreamer::REPO_SETTINGS_STREAM_GEOMETRY,
+        ui->streamGeometryCheckBox->isChecked()).toBool());
+    ui->streamBudgetSpinBox->setValue(settings.value(
+        repo::gui::renderer::RepoGeometryStreamer::REPO_SETTINGS_STREAM_BUDGET,
+        ui->streamBudgetSpinBox->value()).toInt());
+
 //    //--------------------------------------------------------------------------
 //    // Oculus VR
 //    item = new QStandardItem(tr("Oculus VR"));
@@ -87,6 +122,20 @@ SettingsDialog::~SettingsDialog()
 void SettingsDialog::apply()
 {
     ui->assimpFlagsWidget->apply();
+
+    QSettings settings;
+    settings.setValue(repo::gui::renderer::RepoFrameGovernor::REPO_SETTINGS_TARGET_FPS,
+                      ui->targetFPSSpinBox->value());
+    settings.setValue(repo::gui::widget::RepoMemoryBudgetManager::REPO_SETTINGS_MEMORY_BUDGET,
+                      ui->memoryBudgetSpinBox->value());
+    settings.setValue(repo::gui::renderer::RepoAccumulationBuffer::REPO_SETTINGS_OFFSCREEN_SAMPLES,
+                      ui->offscreenSamplesSpinBox->value());
+    settings.setValue(repo::gui::renderer::RepoPointCloud::REPO_SETTINGS_POINT_BUDGET,
+                      ui->pointBudgetSpinBox->value());
+    settings.setValue(repo::gui::renderer::RepoGeometryStreamer::REPO_SETTINGS_STREAM_GEOMETRY,
+                      ui->streamGeometryCheckBox->isChecked());
+    settings.setValue(repo::gui::renderer::RepoGeometryStreamer::REPO_SETTINGS_STREAM_BUDGET,
+                      ui->streamBudgetSpinBox->value());
 }
 
 void SettingsDialog::changeOptionsPane(const QModelIndex &index)
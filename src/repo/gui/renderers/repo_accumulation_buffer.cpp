@@ -0,0 +1,112 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_accumulation_buffer.h"
+
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+//------------------------------------------------------------------------------
+#include <QSettings>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+const QString RepoAccumulationBuffer::REPO_SETTINGS_OFFSCREEN_SAMPLES = "RepoGUI/offscreenSamples";
+
+//! Passes when not set, enough to hide most stair stepping.
+static const int REPO_ACCUMULATION_DEFAULT_SAMPLES = 8;
+
+RepoAccumulationBuffer::RepoAccumulationBuffer(int width, int height)
+    : width(width)
+    , height(height)
+    , passes(0)
+    , sums((size_t) width * height * 4, 0.0f)
+{}
+
+RepoAccumulationBuffer::~RepoAccumulationBuffer() {}
+
+int RepoAccumulationBuffer::getSampleCount()
+{
+    QSettings settings;
+    const int samples = settings.value(
+                REPO_SETTINGS_OFFSCREEN_SAMPLES,
+                REPO_ACCUMULATION_DEFAULT_SAMPLES).toInt();
+    return std::max(1, std::min(MAX_SAMPLES, samples));
+}
+
+double RepoAccumulationBuffer::halton(int index, int base)
+{
+    double result = 0;
+    double fraction = 1.0 / base;
+    for (; index > 0; index /= base, fraction /= base)
+        result += fraction * (index % base);
+    return result;
+}
+
+QPointF RepoAccumulationBuffer::getJitter(int pass)
+{
+    return pass <= 0 ? QPointF() :
+                       QPointF(halton(pass, 2) - 0.5, halton(pass, 3) - 0.5);
+}
+
+void RepoAccumulationBuffer::accumulate(const QImage &image)
+{
+    const QImage argb = image.convertToFormat(QImage::Format_ARGB32);
+    if (argb.width() != width || argb.height() != height)
+        return;
+
+    float *sum = sums.data();
+    for (int y = 0; y < height; ++y)
+    {
+        const QRgb *pixel = (const QRgb *) argb.constScanLine(y);
+        for (int x = 0; x < width; ++x, sum += 4)
+        {
+            sum[0] += qAlpha(pixel[x]);
+            sum[1] += qRed(pixel[x]);
+            sum[2] += qGreen(pixel[x]);
+            sum[3] += qBlue(pixel[x]);
+        }
+    }
+    ++passes;
+}
+
+QImage RepoAccumulationBuffer::resolve() const
+{
+    QImage image(width, height, QImage::Format_ARGB32);
+    if (!passes)
+    {
+        image.fill(Qt::transparent);
+        return image;
+    }
+
+    const float scale = 1.0f / passes;
+    const float *sum = sums.data();
+    for (int y = 0; y < height; ++y)
+    {
+        QRgb *pixel = (QRgb *) image.scanLine(y);
+        for (int x = 0; x < width; ++x, sum += 4)
+        {
+            pixel[x] = qRgba((int) std::lround(sum[1] * scale),
+                             (int) std::lround(sum[2] * scale),
+                             (int) std::lround(sum[3] * scale),
+                             (int) std::lround(sum[0] * scale));
+        }
+    }
+    return image;
+}
@@ -0,0 +1,86 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <vector>
+
+#include <QImage>
+#include <QPointF>
+#include <QString>
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+/**
+ * Float accumulation of sub-pixel jittered passes for anti-aliasing
+ * offscreen renders, where multisampled framebuffers cannot be used.
+ *
+ * Passes are summed on the CPU so that nothing beyond a plain 8-bit
+ * framebuffer is needed from the driver, software ones included.
+ */
+class RepoAccumulationBuffer
+{
+
+public:
+
+    //! Settings label of the number of passes per offscreen render.
+    static const QString REPO_SETTINGS_OFFSCREEN_SAMPLES;
+
+    //! Highest number of passes.
+    static const int MAX_SAMPLES = 64;
+
+    RepoAccumulationBuffer(int width, int height);
+
+    ~RepoAccumulationBuffer();
+
+    //! Returns the number of passes from the settings, 1 for no anti-aliasing.
+    static int getSampleCount();
+
+    /**
+     * Returns the sub-pixel offset of the given pass in pixels, within half
+     * a pixel of the centre. The first pass is not offset, the following
+     * ones follow the Halton (2, 3) sequence.
+     */
+    static QPointF getJitter(int pass);
+
+    //! Adds a pass, of the same size as the buffer.
+    void accumulate(const QImage &image);
+
+    //! Returns the average of the passes so far.
+    QImage resolve() const;
+
+    int getPassCount() const { return passes; }
+
+protected:
+
+    static double halton(int index, int base);
+
+    int width;
+    int height;
+    int passes;
+
+    //! Running ARGB sums, 4 floats per pixel.
+    std::vector<float> sums;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
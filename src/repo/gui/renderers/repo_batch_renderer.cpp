@@ -0,0 +1,563 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_batch_renderer.h"
+#include "repo_accumulation_buffer.h"
+#include "repo_renderer_glc.h"
+#include "../../logger/repo_logger.h"
+
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <cstring>
+#include <memory>
+//------------------------------------------------------------------------------
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QOpenGLFramebufferObject>
+#include <QProcess>
+#include <QThreadPool>
+#include <QTextStream>
+#include <QTimer>
+#include <QUuid>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+static const struct
+{
+    const char *name;
+    CameraView view;
+} REPO_BATCH_VIEWS[] = {
+    { "back", CameraView::BACK },
+    { "bottom", CameraView::BOTTOM },
+    { "front", CameraView::FRONT },
+    { "iso", CameraView::ISO },
+    { "left", CameraView::LEFT },
+    { "right", CameraView::RIGHT },
+    { "top", CameraView::TOP }
+};
+
+//! Default wait for the geometry conversion of a single job, in seconds.
+static const int REPO_BATCH_DEFAULT_TIMEOUT = 600;
+
+//! Frames to render at most while point cloud chunks are still uploading.
+static const int REPO_BATCH_MAX_WARMUP_FRAMES = 200;
+
+QString RepoBatchJob::getName() const
+{
+    if (!file.isEmpty())
+        return QFileInfo(file).completeBaseName();
+
+    QString name = database + "." + project;
+    if (!revision.isEmpty())
+        name += "." + revision;
+    return name;
+}
+
+RepoBatchRenderer::RepoBatchRenderer(
+        repo::RepoController *controller,
+        const repo::RepoController::RepoToken *token)
+    : controller(controller)
+    , token(token)
+    , imageSize(256, 256)
+    , views({ std::make_pair(QString("iso"), CameraView::ISO) })
+    , outputDirectory(".")
+    , timeout(REPO_BATCH_DEFAULT_TIMEOUT * 1000)
+    , idBuffersEnabled(false)
+{}
+
+RepoBatchRenderer::~RepoBatchRenderer()
+{
+    context.doneCurrent();
+}
+
+bool RepoBatchRenderer::isBatch(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i)
+        if (!std::strcmp(argv[i], "--batch"))
+            return true;
+    return false;
+}
+
+bool RepoBatchRenderer::getView(const QString &name, CameraView &view)
+{
+    for (const auto &entry : REPO_BATCH_VIEWS)
+    {
+        if (name.compare(entry.name, Qt::CaseInsensitive) == 0)
+        {
+            view = entry.view;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<RepoBatchJob> RepoBatchRenderer::readJobs(const QString &path)
+{
+    std::vector<RepoBatchJob> jobs;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        repoLogError("Failed to open batch jobs " + path.toStdString());
+        return jobs;
+    }
+
+    QTextStream stream(&file);
+    while (!stream.atEnd())
+    {
+        const QString line = stream.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith("#"))
+            continue;
+
+        RepoBatchJob job;
+        const QStringList parts = line.split("/");
+        if (QFileInfo(line).isFile() || parts.size() < 2 || parts.size() > 3)
+            job.file = line;
+        else
+        {
+            job.database = parts[0];
+            job.project = parts[1];
+            if (parts.size() == 3)
+                job.revision = parts[2];
+        }
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+QString RepoBatchRenderer::getReportHeader()
+{
+    return "job,view,status,load_ms,convert_ms,render_ms,write_ms,image";
+}
+
+QString RepoBatchRenderer::getReportLine(
+        const QString &job,
+        const QString &view,
+        const QString &status,
+        qint64 loadTime,
+        qint64 convertTime,
+        qint64 renderTime,
+        qint64 writeTime,
+        const QString &image)
+{
+    return QString("%1,%2,%3,%4,%5,%6,%7,%8")
+            .arg(job, view, status)
+            .arg(loadTime).arg(convertTime).arg(renderTime).arg(writeTime)
+            .arg(image);
+}
+
+bool RepoBatchRenderer::initialize()
+{
+    context.setFormat(QSurfaceFormat::defaultFormat());
+    if (!context.create())
+    {
+        repoLogError("Failed to create an OpenGL context for batch rendering.");
+        return false;
+    }
+
+    surface.setFormat(context.format());
+    surface.create();
+    if (!surface.isValid() || !context.makeCurrent(&surface))
+    {
+        repoLogError("Failed to create an offscreen surface for batch rendering.");
+        return false;
+    }
+    return true;
+}
+
+repo::core::model::RepoScene *RepoBatchRenderer::loadScene(const RepoBatchJob &job)
+{
+    if (!job.file.isEmpty())
+    {
+        repo::settings::RepoSettings settings;
+        return controller->loadSceneFromFile(
+                    job.file.toStdString(), true,
+                    "fbx" == QFileInfo(job.file).suffix().toLower(), &settings);
+    }
+    else if (token)
+    {
+        const bool headRevision = job.revision.isEmpty();
+        const QUuid id = headRevision ? QUuid() : QUuid(job.revision);
+        return controller->fetchScene(
+                    token,
+                    job.database.toStdString(),
+                    job.project.toStdString(),
+                    id.toString().toStdString(),
+                    headRevision,
+                    true);
+    }
+
+    repoLogError("No database connection for " + job.getName().toStdString());
+    return nullptr;
+}
+
+QImage RepoBatchRenderer::renderImage(AbstractRenderer *renderer)
+{
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    QOpenGLFramebufferObject fbo(imageSize, format);
+    fbo.bind();
+
+    // Point cloud chunks are uploaded over several frames
+    bool pending = true;
+    const QMetaObject::Connection connection = QObject::connect(
+                renderer, &AbstractRenderer::repaintNeeded, [&]() { pending = true; });
+    for (int frame = 0; pending && frame < REPO_BATCH_MAX_WARMUP_FRAMES; ++frame)
+    {
+        pending = false;
+        renderer->render(nullptr);
+    }
+    QObject::disconnect(connection);
+
+    const int samples = RepoAccumulationBuffer::getSampleCount();
+    RepoAccumulationBuffer buffer(imageSize.width(), imageSize.height());
+    for (int pass = samples - 1; pass >= 0; --pass)
+    {
+        const QPointF jitter = RepoAccumulationBuffer::getJitter(pass);
+        renderer->setSubPixelOffset(jitter.x(), jitter.y());
+        renderer->render(nullptr);
+        buffer.accumulate(fbo.toImage());
+    }
+    renderer->setSubPixelOffset(0, 0);
+
+    fbo.release();
+    return buffer.resolve();
+}
+
+QStringList RepoBatchRenderer::render(const RepoBatchJob &job)
+{
+    const QString name = job.getName();
+    QStringList lines;
+
+    repoLog("Batch rendering " + name.toStdString());
+    QElapsedTimer timer;
+    timer.start();
+
+    //--------------------------------------------------------------------------
+    // Scene
+    std::unique_ptr<repo::core::model::RepoScene> scene(loadScene(job));
+    const qint64 loadTime = timer.restart();
+    if (!scene)
+    {
+        for (const auto &view : views)
+            lines << getReportLine(name, view.first, "load failed", loadTime, 0, 0, 0, QString());
+        return lines;
+    }
+
+    //--------------------------------------------------------------------------
+    // Geometry, converted on a worker thread as in the GUI
+    context.makeCurrent(&surface);
+    std::unique_ptr<GLCRenderer> renderer(new GLCRenderer());
+    renderer->initialize();
+    // Thumbnails need every mesh, not only those streamed in so far
+    renderer->setStreamingAllowed(false);
+    renderer->resizeWindow(imageSize.width(), imageSize.height());
+
+    bool loaded = false;
+    QEventLoop loop;
+    QObject::connect(renderer.get(), &AbstractRenderer::modelLoaded, &loop, [&]()
+    {
+        loaded = true;
+        loop.quit();
+    });
+    QTimer::singleShot(timeout, &loop, SLOT(quit()));
+
+    renderer->loadModel(scene.get(), scene->getWorldOffset());
+    if (!loaded) // shared geometry is set straight away
+        loop.exec();
+
+    // Workers read the scene, so they have to be done before it is deleted,
+    // and the point cloud has to be in before it is rendered
+    QThreadPool *pool = QThreadPool::globalInstance();
+    if (!loaded || !pool->waitForDone(std::max(0, timeout - (int) timer.elapsed())))
+        renderer->cancelOperations();
+    pool->waitForDone();
+    QCoreApplication::sendPostedEvents(renderer.get());
+    const qint64 convertTime = timer.restart();
+
+    //--------------------------------------------------------------------------
+    // Views
+    for (const auto &view : views)
+    {
+        if (!loaded)
+        {
+            lines << getReportLine(name, view.first, "timed out", loadTime, convertTime, 0, 0, QString());
+            continue;
+        }
+
+        renderer->setCamera(view.second);
+        timer.restart();
+        const QImage image = renderImage(renderer.get());
+        const qint64 renderTime = timer.restart();
+
+        const QString path = QDir(outputDirectory).filePath(name + "_" + view.first + ".png");
+        const bool saved = image.save(path);
+        const qint64 writeTime = timer.restart();
+
+        lines << getReportLine(name, view.first, saved ? "ok" : "write failed",
+                               loadTime, convertTime, renderTime, writeTime, path);
+    }
+
+    if (loaded && idBuffersEnabled)
+        lines << exportIdBuffers(name, renderer.get(), loadTime, convertTime);
+
+    // GL resources of the renderer go with the context current
+    renderer.reset();
+    return lines;
+}
+
+QString RepoBatchRenderer::exportIdBuffers(
+        const QString &name,
+        AbstractRenderer *renderer,
+        qint64 loadTime,
+        qint64 convertTime)
+{
+    const QDir directory(outputDirectory);
+    QElapsedTimer timer;
+    timer.start();
+
+    //--------------------------------------------------------------------------
+    // Images are saved as their reads complete, while later views render
+    qint64 writeTime = 0;
+    bool saved = true;
+    RepoPixelReadback readback;
+    const std::vector<QString> idMap = renderer->requestIdBuffers(
+                renderer->getSurroundingCameras(),
+                imageSize.width(), imageSize.height(),
+                readback,
+                [&](size_t view, const QImage &image)
+    {
+        QElapsedTimer writeTimer;
+        writeTimer.start();
+        const QString file = QString("%1_id_%2.png").arg(name).arg(view, 2, 10, QChar('0'));
+        saved &= image.save(directory.filePath(file));
+        writeTime += writeTimer.elapsed();
+    });
+    readback.poll(true);
+
+    //--------------------------------------------------------------------------
+    // Single table for all views
+    QElapsedTimer writeTimer;
+    writeTimer.start();
+    const QString tablePath = directory.filePath(name + "_ids.csv");
+    QFile table(tablePath);
+    if (table.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        QTextStream out(&table);
+        out << "id,mesh\n";
+        for (size_t id = 0; id < idMap.size(); ++id)
+            out << id << "," << idMap[id] << "\n";
+    }
+    else
+        saved = false;
+    writeTime += writeTimer.elapsed();
+
+    const QString status = idMap.empty() ? "ids failed" : saved ? "ok" : "write failed";
+    return getReportLine(name, "ids", status, loadTime, convertTime,
+                         timer.elapsed() - writeTime, writeTime, tablePath);
+}
+
+int RepoBatchRenderer::execParallel(
+        const QStringList &arguments,
+        const QString &reportPath,
+        int shards)
+{
+    std::vector<std::unique_ptr<QProcess>> processes;
+    for (int i = 0; i < shards; ++i)
+    {
+        QStringList shardArguments = arguments;
+        shardArguments << "--shard" << QString("%1/%2").arg(i).arg(shards)
+                       << "--report" << reportPath + ".part" + QString::number(i);
+
+        processes.emplace_back(new QProcess());
+        processes.back()->setProcessChannelMode(QProcess::ForwardedChannels);
+        processes.back()->start(QCoreApplication::applicationFilePath(), shardArguments);
+    }
+
+    int exitCode = 0;
+    for (auto &process : processes)
+    {
+        process->waitForFinished(-1);
+        exitCode = std::max(exitCode, process->exitStatus() == QProcess::NormalExit ?
+                                process->exitCode() : 1);
+    }
+
+    //--------------------------------------------------------------------------
+    // Merge the reports in shard order
+    QFile report(reportPath);
+    if (!report.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        repoLogError("Failed to write batch report " + reportPath.toStdString());
+        return 1;
+    }
+    QTextStream out(&report);
+    out << getReportHeader() << "\n";
+    for (int i = 0; i < shards; ++i)
+    {
+        QFile part(reportPath + ".part" + QString::number(i));
+        if (part.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            QTextStream in(&part);
+            in.readLine(); // header
+            while (!in.atEnd())
+                out << in.readLine() << "\n";
+            part.close();
+            part.remove();
+        }
+    }
+    return exitCode;
+}
+
+int RepoBatchRenderer::exec(repo::RepoController *controller)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless rendering of model thumbnails.");
+    parser.addHelpOption();
+
+    QCommandLineOption batchOption("batch", "Jobs file, one file path or database/project[/revision] per line.", "jobs");
+    QCommandLineOption outputOption("output", "Directory to write the images to.", "directory", ".");
+    QCommandLineOption viewsOption("views", "Comma separated views: iso, front, back, left, right, top, bottom.", "views", "iso");
+    QCommandLineOption sizeOption("size", "Image size.", "WxH", "256x256");
+    QCommandLineOption jobsOption("jobs", "Number of processes rendering in parallel.", "N", "1");
+    QCommandLineOption shardOption("shard", "Internal, share of the jobs of a child process.", "i/N");
+    QCommandLineOption reportOption("report", "CSV file of per-job timings, report.csv in the output by default.", "file");
+    QCommandLineOption timeoutOption("timeout", "Longest conversion time of a job in seconds.", "seconds",
+                                     QString::number(REPO_BATCH_DEFAULT_TIMEOUT));
+    QCommandLineOption idBuffersOption("id-buffers", "Also write ID buffers of 26 views around each model with their ID table.");
+    QCommandLineOption hostOption("host", "Database host.", "host");
+    QCommandLineOption portOption("port", "Database port.", "port", "27017");
+    QCommandLineOption usernameOption("username", "Database username.", "username");
+    QCommandLineOption passwordOption("password", "Database password.", "password");
+    QCommandLineOption authOption("authdb", "Authentication database.", "database", "admin");
+    parser.addOptions({ batchOption, outputOption, viewsOption, sizeOption,
+                        jobsOption, shardOption, reportOption, timeoutOption,
+                        idBuffersOption, hostOption, portOption, usernameOption, passwordOption,
+                        authOption });
+    parser.process(*QCoreApplication::instance());
+
+    const std::vector<RepoBatchJob> jobs = readJobs(parser.value(batchOption));
+    if (jobs.empty())
+    {
+        repoLogError("No batch jobs to render.");
+        return 1;
+    }
+
+    const QString outputDirectory = parser.value(outputOption);
+    QDir().mkpath(outputDirectory);
+    const QString reportPath = parser.isSet(reportOption) ?
+                parser.value(reportOption) : QDir(outputDirectory).filePath("report.csv");
+
+    //--------------------------------------------------------------------------
+    // Parent of parallel runs only spreads the work
+    const int shards = std::max(1, parser.value(jobsOption).toInt());
+    if (!parser.isSet(shardOption) && shards > 1)
+    {
+        QStringList arguments = QCoreApplication::arguments();
+        arguments.removeFirst();
+        return execParallel(arguments, reportPath, shards);
+    }
+
+    int shard = 0;
+    int shardCount = 1;
+    if (parser.isSet(shardOption))
+    {
+        const QStringList parts = parser.value(shardOption).split("/");
+        if (parts.size() == 2)
+        {
+            shard = parts[0].toInt();
+            shardCount = std::max(1, parts[1].toInt());
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Options
+    std::vector<std::pair<QString, CameraView>> views;
+    for (const QString &name : parser.value(viewsOption).split(",", QString::SkipEmptyParts))
+    {
+        CameraView view;
+        if (getView(name.trimmed(), view))
+            views.push_back(std::make_pair(name.trimmed().toLower(), view));
+        else
+            repoLogError("Unknown view " + name.toStdString());
+    }
+
+    const QStringList size = parser.value(sizeOption).toLower().split("x");
+    const QSize imageSize(size.value(0).toInt(), size.value(1).toInt());
+    if (views.empty() || imageSize.isEmpty())
+    {
+        repoLogError("Invalid batch views or image size.");
+        return 1;
+    }
+
+    repo::RepoController::RepoToken *token = nullptr;
+    if (parser.isSet(hostOption))
+    {
+        std::string errMsg;
+        token = controller->createToken(
+                    "batch",
+                    parser.value(hostOption).toStdString(),
+                    parser.value(portOption).toInt(),
+                    parser.value(authOption).toStdString(),
+                    parser.value(usernameOption).toStdString(),
+                    parser.value(passwordOption).toStdString());
+        if (!token || !controller->authenticateMongo(errMsg, token))
+        {
+            repoLogError("Failed to connect/authenticate user: " + errMsg);
+            return 1;
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Render this process' share
+    RepoBatchRenderer batch(controller, token);
+    batch.setImageSize(imageSize);
+    batch.setViews(views);
+    batch.setOutputDirectory(outputDirectory);
+    batch.setTimeout(parser.value(timeoutOption).toInt() * 1000);
+    batch.setIdBuffersEnabled(parser.isSet(idBuffersOption));
+    if (!batch.initialize())
+        return 1;
+
+    QFile report(reportPath);
+    if (!report.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        repoLogError("Failed to write batch report " + reportPath.toStdString());
+        return 1;
+    }
+    QTextStream out(&report);
+    out << getReportHeader() << "\n";
+
+    bool success = true;
+    for (size_t i = shard; i < jobs.size(); i += shardCount)
+    {
+        for (const QString &line : batch.render(jobs[i]))
+        {
+            success &= line.section(",", 2, 2) == "ok";
+            out << line << "\n";
+        }
+        out.flush();
+    }
+
+    delete token;
+    return success ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <vector>
+
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+#include <repo/repo_controller.h>
+
+#include "repo_renderer_abstract.h"
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+//! A project revision or a file to render.
+struct RepoBatchJob
+{
+    //! Model file, empty for database jobs.
+    QString file;
+
+    QString database;
+    QString project;
+
+    //! Revision ID, empty for the head of master.
+    QString revision;
+
+    //! Returns a name usable as a file name prefix.
+    QString getName() const;
+};
+
+/**
+ * Headless rendering of predefined views of many models, for thumbnails.
+ *
+ * Run as "3drepogui --batch <jobs>" where the jobs file lists one model per
+ * line, either a file path or database/project[/revision]. Each job is
+ * loaded, converted and rendered with a GLCRenderer into an offscreen
+ * context, without any window. With --jobs N the list is split between N
+ * child processes whose reports are merged, as GLC state is per process.
+ * With --id-buffers the ID images of 26 views around each model are written
+ * as well, sharing a single table of mesh IDs.
+ */
+class RepoBatchRenderer
+{
+
+public:
+
+    RepoBatchRenderer(repo::RepoController *controller,
+                      const repo::RepoController::RepoToken *token = nullptr);
+
+    ~RepoBatchRenderer();
+
+    //! Returns true if the arguments ask for batch mode.
+    static bool isBatch(int argc, char *argv[]);
+
+    /**
+     * Batch mode entry point, parses the arguments of the application
+     * and processes the jobs.
+     * @return returns the process exit code
+     */
+    static int exec(repo::RepoController *controller);
+
+    /**
+     * Reads the jobs file, skipping empty lines and # comments.
+     */
+    static std::vector<RepoBatchJob> readJobs(const QString &path);
+
+    //! Returns the view of the given name such as "iso" or "front".
+    static bool getView(const QString &name, CameraView &view);
+
+    /**
+     * Creates the offscreen context.
+     * @return returns true upon success
+     */
+    bool initialize();
+
+    void setImageSize(const QSize &size) { imageSize = size; }
+
+    void setViews(const std::vector<std::pair<QString, CameraView>> &views)
+    { this->views = views; }
+
+    void setOutputDirectory(const QString &directory) { outputDirectory = directory; }
+
+    //! Longest wait for the geometry conversion of a job, in milliseconds.
+    void setTimeout(int milliseconds) { timeout = milliseconds; }
+
+    //! Also writes ID buffers of the 26 surrounding views and their ID table.
+    void setIdBuffersEnabled(bool on) { idBuffersEnabled = on; }
+
+    /**
+     * Renders all views of the job into the output directory.
+     * @return returns one report line per view
+     */
+    QStringList render(const RepoBatchJob &job);
+
+    //! Returns the header of the report lines.
+    static QString getReportHeader();
+
+protected:
+
+    /**
+     * Starts a child process per shard with the same arguments and merges
+     * their reports into the given one.
+     * @return returns the highest exit code of the children
+     */
+    static int execParallel(const QStringList &arguments,
+                            const QString &reportPath,
+                            int shards);
+
+    repo::core::model::RepoScene *loadScene(const RepoBatchJob &job);
+
+    /**
+     * Writes the ID images of the surrounding views as <name>_id_NN.png and
+     * the table of their IDs as <name>_ids.csv.
+     * @return returns the report line
+     */
+    QString exportIdBuffers(const QString &name,
+                            AbstractRenderer *renderer,
+                            qint64 loadTime,
+                            qint64 convertTime);
+
+    static QString getReportLine(const QString &job,
+                                 const QString &view,
+                                 const QString &status,
+                                 qint64 loadTime,
+                                 qint64 convertTime,
+                                 qint64 renderTime,
+                                 qint64 writeTime,
+                                 const QString &image);
+
+    //! Renders the current view with the anti-aliasing setting.
+    QImage renderImage(AbstractRenderer *renderer);
+
+    repo::RepoController *controller;
+    const repo::RepoController::RepoToken *token;
+
+    QOpenGLContext context;
+    QOffscreenSurface surface;
+
+    QSize imageSize;
+    std::vector<std::pair<QString, CameraView>> views;
+    QString outputDirectory;
+    int timeout;
+    bool idBuffersEnabled;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
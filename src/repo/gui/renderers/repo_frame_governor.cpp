@@ -0,0 +1,217 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_frame_governor.h"
+
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+//------------------------------------------------------------------------------
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <GLC_Camera>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+const QString RepoFrameGovernor::REPO_SETTINGS_TARGET_FPS = "RepoGUI/targetFPS";
+
+static const double REPO_GOVERNOR_PI = 3.14159265358979323846;
+
+//! Intervals longer than this are idle time rather than rendering.
+static const double REPO_GOVERNOR_IDLE_MS = 500.0;
+
+//! Low pass filter constant of the frame time.
+static const double REPO_GOVERNOR_ALPHA = 0.3;
+
+//! Frames to wait after a change before degrading / improving again.
+static const int REPO_GOVERNOR_DEGRADE_FRAMES = 4;
+static const int REPO_GOVERNOR_IMPROVE_FRAMES = 15;
+
+//! Frame time relative to budget above which to degrade, below which to improve.
+static const double REPO_GOVERNOR_DEGRADE_RATIO = 1.1;
+static const double REPO_GOVERNOR_IMPROVE_RATIO = 0.6;
+
+RepoFrameGovernor::RepoFrameGovernor(double targetFPS)
+    : targetFPS(targetFPS > 1.0 ? targetFPS : 1.0)
+    , navigating(false)
+    , level(0)
+    , frameTime(0)
+    , framesAtLevel(0)
+    , hasLastFrame(false)
+{}
+
+RepoFrameGovernor::~RepoFrameGovernor() {}
+
+bool RepoFrameGovernor::frame()
+{
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const double interval = hasLastFrame ?
+                std::chrono::duration<double, std::milli>(now - lastFrame).count() : 0;
+    lastFrame = now;
+    hasLastFrame = true;
+
+    if (!navigating || interval <= 0 || interval > REPO_GOVERNOR_IDLE_MS)
+        return false;
+
+    frameTime = frameTime > 0 ?
+                frameTime + REPO_GOVERNOR_ALPHA * (interval - frameTime) : interval;
+    ++framesAtLevel;
+
+    const double budget = 1000.0 / targetFPS;
+    if (frameTime > budget * REPO_GOVERNOR_DEGRADE_RATIO &&
+            framesAtLevel >= REPO_GOVERNOR_DEGRADE_FRAMES)
+        return setLevel(level + 1);
+    else if (frameTime < budget * REPO_GOVERNOR_IMPROVE_RATIO &&
+             framesAtLevel >= REPO_GOVERNOR_IMPROVE_FRAMES)
+        return setLevel(level - 1);
+
+    return false;
+}
+
+bool RepoFrameGovernor::setNavigating(bool on)
+{
+    navigating = on;
+    hasLastFrame = false;
+    frameTime = 0;
+    return on ? false : setLevel(0);
+}
+
+bool RepoFrameGovernor::setLevel(int newLevel)
+{
+    newLevel = std::max(0, std::min(MAX_LEVEL, newLevel));
+    const bool changed = newLevel != level;
+    level = newLevel;
+    if (changed)
+        framesAtLevel = 0;
+    return changed;
+}
+
+int RepoFrameGovernor::getMinimumPixelCullingSize() const
+{
+    if (level >= 4)
+        return 16;
+    else if (level >= 1)
+        return 8;
+    return 3;
+}
+
+int RepoFrameGovernor::getProxyPixelSize() const
+{
+    if (level >= 5)
+        return 64;
+    else if (level >= 4)
+        return 24;
+    return 0;
+}
+
+void RepoFrameGovernor::restore()
+{
+    for (const auto &pair : proxied)
+        pair.first->setViewable(pair.second);
+    proxied.clear();
+    proxyLines.clear();
+}
+
+void RepoFrameGovernor::applyProxies(GLC_World &world, GLC_Viewport &viewport)
+{
+    restore();
+
+    const int threshold = getProxyPixelSize();
+    if (!threshold)
+        return;
+
+    //--------------------------------------------------------------------------
+    // Pixels per world unit at unit distance
+    const GLC_Camera *camera = viewport.cameraHandle();
+    const GLC_Point3d eye = camera->eye();
+    const double halfAngle = viewport.viewAngle() * REPO_GOVERNOR_PI / 360.0;
+    const double pixelsPerUnit = viewport.size().height() / (2.0 * std::tan(halfAngle));
+    const bool ortho = viewport.useOrtho();
+
+    for (GLC_3DViewInstance *instance : world.collection()->instancesHandle())
+    {
+        const GLC_3DViewInstance::Viewable flag = instance->viewableFlag();
+        if (!instance->isVisible() || flag == GLC_3DViewInstance::NoViewable)
+            continue;
+
+        const GLC_BoundingBox bbox = instance->boundingBox();
+        if (bbox.isEmpty())
+            continue;
+
+        const double distance = ortho ?
+                    camera->distEyeTarget() : (bbox.center() - eye).length();
+        if (distance <= bbox.boundingSphereRadius())
+            continue;
+
+        const double pixels = 2.0 * bbox.boundingSphereRadius() / distance * pixelsPerUnit;
+        if (pixels >= threshold)
+            continue;
+
+        proxied.push_back(std::make_pair(instance, flag));
+        instance->setViewable(GLC_3DViewInstance::NoViewable);
+
+        //----------------------------------------------------------------------
+        // 12 edges of the box
+        const GLC_Point3d &l = bbox.lowerCorner();
+        const GLC_Point3d &u = bbox.upperCorner();
+        const double corners[8][3] = {
+            {l.x(), l.y(), l.z()}, {u.x(), l.y(), l.z()},
+            {u.x(), u.y(), l.z()}, {l.x(), u.y(), l.z()},
+            {l.x(), l.y(), u.z()}, {u.x(), l.y(), u.z()},
+            {u.x(), u.y(), u.z()}, {l.x(), u.y(), u.z()}
+        };
+        static const int edges[12][2] = {
+            {0, 1}, {1, 2}, {2, 3}, {3, 0},
+            {4, 5}, {5, 6}, {6, 7}, {7, 4},
+            {0, 4}, {1, 5}, {2, 6}, {3, 7}
+        };
+        for (const auto &edge : edges)
+        {
+            for (int v = 0; v < 2; ++v)
+            {
+                const double *c = corners[edge[v]];
+                proxyLines.push_back((float) c[0]);
+                proxyLines.push_back((float) c[1]);
+                proxyLines.push_back((float) c[2]);
+            }
+        }
+    }
+}
+
+void RepoFrameGovernor::renderProxies() const
+{
+    if (proxyLines.empty())
+        return;
+
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glColor4f(0.5f, 0.5f, 0.5f, 1.0f);
+
+    // Client side array, make sure no VBO is left bound by GLC
+    QOpenGLContext::currentContext()->functions()->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, proxyLines.data());
+    glDrawArrays(GL_LINES, 0, (GLsizei) (proxyLines.size() / 3));
+    glPopClientAttrib();
+
+    glPopAttrib();
+}
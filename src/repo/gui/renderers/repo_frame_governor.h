@@ -0,0 +1,142 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <utility>
+
+#include <QString>
+
+#include <GLC_World>
+#include <GLC_Viewport>
+#include <GLC_3DViewInstance>
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+/**
+ * Frame-time governor.
+ *
+ * While the camera moves, measures the interval between frames and trades
+ * quality for speed one level at a time until a target frame rate is held:
+ *  1) larger minimum pixel culling size,
+ *  2) transparent passes skipped,
+ *  3) overlay passes (bounding boxes, 3D widgets) skipped,
+ *  4) small objects drawn as bounding box proxies,
+ *  5) larger proxy threshold.
+ * Full quality is restored as soon as the navigation stops.
+ */
+class RepoFrameGovernor
+{
+
+public:
+
+    //! Settings label of the target frame rate.
+    static const QString REPO_SETTINGS_TARGET_FPS;
+
+    //! Highest quality reduction level.
+    static const int MAX_LEVEL = 5;
+
+    RepoFrameGovernor(double targetFPS = 30.0);
+
+    ~RepoFrameGovernor();
+
+    /**
+     * Records the start of a frame and adjusts the level if the recent frame
+     * times are off target.
+     * @return returns true if the level changed
+     */
+    bool frame();
+
+    /**
+     * Starts or stops governing, stopping resets to full quality.
+     * @return returns true if the level changed
+     */
+    bool setNavigating(bool on);
+
+    /**
+     * Flags instances that project smaller than the proxy threshold as not
+     * viewable and collects their bounding boxes for renderProxies().
+     * Does nothing below level 4.
+     */
+    void applyProxies(GLC_World &world, GLC_Viewport &viewport);
+
+    /**
+     * Reinstates the viewable flags of instances replaced by proxies.
+     */
+    void restore();
+
+    /**
+     * Draws the collected proxies as lines in a single call. Expects the
+     * camera matrices to be set and no shader to be bound.
+     */
+    void renderProxies() const;
+
+    int getLevel() const { return level; }
+
+    bool isNavigating() const { return navigating; }
+
+    //! Returns the smoothed frame time in milliseconds.
+    double getFrameTime() const { return frameTime; }
+
+    double getTargetFPS() const { return targetFPS; }
+
+    void setTargetFPS(double fps) { targetFPS = fps > 1.0 ? fps : 1.0; }
+
+    int getMinimumPixelCullingSize() const;
+
+    //! Returns the projected size in pixels below which proxies are used.
+    int getProxyPixelSize() const;
+
+    bool isTransparentSkipped() const { return level >= 2; }
+
+    bool isOverlaySkipped() const { return level >= 3; }
+
+    int getProxyCount() const { return (int) proxied.size(); }
+
+protected:
+
+    bool setLevel(int newLevel);
+
+    double targetFPS;
+    bool navigating;
+    int level;
+
+    //! Low pass filtered frame interval in milliseconds.
+    double frameTime;
+
+    //! Frames since the last level change.
+    int framesAtLevel;
+
+    std::chrono::steady_clock::time_point lastFrame;
+    bool hasLastFrame;
+
+    //! Instances replaced by proxies with their original flags.
+    std::vector<std::pair<GLC_3DViewInstance*, GLC_3DViewInstance::Viewable>> proxied;
+
+    //! Line segments of the proxy boxes, 3 floats per vertex.
+    std::vector<float> proxyLines;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
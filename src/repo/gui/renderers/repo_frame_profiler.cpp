@@ -0,0 +1,356 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_frame_profiler.h"
+
+//------------------------------------------------------------------------------
+#include <algorithm>
+//------------------------------------------------------------------------------
+#include <QFile>
+#include <QTextStream>
+#include <QOpenGLContext>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+//! Number of frames a GPU result may lag behind before it is dropped.
+static const int REPO_PROFILER_QUERY_LATENCY = 4;
+
+//! Number of frames averaged in the overlay.
+static const int REPO_PROFILER_OVERLAY_FRAMES = 60;
+
+static void resetTimings(RepoFrameProfiler::FrameTimings &timings, quint64 frame)
+{
+    timings.frame = frame;
+    timings.cpuTotal = -1;
+    for (int i = 0; i < RepoFrameProfiler::PHASE_COUNT; ++i)
+    {
+        timings.cpu[i] = -1;
+        timings.gpu[i] = -1;
+    }
+}
+
+RepoFrameProfiler::RepoFrameProfiler(int capacity)
+    : history(capacity > 0 ? capacity : 1)
+    , head(0)
+    , count(0)
+    , inFrame(false)
+    , frameNumber(0)
+    , activeSet(nullptr)
+    , gpuTimersSupported(false)
+    , overlayVisible(false)
+{
+    resetTimings(current, 0);
+}
+
+RepoFrameProfiler::~RepoFrameProfiler()
+{
+    destroy();
+}
+
+void RepoFrameProfiler::initialize()
+{
+    destroy();
+
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (!context || context->isOpenGLES())
+        return;
+
+    const QSurfaceFormat format = context->format();
+    gpuTimersSupported =
+            format.version() >= qMakePair(3, 3) ||
+            context->hasExtension(QByteArrayLiteral("GL_ARB_timer_query")) ||
+            context->hasExtension(QByteArrayLiteral("GL_EXT_timer_query"));
+
+    if (!gpuTimersSupported)
+        return;
+
+    querySets.resize(REPO_PROFILER_QUERY_LATENCY);
+    for (QuerySet &set : querySets)
+    {
+        set.frame = 0;
+        set.pending = false;
+        for (int i = 0; i < PHASE_COUNT; ++i)
+        {
+            set.used[i] = false;
+            set.queries[i] = new QOpenGLTimerQuery();
+            if (!set.queries[i]->create())
+                gpuTimersSupported = false;
+        }
+    }
+
+    if (!gpuTimersSupported)
+        destroy();
+}
+
+void RepoFrameProfiler::destroy()
+{
+    for (QuerySet &set : querySets)
+    {
+        for (int i = 0; i < PHASE_COUNT; ++i)
+            delete set.queries[i];
+    }
+    querySets.clear();
+    activeSet = nullptr;
+    gpuTimersSupported = false;
+}
+
+void RepoFrameProfiler::beginFrame()
+{
+    if (inFrame)
+        endFrame(); // previous frame was interrupted
+
+    collectGPUResults();
+
+    resetTimings(current, frameNumber);
+    frameStart = std::chrono::steady_clock::now();
+    inFrame = true;
+
+    if (gpuTimersSupported)
+    {
+        activeSet = &querySets[frameNumber % querySets.size()];
+        // Results that did not arrive in time are discarded
+        activeSet->pending = false;
+        activeSet->frame = frameNumber;
+        for (int i = 0; i < PHASE_COUNT; ++i)
+            activeSet->used[i] = false;
+    }
+}
+
+void RepoFrameProfiler::endFrame()
+{
+    if (!inFrame)
+        return;
+
+    current.cpuTotal = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - frameStart).count();
+
+    history[head] = current;
+    head = (head + 1) % history.size();
+    if (count < (int) history.size())
+        ++count;
+
+    if (activeSet)
+    {
+        for (int i = 0; i < PHASE_COUNT; ++i)
+            activeSet->pending = activeSet->pending || activeSet->used[i];
+        activeSet = nullptr;
+    }
+
+    ++frameNumber;
+    inFrame = false;
+}
+
+void RepoFrameProfiler::beginPhase(FramePhase phase)
+{
+    if (!inFrame)
+        return;
+
+    const int i = (int) phase;
+    phaseStart[i] = std::chrono::steady_clock::now();
+
+    // A phase re-entered within the same frame is only timed on the CPU
+    if (activeSet && !activeSet->used[i])
+        activeSet->queries[i]->begin();
+}
+
+void RepoFrameProfiler::endPhase(FramePhase phase)
+{
+    if (!inFrame)
+        return;
+
+    const int i = (int) phase;
+    const double elapsed = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - phaseStart[i]).count();
+    current.cpu[i] = (current.cpu[i] < 0 ? 0 : current.cpu[i]) + elapsed;
+
+    if (activeSet && !activeSet->used[i])
+    {
+        activeSet->queries[i]->end();
+        activeSet->used[i] = true;
+    }
+}
+
+void RepoFrameProfiler::collectGPUResults()
+{
+    for (QuerySet &set : querySets)
+    {
+        if (!set.pending)
+            continue;
+
+        bool available = true;
+        for (int i = 0; i < PHASE_COUNT && available; ++i)
+            available = !set.used[i] || set.queries[i]->isResultAvailable();
+
+        if (!available)
+            continue;
+
+        FrameTimings *timings = findFrame(set.frame);
+        for (int i = 0; i < PHASE_COUNT; ++i)
+        {
+            if (set.used[i])
+            {
+                // Available results are returned without stalling
+                const GLuint64 ns = set.queries[i]->waitForResult();
+                if (timings)
+                    timings->gpu[i] = ns / 1e6;
+            }
+        }
+        set.pending = false;
+    }
+}
+
+RepoFrameProfiler::FrameTimings *RepoFrameProfiler::findFrame(quint64 frame)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        const int size = (int) history.size();
+        FrameTimings &timings = history[(head - 1 - i + size) % size];
+        if (timings.frame == frame)
+            return &timings;
+    }
+    return nullptr;
+}
+
+const RepoFrameProfiler::FrameTimings &RepoFrameProfiler::recentFrame(int i) const
+{
+    const int size = (int) history.size();
+    return history[(head - 1 - i + size) % size];
+}
+
+QString RepoFrameProfiler::getPhaseName(FramePhase phase)
+{
+    switch (phase)
+    {
+    case FramePhase::VIEWABLE_STATE:
+        return "Viewable state";
+    case FramePhase::OCCLUSION:
+        return "Occlusion";
+    case FramePhase::SETUP:
+        return "Setup";
+    case FramePhase::OPAQUE_PASS:
+        return "Opaque";
+    case FramePhase::OPAQUE_SHADER_GROUP:
+        return "Opaque shaders";
+    case FramePhase::POINT_CLOUD:
+        return "Point clouds";
+    case FramePhase::TRANSPARENT_PASS:
+        return "Transparent";
+    case FramePhase::TRANSPARENT_SHADER_GROUP:
+        return "Transparent shaders";
+    case FramePhase::OVERLAYS:
+        return "Overlays";
+    case FramePhase::SELECTION:
+        return "Selection";
+    case FramePhase::WIDGETS:
+        return "Widgets";
+    case FramePhase::INFO:
+        return "Info";
+    default:
+        return "Unknown";
+    }
+}
+
+void RepoFrameProfiler::paint(QPainter *painter, int x, int y) const
+{
+    if (!painter || !count)
+        return;
+
+    const int frames = std::min(count, REPO_PROFILER_OVERLAY_FRAMES);
+    const int lineHeight = 14;
+
+    double total = 0;
+    for (int f = 0; f < frames; ++f)
+        total += recentFrame(f).cpuTotal;
+
+    painter->drawText(x, y, QString("Frame: %1 ms (CPU%2)")
+                      .arg(total / frames, 0, 'f', 2)
+                      .arg(gpuTimersSupported ? " / GPU" : ""));
+
+    for (int i = 0; i < PHASE_COUNT; ++i)
+    {
+        double cpu = 0, gpu = 0;
+        int cpuFrames = 0, gpuFrames = 0;
+        for (int f = 0; f < frames; ++f)
+        {
+            const FrameTimings &timings = recentFrame(f);
+            if (timings.cpu[i] >= 0)
+            {
+                cpu += timings.cpu[i];
+                ++cpuFrames;
+            }
+            if (timings.gpu[i] >= 0)
+            {
+                gpu += timings.gpu[i];
+                ++gpuFrames;
+            }
+        }
+
+        if (!cpuFrames)
+            continue;
+
+        QString line = getPhaseName((FramePhase) i) + ": " +
+                QString::number(cpu / cpuFrames, 'f', 2);
+        if (gpuFrames)
+            line += " / " + QString::number(gpu / gpuFrames, 'f', 2);
+
+        y += lineHeight;
+        painter->drawText(x, y, line);
+    }
+}
+
+bool RepoFrameProfiler::exportCSV(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream stream(&file);
+
+    //--------------------------------------------------------------------------
+    // Header
+    stream << "frame,total_cpu_ms";
+    for (int i = 0; i < PHASE_COUNT; ++i)
+        stream << "," << getPhaseName((FramePhase) i).toLower().replace(' ', '_') << "_cpu_ms";
+    for (int i = 0; i < PHASE_COUNT; ++i)
+        stream << "," << getPhaseName((FramePhase) i).toLower().replace(' ', '_') << "_gpu_ms";
+    stream << "\n";
+
+    //--------------------------------------------------------------------------
+    // Frames, oldest first
+    for (int f = count - 1; f >= 0; --f)
+    {
+        const FrameTimings &timings = recentFrame(f);
+        stream << timings.frame << "," << timings.cpuTotal;
+        for (int i = 0; i < PHASE_COUNT; ++i)
+        {
+            stream << ",";
+            if (timings.cpu[i] >= 0)
+                stream << timings.cpu[i];
+        }
+        for (int i = 0; i < PHASE_COUNT; ++i)
+        {
+            stream << ",";
+            if (timings.gpu[i] >= 0)
+                stream << timings.gpu[i];
+        }
+        stream << "\n";
+    }
+
+    return stream.status() == QTextStream::Ok;
+}
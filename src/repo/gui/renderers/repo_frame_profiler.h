@@ -0,0 +1,184 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include <QString>
+#include <QPainter>
+#include <QOpenGLTimerQuery>
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+//! Phases of a rendered frame, in the order they are executed.
+enum class FramePhase {
+    VIEWABLE_STATE,
+    SETUP,
+    OCCLUSION,
+    OPAQUE_PASS,
+    OPAQUE_SHADER_GROUP,
+    POINT_CLOUD,
+    TRANSPARENT_PASS,
+    TRANSPARENT_SHADER_GROUP,
+    OVERLAYS,
+    SELECTION,
+    WIDGETS,
+    INFO,
+    COUNT
+};
+
+/**
+ * Per-phase frame timing.
+ *
+ * Records CPU wall time and, where GL timer queries are supported, GPU time
+ * of every phase of a frame into a ring buffer. GPU results are collected a
+ * few frames late so that reading them never stalls the pipeline.
+ * Phases must not nest as GL allows only one active time elapsed query.
+ */
+class RepoFrameProfiler
+{
+
+public:
+
+    static const int PHASE_COUNT = (int) FramePhase::COUNT;
+
+    //! Timings of a single frame in milliseconds, negative if not recorded.
+    struct FrameTimings
+    {
+        quint64 frame;
+        double cpu[PHASE_COUNT];
+        double gpu[PHASE_COUNT];
+        double cpuTotal;
+    };
+
+    /**
+     * Starts and stops timing of a phase for the lifetime of the object.
+     */
+    class ScopedPhase
+    {
+    public:
+        ScopedPhase(RepoFrameProfiler &profiler, FramePhase phase)
+            : profiler(profiler), phase(phase)
+        { profiler.beginPhase(phase); }
+
+        ~ScopedPhase() { profiler.endPhase(phase); }
+
+    private:
+        RepoFrameProfiler &profiler;
+        FramePhase phase;
+    };
+
+public:
+
+    RepoFrameProfiler(int capacity = 256);
+
+    ~RepoFrameProfiler();
+
+    /**
+     * Creates GL timer queries if supported by the current context.
+     * Requires a current GL context.
+     */
+    void initialize();
+
+    /**
+     * Releases GL timer queries. Requires the context used in initialize()
+     * to be current.
+     */
+    void destroy();
+
+    void beginFrame();
+
+    void endFrame();
+
+    void beginPhase(FramePhase phase);
+
+    void endPhase(FramePhase phase);
+
+    /**
+     * Writes all frames held in the ring buffer to a CSV file, one row per
+     * frame with CPU and GPU columns per phase.
+     * @param path file to write to
+     * @return returns true upon success
+     */
+    bool exportCSV(const QString &path) const;
+
+    /**
+     * Paints a per-phase breakdown averaged over the most recent frames.
+     * @param painter painter to paint with
+     * @param x left position
+     * @param y baseline of the first line
+     */
+    void paint(QPainter *painter, int x, int y) const;
+
+    static QString getPhaseName(FramePhase phase);
+
+    bool isGPUTimingSupported() const { return gpuTimersSupported; }
+
+    bool isOverlayVisible() const { return overlayVisible; }
+
+    void setOverlayVisible(bool on) { overlayVisible = on; }
+
+    //! Returns the number of frames currently held in the ring buffer.
+    int getFrameCount() const { return count; }
+
+protected:
+
+    //! GL timer queries of one frame.
+    struct QuerySet
+    {
+        quint64 frame;
+        bool pending;
+        bool used[PHASE_COUNT];
+        QOpenGLTimerQuery *queries[PHASE_COUNT];
+    };
+
+    //! Reads back the available GPU results without blocking.
+    void collectGPUResults();
+
+    //! Returns the record of the given frame if still in the ring buffer.
+    FrameTimings *findFrame(quint64 frame);
+
+    //! Returns the i-th most recent frame, 0 being the latest.
+    const FrameTimings &recentFrame(int i) const;
+
+    std::vector<FrameTimings> history;
+    int head;
+    int count;
+
+    FrameTimings current;
+    bool inFrame;
+    quint64 frameNumber;
+
+    std::chrono::steady_clock::time_point frameStart;
+    std::chrono::steady_clock::time_point phaseStart[PHASE_COUNT];
+
+    std::vector<QuerySet> querySets;
+    QuerySet *activeSet;
+    bool gpuTimersSupported;
+
+    bool overlayVisible;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
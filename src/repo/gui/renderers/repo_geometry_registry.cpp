@@ -0,0 +1,110 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_geometry_registry.h"
+
+//------------------------------------------------------------------------------
+#include <GLC_StructOccurrence>
+//------------------------------------------------------------------------------
+#include "../../logger/repo_logger.h"
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+RepoGeometryRegistry::RepoGeometryRegistry() {}
+
+RepoGeometryRegistry::~RepoGeometryRegistry() {}
+
+RepoGeometryRegistry &RepoGeometryRegistry::getInstance()
+{
+    // Static variable is created and destroyed only once.
+    static RepoGeometryRegistry instance;
+    return instance;
+}
+
+QString RepoGeometryRegistry::getKey(
+        const repo::core::model::RepoScene *scene,
+        const std::vector<double> &offset)
+{
+    QString key;
+    if (scene && !scene->getDatabaseName().empty())
+    {
+        key = QString::fromStdString(scene->getDatabaseName()) + "/" +
+                QString::fromStdString(scene->getProjectName()) + "/" +
+                QString::fromStdString(UUIDtoString(scene->getRevisionID()));
+        for (const double &d : offset)
+            key += "/" + QString::number(d, 'g', 17);
+    }
+    return key;
+}
+
+bool RepoGeometryRegistry::acquire(
+        const QString &key,
+        GLC_World &world,
+        std::map<QString, GLC_Mesh*> &meshMap,
+        std::map<QString, GLC_Material*> &matMap)
+{
+    auto it = entries.find(key);
+    if (key.isEmpty() || it == entries.end())
+        return false;
+
+    Entry &entry = it->second;
+    ++entry.useCount;
+
+    //--------------------------------------------------------------------------
+    // New instances and collection, references and their 3D reps are shared
+    world = GLC_World(entry.world.rootOccurrence()->clone(nullptr, false));
+    meshMap = entry.meshMap;
+    matMap = entry.matMap;
+
+    repoLog("Sharing geometry of " + key.toStdString() + " with "
+            + std::to_string(entry.useCount) + " windows");
+    return true;
+}
+
+void RepoGeometryRegistry::share(
+        const QString &key,
+        GLC_World &world,
+        std::map<QString, GLC_Mesh*> &meshMap,
+        std::map<QString, GLC_Material*> &matMap)
+{
+    if (key.isEmpty() || acquire(key, world, meshMap, matMap))
+        return;
+
+    Entry &entry = entries[key];
+    entry.world = world;
+    entry.meshMap = meshMap;
+    entry.matMap = matMap;
+    entry.useCount = 1;
+}
+
+void RepoGeometryRegistry::release(const QString &key)
+{
+    auto it = entries.find(key);
+    if (it != entries.end() && --it->second.useCount <= 0)
+    {
+        // Last handle to the world, deletes the geometry
+        entries.erase(it);
+    }
+}
+
+int RepoGeometryRegistry::getUseCount(const QString &key) const
+{
+    auto it = entries.find(key);
+    return it != entries.end() ? it->second.useCount : 0;
+}
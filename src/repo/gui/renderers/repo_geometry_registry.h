@@ -0,0 +1,114 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <QString>
+
+#include <GLC_World>
+#include <GLC_Material>
+#include "geometry/glc_mesh.h"
+
+#include <repo/core/model/collection/repo_scene.h>
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+/**
+ * Reference counted registry of converted GLC geometry shared by all
+ * rendering windows showing the same database revision.
+ *
+ * The first window to convert a revision registers its world. Further
+ * windows get their own occurrence tree and collection cloned from it, so
+ * that viewable flags, selection and shading groups stay per window, while
+ * the 3D representations, hence the meshes, materials and their VBOs, are
+ * shared (contexts are shared application wide). Geometry is released with
+ * the last window. Only to be used from the GUI thread.
+ */
+class RepoGeometryRegistry
+{
+
+public:
+
+    static RepoGeometryRegistry &getInstance();
+
+    /**
+     * Returns the key of the given scene, empty if the scene does not come
+     * from a database revision and cannot be shared. The offset is part of
+     * the key as it is baked into the converted vertices.
+     */
+    static QString getKey(const repo::core::model::RepoScene *scene,
+                          const std::vector<double> &offset);
+
+    /**
+     * Acquires the geometry registered under the key, if any, filling in a
+     * world of its own for the caller and the shared mesh and material maps.
+     * @return returns true if the key was found
+     */
+    bool acquire(const QString &key,
+                 GLC_World &world,
+                 std::map<QString, GLC_Mesh*> &meshMap,
+                 std::map<QString, GLC_Material*> &matMap);
+
+    /**
+     * Registers freshly converted geometry under the key and acquires it.
+     * If another window registered the same key in the meantime, the given
+     * world is discarded and the arguments are replaced as by acquire().
+     */
+    void share(const QString &key,
+               GLC_World &world,
+               std::map<QString, GLC_Mesh*> &meshMap,
+               std::map<QString, GLC_Material*> &matMap);
+
+    /**
+     * Releases one reference, deleting the geometry with the last one.
+     */
+    void release(const QString &key);
+
+    //! Returns the number of windows holding the key.
+    int getUseCount(const QString &key) const;
+
+    //! Returns true if more than one window holds the key.
+    bool isShared(const QString &key) const { return getUseCount(key) > 1; }
+
+private:
+
+    RepoGeometryRegistry();
+
+    ~RepoGeometryRegistry();
+
+    struct Entry
+    {
+        //! Converted world, never rendered by windows other than the first.
+        GLC_World world;
+        std::map<QString, GLC_Mesh*> meshMap;
+        std::map<QString, GLC_Material*> matMap;
+        int useCount;
+    };
+
+    std::map<QString, Entry> entries;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
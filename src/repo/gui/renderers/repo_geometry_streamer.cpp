@@ -0,0 +1,287 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_geometry_streamer.h"
+
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+//------------------------------------------------------------------------------
+#include <QSettings>
+//------------------------------------------------------------------------------
+#include <GLC_Camera>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+const QString RepoGeometryStreamer::REPO_SETTINGS_STREAM_GEOMETRY = "RepoGUI/streamGeometry";
+const QString RepoGeometryStreamer::REPO_SETTINGS_STREAM_BUDGET = "RepoGUI/streamBudget";
+
+//! Memory budget in MB when not set.
+static const int REPO_STREAM_DEFAULT_BUDGET = 1024;
+
+//! Smallest memory budget in MB.
+static const int REPO_STREAM_MIN_BUDGET = 64;
+
+//! Meshes smaller than this on screen are not converted.
+static const double REPO_STREAM_MIN_PIXELS = 8;
+
+static const double REPO_STREAM_PI = 3.14159265358979323846;
+
+RepoGeometryStreamer::RepoGeometryStreamer()
+    : proxies(Qt::gray)
+    , proxiesDirty(false)
+    , budget((qint64) REPO_STREAM_DEFAULT_BUDGET * 1024 * 1024)
+    , residentBytes(0)
+    , frame(0)
+    , compressedBytes(0)
+    , compressedRawBytes(0)
+    , decodedCount(0)
+    , decodeTime(0)
+{}
+
+bool RepoGeometryStreamer::isEnabledSetting()
+{
+    QSettings settings;
+    return settings.value(REPO_SETTINGS_STREAM_GEOMETRY, false).toBool();
+}
+
+qint64 RepoGeometryStreamer::getBudgetSetting()
+{
+    QSettings settings;
+    const int budget = settings.value(
+                REPO_SETTINGS_STREAM_BUDGET, REPO_STREAM_DEFAULT_BUDGET).toInt();
+    return (qint64) std::max(REPO_STREAM_MIN_BUDGET, budget) * 1024 * 1024;
+}
+
+void RepoGeometryStreamer::setIndex(const RepoStreamIndex &index)
+{
+    clear();
+    this->index = index;
+    pending.assign(index.meshes.size(), false);
+    proxiesDirty = true;
+}
+
+void RepoGeometryStreamer::clear()
+{
+    index = RepoStreamIndex();
+    pending.clear();
+    resident.clear();
+    lru.clear();
+    proxies.clear();
+    proxiesDirty = false;
+    residentBytes = 0;
+    compressed.clear();
+    compressedLru.clear();
+    compressedBytes = 0;
+    compressedRawBytes = 0;
+    decodedCount = 0;
+    decodeTime = 0;
+}
+
+std::vector<QString> RepoGeometryStreamer::getComponents() const
+{
+    std::vector<QString> components;
+    for (const RepoStreamIndexEntry &entry : index.meshes)
+        components.insert(components.end(), entry.components.begin(), entry.components.end());
+    return components;
+}
+
+GLC_BoundingBox RepoGeometryStreamer::getBoundingBox() const
+{
+    GLC_BoundingBox bbox;
+    for (const RepoStreamIndexEntry &entry : index.meshes)
+        bbox.combine(GLC_BoundingBox(
+                         GLC_Point3d(entry.lower[0], entry.lower[1], entry.lower[2]),
+                         GLC_Point3d(entry.upper[0], entry.upper[1], entry.upper[2])));
+    return bbox;
+}
+
+std::vector<int> RepoGeometryStreamer::getCandidates(
+        const GLC_Viewport &viewport,
+        size_t maxCount)
+{
+    std::vector<int> candidates;
+    if (index.meshes.empty())
+        return candidates;
+    ++frame;
+
+    //--------------------------------------------------------------------------
+    // Pixels per world unit at unit distance
+    const GLC_Camera *camera = viewport.cameraHandle();
+    const GLC_Point3d eye = camera->eye();
+    const double halfAngle = viewport.viewAngle() * REPO_STREAM_PI / 360.0;
+    const double pixelsPerUnit = viewport.size().height() / (2.0 * std::tan(halfAngle));
+    const bool ortho = viewport.useOrtho();
+    const GLC_Frustum &frustum = viewport.frustum();
+
+    std::vector<std::pair<double, int>> ranked;
+    qint64 inViewBytes = 0;
+    for (int i = 0; i < (int) index.meshes.size(); ++i)
+    {
+        const RepoStreamIndexEntry &entry = index.meshes[i];
+        const GLC_BoundingBox bbox(GLC_Point3d(entry.lower[0], entry.lower[1], entry.lower[2]),
+                                   GLC_Point3d(entry.upper[0], entry.upper[1], entry.upper[2]));
+        if (frustum.localizeBoundingBox(bbox) == GLC_Frustum::OutFrustum)
+            continue;
+
+        auto it = resident.find(i);
+        if (it != resident.end())
+        {
+            it->second.frame = frame;
+            lru.splice(lru.begin(), lru, it->second.lru);
+            inViewBytes += it->second.bytes;
+            continue;
+        }
+        if (pending[i])
+            continue;
+
+        const double size = (bbox.upperCorner() - bbox.lowerCorner()).length();
+        const double distance = ortho ? camera->distEyeTarget() :
+                                        std::max((bbox.center() - eye).length(), size / 2);
+        const double pixels = distance > 0 ? size / distance * pixelsPerUnit : size;
+        if (pixels >= REPO_STREAM_MIN_PIXELS)
+            ranked.push_back(std::make_pair(pixels, i));
+    }
+
+    // Nothing could be dropped to make room
+    if (inViewBytes >= budget)
+        return candidates;
+
+    const size_t count = std::min(maxCount, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(),
+                      [](const std::pair<double, int> &a, const std::pair<double, int> &b)
+    { return a.first > b.first; });
+    for (size_t i = 0; i < count; ++i)
+        candidates.push_back(ranked[i].second);
+    return candidates;
+}
+
+void RepoGeometryStreamer::setPending(const std::vector<int> &entries, bool pending)
+{
+    for (const int entry : entries)
+        if (entry >= 0 && entry < (int) this->pending.size())
+            this->pending[entry] = pending;
+}
+
+void RepoGeometryStreamer::insert(const RepoStreamedMesh &mesh, qint64 bytes)
+{
+    if (mesh.entry < 0 || mesh.entry >= (int) index.meshes.size() || resident.count(mesh.entry))
+        return;
+
+    pending[mesh.entry] = false;
+    lru.push_front(mesh.entry);
+    Resident &entry = resident[mesh.entry];
+    entry.mesh = mesh;
+    entry.bytes = bytes;
+    entry.lru = lru.begin();
+    entry.frame = frame; // just requested, hence in view
+    residentBytes += bytes;
+    proxiesDirty = true;
+
+    if (mesh.decodeTime >= 0)
+    {
+        ++decodedCount;
+        decodeTime += mesh.decodeTime;
+    }
+
+    //--------------------------------------------------------------------------
+    // Kept apart from the resident mesh so that it outlives its eviction
+    if (!mesh.compressed.isEmpty())
+    {
+        entry.mesh.compressed = RepoCompressedMesh();
+        auto it = compressed.find(mesh.entry);
+        if (it != compressed.end())
+        {
+            compressedBytes -= it->second.mesh.compressedBytes;
+            compressedRawBytes -= it->second.mesh.rawBytes;
+            compressedLru.erase(it->second.lru);
+            compressed.erase(it);
+        }
+        compressedLru.push_front(mesh.entry);
+        Compressed &copy = compressed[mesh.entry];
+        copy.mesh = mesh.compressed;
+        copy.lru = compressedLru.begin();
+        compressedBytes += mesh.compressed.compressedBytes;
+        compressedRawBytes += mesh.compressed.rawBytes;
+        trimCompressed();
+    }
+}
+
+const RepoCompressedMesh *RepoGeometryStreamer::getCompressed(int entry)
+{
+    auto it = compressed.find(entry);
+    if (it == compressed.end())
+        return nullptr;
+    compressedLru.splice(compressedLru.begin(), compressedLru, it->second.lru);
+    return &it->second.mesh;
+}
+
+void RepoGeometryStreamer::trimCompressed()
+{
+    while (compressedBytes > budget / 4 && compressedLru.size() > 1)
+    {
+        auto it = compressed.find(compressedLru.back());
+        compressedBytes -= it->second.mesh.compressedBytes;
+        compressedRawBytes -= it->second.mesh.rawBytes;
+        compressed.erase(it);
+        compressedLru.pop_back();
+    }
+}
+
+double RepoGeometryStreamer::getCompressionRatio() const
+{
+    return compressedBytes ? (double) compressedRawBytes / compressedBytes : 0;
+}
+
+double RepoGeometryStreamer::getAverageDecodeTime() const
+{
+    return decodedCount ? decodeTime / 1000.0 / decodedCount : 0;
+}
+
+std::vector<RepoStreamedMesh> RepoGeometryStreamer::evict()
+{
+    std::vector<RepoStreamedMesh> evicted;
+    while (residentBytes > budget && !lru.empty())
+    {
+        auto it = resident.find(lru.back());
+        if (it->second.frame == frame)
+            break; // the rest is in view too
+        evicted.push_back(it->second.mesh);
+        residentBytes -= it->second.bytes;
+        resident.erase(it);
+        lru.pop_back();
+        proxiesDirty = true;
+    }
+    return evicted;
+}
+
+void RepoGeometryStreamer::renderProxies()
+{
+    if (proxiesDirty)
+    {
+        RepoLineOverlayData data;
+        for (int i = 0; i < (int) index.meshes.size(); ++i)
+            if (!resident.count(i))
+                data.addBox(index.meshes[i].lower, index.meshes[i].upper);
+        data.endLevel();
+        proxies.setData(data);
+        proxiesDirty = false;
+    }
+    proxies.render();
+}
@@ -0,0 +1,250 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include <QMetaType>
+#include <QString>
+
+#include <GLC_BoundingBox>
+#include <GLC_Material>
+#include <GLC_StructOccurrence>
+#include <GLC_Viewport>
+#include "geometry/glc_mesh.h"
+
+#include <repo/core/model/repo_node_utils.h>
+
+#include "repo_line_overlay.h"
+#include "repo_mesh_codec.h"
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+//! Mesh of the scene as known before its geometry is converted.
+struct RepoStreamIndexEntry
+{
+    repoUUID sharedID;
+
+    //! Material map keys of the mesh, numbered up front for stable IDs.
+    std::vector<QString> components;
+
+    //! World bounds of all placements.
+    float lower[3];
+    float upper[3];
+
+    //! World matrices of the placements, column major.
+    std::vector<std::vector<float>> matrices;
+};
+
+//! Scene structure and bounds as produced by workers.
+struct RepoStreamIndex
+{
+    std::vector<RepoStreamIndexEntry> meshes;
+};
+
+//! Converted geometry of an index entry, not yet part of any world.
+struct RepoStreamedMesh
+{
+    //! Position of the mesh in the index.
+    int entry;
+
+    //! Placements of the mesh, null if it has nothing to draw.
+    GLC_StructOccurrence *occurrence;
+
+    std::map<QString, GLC_Mesh*> meshMap;
+    std::map<QString, GLC_Material*> matMap;
+
+    qint64 vertexCount;
+    qint64 faceCount;
+
+    //! Encoded copy made at conversion, empty if decoded or not encodable.
+    RepoCompressedMesh compressed;
+
+    //! Time taken to decode in microseconds, -1 if converted from the scene.
+    qint64 decodeTime;
+
+    RepoStreamedMesh()
+        : entry(-1), occurrence(nullptr), vertexCount(0), faceCount(0), decodeTime(-1) {}
+};
+
+typedef std::vector<RepoStreamedMesh> RepoStreamedMeshes;
+
+/**
+ * Bookkeeping of out-of-core geometry.
+ *
+ * Only the index of mesh bounds is loaded up front and drawn as boxes.
+ * Whenever the view changes the meshes in view are ranked by their size on
+ * screen and the largest ones not yet converted are handed out in batches.
+ * Converted meshes are tracked by the frame they were last in view, and
+ * beyond the memory budget the least recently seen are handed back to be
+ * dropped, never those in the current view. Compressed copies of dropped
+ * meshes are kept within a quarter of the budget so that they come back
+ * by decoding rather than by converting the scene again.
+ */
+class RepoGeometryStreamer
+{
+
+public:
+
+    //! Settings key to stream geometry in rather than convert it all.
+    static const QString REPO_SETTINGS_STREAM_GEOMETRY;
+
+    //! Settings key of the memory budget of converted geometry, in MB.
+    static const QString REPO_SETTINGS_STREAM_BUDGET;
+
+    RepoGeometryStreamer();
+
+    //! Returns true if streaming is switched on in the settings.
+    static bool isEnabledSetting();
+
+    //! Returns the memory budget of the settings in bytes.
+    static qint64 getBudgetSetting();
+
+    //! Replaces the index, forgetting all resident meshes.
+    void setIndex(const RepoStreamIndex &index);
+
+    /**
+     * Forgets the index and the resident meshes, whose occurrences are
+     * owned and deleted by the world.
+     */
+    void clear();
+
+    bool isActive() const { return !index.meshes.empty(); }
+
+    const RepoStreamIndex &getIndex() const { return index; }
+
+    //! Returns the material map keys of all meshes in index order.
+    std::vector<QString> getComponents() const;
+
+    //! Returns the bounds of all meshes, resident or not.
+    GLC_BoundingBox getBoundingBox() const;
+
+    void setBudget(qint64 bytes) { budget = bytes; }
+
+    /**
+     * Returns meshes in view large enough on screen that are neither
+     * resident nor pending, largest first, and marks the resident ones in
+     * view as used in this frame. Nothing is returned while the budget is
+     * spent on meshes in view.
+     * @param maxCount largest number of meshes returned
+     */
+    std::vector<int> getCandidates(const GLC_Viewport &viewport, size_t maxCount);
+
+    //! Marks the meshes as being converted.
+    void setPending(const std::vector<int> &entries, bool pending);
+
+    /**
+     * Adds a converted mesh of the given size to the resident ones, taking
+     * over its compressed copy if any.
+     */
+    void insert(const RepoStreamedMesh &mesh, qint64 bytes);
+
+    //! Returns the compressed copy of the mesh, null if there is none.
+    const RepoCompressedMesh *getCompressed(int entry);
+
+    /**
+     * Removes least recently seen meshes until the resident size is within
+     * the budget, keeping the ones in the current view.
+     * @return returns the meshes to drop from the world
+     */
+    std::vector<RepoStreamedMesh> evict();
+
+    /**
+     * Draws the boxes of the meshes that are not resident. Expects the
+     * camera matrices to be set and no shader to be bound.
+     */
+    void renderProxies();
+
+    int getMeshCount() const { return (int) index.meshes.size(); }
+
+    int getResidentCount() const { return (int) resident.size(); }
+
+    qint64 getResidentBytes() const { return residentBytes; }
+
+    int getCompressedCount() const { return (int) compressed.size(); }
+
+    qint64 getCompressedBytes() const { return compressedBytes; }
+
+    //! Returns the size of the compressed meshes decoded over encoded.
+    double getCompressionRatio() const;
+
+    //! Returns the average time to decode a mesh in milliseconds.
+    double getAverageDecodeTime() const;
+
+protected:
+
+    struct Resident
+    {
+        RepoStreamedMesh mesh;
+        qint64 bytes;
+        std::list<int>::iterator lru;
+        quint64 frame; //!< last update with the mesh in view
+    };
+
+    struct Compressed
+    {
+        RepoCompressedMesh mesh;
+        std::list<int>::iterator lru;
+    };
+
+    //! Drops least recently used compressed copies beyond their share.
+    void trimCompressed();
+
+    RepoStreamIndex index;
+
+    //! Entries being converted by a worker.
+    std::vector<bool> pending;
+
+    //! Converted meshes, most recently seen first in lru.
+    std::unordered_map<int, Resident> resident;
+    std::list<int> lru;
+
+    //! Boxes of the meshes not resident, rebuilt on changes.
+    RepoLineOverlay proxies;
+    bool proxiesDirty;
+
+    qint64 budget;
+
+    qint64 residentBytes;
+
+    quint64 frame;
+
+    //! Compressed copies, most recently used first in compressedLru.
+    std::unordered_map<int, Compressed> compressed;
+    std::list<int> compressedLru;
+    qint64 compressedBytes;
+    qint64 compressedRawBytes;
+
+    //! Decoded meshes and their total decode time in microseconds.
+    qint64 decodedCount;
+    qint64 decodeTime;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
+
+Q_DECLARE_METATYPE(repo::gui::renderer::RepoStreamIndex)
+Q_DECLARE_METATYPE(repo::gui::renderer::RepoStreamedMeshes)
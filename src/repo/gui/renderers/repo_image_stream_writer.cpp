@@ -0,0 +1,280 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_image_stream_writer.h"
+
+//------------------------------------------------------------------------------
+#include <cstring>
+//------------------------------------------------------------------------------
+#include <QByteArray>
+#include <QDataStream>
+#include <QFileInfo>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+//! Entries of the image file directory.
+static const quint16 REPO_TIFF_IFD_ENTRIES = 13;
+
+//! Largest offset a baseline TIFF file can address.
+static const quint64 REPO_TIFF_MAX_OFFSET = 0xFFFFFFFFull;
+
+RepoImageStreamWriter::RepoImageStreamWriter(const QString &path, int width, int height)
+    : file(path)
+    , width(width)
+    , height(height)
+    , rowsWritten(0)
+    , rowsPerStrip(0)
+    , closing(false)
+    , failed(false)
+{}
+
+RepoImageStreamWriter::~RepoImageStreamWriter()
+{
+    close();
+}
+
+bool RepoImageStreamWriter::isSupported(const QString &path)
+{
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    return suffix == "tif" || suffix == "tiff";
+}
+
+bool RepoImageStreamWriter::open()
+{
+    if (width <= 0 || height <= 0)
+    {
+        errorString = QObject::tr("Invalid image size %1x%2.").arg(width).arg(height);
+        return false;
+    }
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        errorString = file.errorString();
+        return false;
+    }
+
+    if (!writeHeader())
+    {
+        errorString = file.errorString();
+        file.close();
+        return false;
+    }
+
+    thread = std::thread(&RepoImageStreamWriter::run, this);
+    return true;
+}
+
+void RepoImageStreamWriter::writeRows(const QImage &band)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this]
+    {
+        return failed || (int) queue.size() < MAX_QUEUED_BANDS;
+    });
+    if (!failed)
+    {
+        queue.push_back(band.convertToFormat(QImage::Format_RGB888));
+        condition.notify_all();
+    }
+}
+
+bool RepoImageStreamWriter::close()
+{
+    if (!thread.joinable())
+        return !failed && rowsWritten == height;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+        condition.notify_all();
+    }
+    thread.join();
+
+    if (!failed && rowsWritten != height)
+    {
+        failed = true;
+        errorString = QObject::tr("Only %1 of %2 rows were written.")
+                .arg(rowsWritten).arg(height);
+    }
+    if (!failed && !writeFooter())
+    {
+        failed = true;
+        if (errorString.isEmpty())
+            errorString = file.errorString();
+    }
+    file.close();
+    return !failed;
+}
+
+void RepoImageStreamWriter::run()
+{
+    while (true)
+    {
+        QImage band;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return closing || !queue.empty(); });
+            if (queue.empty())
+                return;
+            band = queue.front();
+        }
+
+        // Encoded outside of the lock so that rendering carries on
+        const bool ok = writeBand(band);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.pop_front();
+        if (!ok)
+        {
+            failed = true;
+            queue.clear();
+            condition.notify_all();
+            return;
+        }
+        condition.notify_all();
+    }
+}
+
+bool RepoImageStreamWriter::writeHeader()
+{
+    // The directory offset is filled in by the footer
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.writeRawData("II", 2);
+    stream << (quint16) 42 << (quint32) 0;
+    return stream.status() == QDataStream::Ok;
+}
+
+bool RepoImageStreamWriter::writeBand(const QImage &band)
+{
+    if (band.width() != width || rowsWritten + band.height() > height)
+        return false;
+
+    //--------------------------------------------------------------------------
+    // All strips but the last are as high as the first
+    if (!rowsPerStrip)
+        rowsPerStrip = band.height();
+    else if (band.height() > rowsPerStrip ||
+             (int) stripOffsets.size() * rowsPerStrip != rowsWritten)
+    {
+        errorString = QObject::tr("Band of %1 rows after strips of %2.")
+                .arg(band.height()).arg(rowsPerStrip);
+        return false;
+    }
+
+    //--------------------------------------------------------------------------
+    // Horizontal differencing (predictor 2) turns the flat areas of a
+    // rendering into runs of zeros for deflate
+    const int rowBytes = width * 3;
+    QByteArray raw;
+    raw.resize(rowBytes * band.height());
+    for (int y = 0; y < band.height(); ++y)
+    {
+        const uchar *source = band.constScanLine(y);
+        uchar *row = (uchar *) raw.data() + y * rowBytes;
+        memcpy(row, source, rowBytes);
+        for (int i = rowBytes - 1; i >= 3; --i)
+            row[i] -= source[i - 3];
+    }
+
+    // qCompress prepends the uncompressed size to the zlib stream
+    const QByteArray compressed = qCompress(raw);
+    const qint64 offset = file.pos();
+    const qint64 size = compressed.size() - 4;
+    if ((quint64) (offset + size) > REPO_TIFF_MAX_OFFSET)
+    {
+        errorString = QObject::tr("Image too large for a TIFF file.");
+        return false;
+    }
+    if (file.write(compressed.constData() + 4, size) != size)
+        return false;
+
+    stripOffsets.push_back((quint32) offset);
+    stripByteCounts.push_back((quint32) size);
+    rowsWritten += band.height();
+    return true;
+}
+
+bool RepoImageStreamWriter::writeFooter()
+{
+    //--------------------------------------------------------------------------
+    // Directory on a word boundary, followed by the values too large for it:
+    // bits per sample, x and y resolution, strip offsets and byte counts
+    if (file.pos() % 2 && !file.putChar('\0'))
+        return false;
+    const quint32 strips = (quint32) stripOffsets.size();
+    const quint64 ifdOffset = file.pos();
+    const quint64 bitsOffset = ifdOffset + 2 + REPO_TIFF_IFD_ENTRIES * 12 + 4;
+    const quint64 xResOffset = bitsOffset + 6;
+    const quint64 yResOffset = xResOffset + 8;
+    const quint64 offsetsOffset = yResOffset + 8;
+    const quint64 countsOffset = offsetsOffset + (strips > 1 ? strips * 4 : 0);
+    const quint64 end = countsOffset + (strips > 1 ? strips * 4 : 0);
+    if (end > REPO_TIFF_MAX_OFFSET)
+    {
+        errorString = QObject::tr("Image too large for a TIFF file.");
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    //--------------------------------------------------------------------------
+    // Tag, type (3 short, 4 long, 5 rational), count, value or offset
+    // with shorts left justified, in ascending tag order
+    auto entry = [&stream](quint16 tag, quint16 type, quint32 count, quint32 value)
+    {
+        stream << tag << type << count;
+        if (type == 3 && count == 1)
+            stream << (quint16) value << (quint16) 0;
+        else
+            stream << value;
+    };
+    stream << REPO_TIFF_IFD_ENTRIES;
+    entry(256, 4, 1, width); // ImageWidth
+    entry(257, 4, 1, height); // ImageLength
+    entry(258, 3, 3, (quint32) bitsOffset); // BitsPerSample
+    entry(259, 3, 1, 8); // Compression, deflate
+    entry(262, 3, 1, 2); // PhotometricInterpretation, RGB
+    entry(273, 4, strips, strips > 1 ? (quint32) offsetsOffset : stripOffsets[0]); // StripOffsets
+    entry(277, 3, 1, 3); // SamplesPerPixel
+    entry(278, 4, 1, rowsPerStrip); // RowsPerStrip
+    entry(279, 4, strips, strips > 1 ? (quint32) countsOffset : stripByteCounts[0]); // StripByteCounts
+    entry(282, 5, 1, (quint32) xResOffset); // XResolution
+    entry(283, 5, 1, (quint32) yResOffset); // YResolution
+    entry(296, 3, 1, 2); // ResolutionUnit, inch
+    entry(317, 3, 1, 2); // Predictor, horizontal differencing
+    stream << (quint32) 0; // no further IFD
+
+    stream << (quint16) 8 << (quint16) 8 << (quint16) 8;
+    stream << (quint32) 72 << (quint32) 1 << (quint32) 72 << (quint32) 1;
+    if (strips > 1)
+    {
+        for (const quint32 offset : stripOffsets)
+            stream << offset;
+        for (const quint32 count : stripByteCounts)
+            stream << count;
+    }
+
+    // Point the header to the directory
+    if (stream.status() != QDataStream::Ok || !file.seek(4))
+        return false;
+    stream << (quint32) ifdOffset;
+    return stream.status() == QDataStream::Ok;
+}
@@ -0,0 +1,119 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QFile>
+#include <QImage>
+#include <QString>
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+/**
+ * Streaming TIFF encoder.
+ *
+ * Bands of rows are written top to bottom and encoded on a background
+ * thread as they come, so that images far larger than what fits in a
+ * single QImage can be saved with memory bounded by a couple of bands.
+ * Each band becomes a strip compressed with deflate (qCompress) after
+ * horizontal differencing, the directory follows the last strip.
+ */
+class RepoImageStreamWriter
+{
+
+public:
+
+    //! Bands queued for encoding before writeRows() blocks.
+    static const int MAX_QUEUED_BANDS = 2;
+
+    RepoImageStreamWriter(const QString &path, int width, int height);
+
+    //! Closes the file if still open.
+    ~RepoImageStreamWriter();
+
+    //! Returns true if the suffix of the path is a TIFF one.
+    static bool isSupported(const QString &path);
+
+    /**
+     * Creates the file, writes the header and starts the encoding thread.
+     * @return returns true upon success
+     */
+    bool open();
+
+    /**
+     * Queues the next rows of the image, blocks while the encoder is
+     * behind. The band has to be as wide as the image, and as high as the
+     * first one unless it is the last.
+     */
+    void writeRows(const QImage &band);
+
+    /**
+     * Waits for all queued rows to be encoded and finishes the file.
+     * @return returns true if the whole image was written
+     */
+    bool close();
+
+    QString getErrorString() const { return errorString; }
+
+protected:
+
+    //! Encoding thread, runs until closing with an empty queue.
+    void run();
+
+    bool writeHeader();
+
+    bool writeBand(const QImage &band);
+
+    //! Writes the directory and points the header to it.
+    bool writeFooter();
+
+    QFile file;
+    int width;
+    int height;
+
+    int rowsWritten;
+
+    //! Height of all strips but the last, set by the first band.
+    int rowsPerStrip;
+
+    //! Offset and size of each compressed strip.
+    std::vector<quint32> stripOffsets;
+    std::vector<quint32> stripByteCounts;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<QImage> queue;
+    bool closing;
+    bool failed;
+
+    QString errorString;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
@@ -0,0 +1,184 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_line_overlay.h"
+
+//------------------------------------------------------------------------------
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+//! Corner indices of the 12 edges of a box, corners in binary xyz order.
+static const int REPO_BOX_EDGES[12][2] = {
+    {0, 1}, {2, 3}, {4, 5}, {6, 7},
+    {0, 2}, {1, 3}, {4, 6}, {5, 7},
+    {0, 4}, {1, 5}, {2, 6}, {3, 7}
+};
+
+void RepoLineOverlayData::addBox(const float lower[3], const float upper[3])
+{
+    for (const auto &edge : REPO_BOX_EDGES)
+    {
+        for (int v = 0; v < 2; ++v)
+        {
+            const int corner = edge[v];
+            vertices.push_back(corner & 1 ? upper[0] : lower[0]);
+            vertices.push_back(corner & 2 ? upper[1] : lower[1]);
+            vertices.push_back(corner & 4 ? upper[2] : lower[2]);
+        }
+    }
+}
+
+void RepoLineOverlayData::addBox(
+        const float lower[3],
+        const float upper[3],
+        const QColor &color)
+{
+    addBox(lower, upper);
+    for (int i = 0; i < 24; ++i)
+    {
+        colors.push_back((float) color.redF());
+        colors.push_back((float) color.greenF());
+        colors.push_back((float) color.blueF());
+        colors.push_back((float) color.alphaF());
+    }
+}
+
+void RepoLineOverlayData::endLevel()
+{
+    levelOffsets.push_back((int) (vertices.size() / 3));
+}
+
+RepoLineOverlay::RepoLineOverlay(const QColor &color)
+    : color(color)
+    , level(-1)
+    , buffer(0)
+    , vertexCount(0)
+    , hasColors(false)
+    , pending(false)
+{}
+
+RepoLineOverlay::~RepoLineOverlay()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (context && buffer)
+        context->functions()->glDeleteBuffers(1, &buffer);
+}
+
+void RepoLineOverlay::setData(const RepoLineOverlayData &data)
+{
+    this->data = data;
+    vertexCount = (int) (this->data.vertices.size() / 3);
+    hasColors = this->data.colors.size() / 4 == this->data.vertices.size() / 3 &&
+            !this->data.colors.empty();
+    pending = vertexCount > 0;
+    if (level >= getLevelCount())
+        level = -1;
+
+    if (pending && QOpenGLContext::currentContext())
+        upload(QOpenGLContext::currentContext()->functions());
+}
+
+void RepoLineOverlay::clear()
+{
+    // Without a context the buffer is reused by the next upload
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (context && buffer)
+    {
+        context->functions()->glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+    data = RepoLineOverlayData();
+    vertexCount = 0;
+    hasColors = false;
+    pending = false;
+    level = -1;
+}
+
+void RepoLineOverlay::upload(QOpenGLFunctions *f)
+{
+    const GLsizeiptr vertexBytes = data.vertices.size() * sizeof(float);
+    const GLsizeiptr colorBytes = hasColors ? data.colors.size() * sizeof(float) : 0;
+    if (!buffer)
+        f->glGenBuffers(1, &buffer);
+    f->glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    f->glBufferData(GL_ARRAY_BUFFER, vertexBytes + colorBytes, nullptr, GL_STATIC_DRAW);
+    f->glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, data.vertices.data());
+    if (colorBytes)
+        f->glBufferSubData(GL_ARRAY_BUFFER, vertexBytes, colorBytes, data.colors.data());
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    std::vector<float>().swap(data.vertices);
+    std::vector<float>().swap(data.colors);
+    pending = false;
+}
+
+int RepoLineOverlay::getLevelCount() const
+{
+    return (int) data.levelOffsets.size();
+}
+
+void RepoLineOverlay::setLevel(int level)
+{
+    this->level = level >= 0 && level < getLevelCount() ? level : -1;
+}
+
+void RepoLineOverlay::render()
+{
+    if (!vertexCount)
+        return;
+
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    if (pending)
+        upload(f);
+
+    //--------------------------------------------------------------------------
+    // Drawn range
+    int first = 0;
+    int count = vertexCount;
+    if (level >= 0)
+    {
+        first = level > 0 ? data.levelOffsets[level - 1] : 0;
+        count = data.levelOffsets[level] - first;
+    }
+    if (count <= 0)
+        return;
+
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glColor4f(color.redF(), color.greenF(), color.blueF(), color.alphaF());
+
+    // Pointers are offsets into the buffer
+    f->glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, (const GLvoid *) 0);
+    if (hasColors)
+    {
+        glEnableClientState(GL_COLOR_ARRAY);
+        glColorPointer(4, GL_FLOAT, 0, (const GLvoid *) (vertexCount * 3 * sizeof(float)));
+    }
+    glDrawArrays(GL_LINES, first, count);
+    glPopClientAttrib();
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glPopAttrib();
+}
@@ -0,0 +1,128 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <vector>
+
+#include <QColor>
+#include <QMetaType>
+#include <QOpenGLFunctions>
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+/**
+ * Line segments of an overlay grouped by level, as produced by workers.
+ */
+struct RepoLineOverlayData
+{
+    //! Segment end points, 3 floats per vertex, 2 vertices per segment.
+    std::vector<float> vertices;
+
+    //! Optional per-vertex RGBA colours, empty for a single colour.
+    std::vector<float> colors;
+
+    //! Vertex count after each level, levels being contiguous.
+    std::vector<int> levelOffsets;
+
+    //! Appends the 12 edges of an axis aligned box.
+    void addBox(const float lower[3], const float upper[3]);
+
+    //! Appends the box with per-vertex colours, not to be mixed with the above.
+    void addBox(const float lower[3], const float upper[3], const QColor &color);
+
+    //! Closes the current level, boxes added afterwards belong to the next.
+    void endLevel();
+};
+
+/**
+ * Single line-list geometry for overlays of many boxes.
+ *
+ * All segments are drawn from one vertex buffer with a single draw call
+ * instead of one GLC instance per box, and levels are contiguous so that
+ * filtering by level only narrows the drawn range. Data set without a
+ * current context is uploaded by the next render(), after which only the
+ * level offsets are kept in memory.
+ */
+class RepoLineOverlay
+{
+
+public:
+
+    RepoLineOverlay(const QColor &color = Qt::cyan);
+
+    //! Deletes the buffer if a context is current.
+    ~RepoLineOverlay();
+
+    //! Uploads the lines to the buffer right away if a context is current.
+    void setData(const RepoLineOverlayData &data);
+
+    //! Empties the overlay, deleting the buffer if a context is current or
+    //! keeping it for reuse otherwise.
+    void clear();
+
+    bool isEmpty() const { return vertexCount == 0; }
+
+    //! Returns the number of segments of all levels.
+    int getLineCount() const { return vertexCount / 2; }
+
+    int getLevelCount() const;
+
+    //! Returns the level drawn, -1 if all levels are drawn.
+    int getLevel() const { return level; }
+
+    //! Draws only the given level, -1 to draw all.
+    void setLevel(int level);
+
+    /**
+     * Draws the lines in a single call, uploading pending data first.
+     * Expects the camera matrices to be set and no shader to be bound.
+     */
+    void render();
+
+protected:
+
+    //! Moves pending vertices and colours into the buffer.
+    void upload(QOpenGLFunctions *f);
+
+    //! Vertices and colours until uploaded, level offsets for good.
+    RepoLineOverlayData data;
+
+    QColor color;
+
+    int level;
+
+    //! Vertex buffer, vertices followed by colours if any, 0 if none.
+    GLuint buffer;
+
+    int vertexCount;
+
+    bool hasColors;
+
+    //! True while the data is not in the buffer yet.
+    bool pending;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
+
+Q_DECLARE_METATYPE(repo::gui::renderer::RepoLineOverlayData)
@@ -0,0 +1,269 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_mesh_batch.h"
+
+//------------------------------------------------------------------------------
+#include <limits>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+//! Squared distance of p to the triangle abc, by its closest point.
+static double triangleDistance2(const double p[3],
+                                const GLfloat *a,
+                                const GLfloat *b,
+                                const GLfloat *c)
+{
+    double ab[3], ac[3], ap[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        ab[i] = b[i] - a[i];
+        ac[i] = c[i] - a[i];
+        ap[i] = p[i] - a[i];
+    }
+    auto dot = [](const double *u, const double *v)
+    { return u[0] * v[0] + u[1] * v[1] + u[2] * v[2]; };
+
+    //--------------------------------------------------------------------------
+    // Barycentric coordinates of the closest point, by Voronoi region
+    double v, w;
+    const double d1 = dot(ab, ap), d2 = dot(ac, ap);
+    double bp[3], cp[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        bp[i] = p[i] - b[i];
+        cp[i] = p[i] - c[i];
+    }
+    const double d3 = dot(ab, bp), d4 = dot(ac, bp);
+    const double d5 = dot(ab, cp), d6 = dot(ac, cp);
+    const double va = d3 * d6 - d5 * d4;
+    const double vb = d5 * d2 - d1 * d6;
+    const double vc = d1 * d4 - d3 * d2;
+    if (d1 <= 0 && d2 <= 0)
+        v = w = 0;
+    else if (d3 >= 0 && d4 <= d3)
+        v = 1, w = 0;
+    else if (d6 >= 0 && d5 <= d6)
+        v = 0, w = 1;
+    else if (vc <= 0 && d1 >= 0 && d3 <= 0)
+        v = d1 / (d1 - d3), w = 0;
+    else if (vb <= 0 && d2 >= 0 && d6 <= 0)
+        v = 0, w = d2 / (d2 - d6);
+    else if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+    {
+        w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        v = 1 - w;
+    }
+    else
+    {
+        const double denominator = 1 / (va + vb + vc);
+        v = vb * denominator;
+        w = vc * denominator;
+    }
+
+    double distance2 = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        const double d = ap[i] - v * ab[i] - w * ac[i];
+        distance2 += d * d;
+    }
+    return distance2;
+}
+
+RepoMeshBatch::RepoMeshBatch(GLC_Material *sharedMaterial)
+    : GLC_Mesh()
+    , sharedMaterial(sharedMaterial)
+    , holdUsage(glc::GLC_GenID())
+    , dirty(false)
+{
+    sharedMaterial->addUsage(holdUsage);
+}
+
+RepoMeshBatch::RepoMeshBatch(const RepoMeshBatch &other)
+    : GLC_Mesh(other)
+    , sharedMaterial(other.sharedMaterial)
+    , holdUsage(glc::GLC_GenID())
+    , members(other.members)
+    , memberIndex(other.memberIndex)
+    , positions(other.positions)
+    , normals(other.normals)
+    , indices(other.indices)
+    , dirty(other.dirty)
+{
+    sharedMaterial->addUsage(holdUsage);
+    for (GLC_Material *material : getMemberMaterials())
+        material->addUsage(holdUsage);
+}
+
+RepoMeshBatch::~RepoMeshBatch()
+{
+    // Materials in groups go with the mesh, others only had this hold
+    std::vector<GLC_Material*> materials = getMemberMaterials();
+    materials.push_back(sharedMaterial);
+    for (GLC_Material *material : materials)
+    {
+        material->delUsage(holdUsage);
+        if (material->isUnused())
+            delete material;
+    }
+}
+
+void RepoMeshBatch::addMember(
+        const QString &id,
+        const QVector<GLfloat> &positions,
+        const QVector<GLfloat> &normals,
+        const QList<GLuint> &indices)
+{
+    Member member;
+    member.id = id;
+    member.firstVertex = (GLuint) (this->positions.size() / 3);
+    member.firstIndex = this->indices.size();
+    member.indexCount = indices.size();
+    member.material = nullptr;
+
+    this->positions += positions;
+    this->normals += normals;
+    for (const GLuint index : indices)
+        this->indices.append(index + member.firstVertex);
+
+    memberIndex[id] = members.size();
+    members.push_back(member);
+}
+
+void RepoMeshBatch::build()
+{
+    rebuild();
+    dirty = false;
+}
+
+std::vector<QString> RepoMeshBatch::getMemberIds() const
+{
+    std::vector<QString> ids;
+    ids.reserve(members.size());
+    for (const Member &member : members)
+        ids.push_back(member.id);
+    return ids;
+}
+
+std::vector<GLC_Material*> RepoMeshBatch::getMemberMaterials() const
+{
+    std::vector<GLC_Material*> materials;
+    for (const Member &member : members)
+        if (member.material)
+            materials.push_back(member.material);
+    return materials;
+}
+
+GLC_Material *RepoMeshBatch::getMemberMaterial(const QString &id) const
+{
+    auto it = memberIndex.find(id);
+    return it != memberIndex.end() ? members[it->second].material : nullptr;
+}
+
+GLC_Material *RepoMeshBatch::splitMember(const QString &id)
+{
+    auto it = memberIndex.find(id);
+    if (it == memberIndex.end())
+        return nullptr;
+
+    Member &member = members[it->second];
+    if (!member.material)
+    {
+        member.material = new GLC_Material(*sharedMaterial);
+        member.material->setId(glc::GLC_GenID());
+        member.material->setName(id);
+        member.material->addUsage(holdUsage);
+        dirty = true;
+    }
+    return member.material;
+}
+
+bool RepoMeshBatch::update()
+{
+    if (!dirty)
+        return false;
+    rebuild();
+    dirty = false;
+    return true;
+}
+
+QString RepoMeshBatch::findMember(const GLC_Point3d &point) const
+{
+    const double p[3] = { point.x(), point.y(), point.z() };
+    const GLfloat *data = positions.constData();
+
+    QString nearest;
+    double nearestDistance2 = std::numeric_limits<double>::max();
+    for (const Member &member : members)
+    {
+        for (int i = member.firstIndex; i + 2 < member.firstIndex + member.indexCount; i += 3)
+        {
+            const double distance2 = triangleDistance2(
+                        p,
+                        data + 3 * indices[i],
+                        data + 3 * indices[i + 1],
+                        data + 3 * indices[i + 2]);
+            if (distance2 < nearestDistance2)
+            {
+                nearestDistance2 = distance2;
+                nearest = member.id;
+            }
+        }
+    }
+    return nearest;
+}
+
+void RepoMeshBatch::rebuild()
+{
+    //--------------------------------------------------------------------------
+    // Clearing deletes materials no longer used, all of them are held
+    const QString meshName = name();
+    clear();
+    setName(meshName);
+
+    addVertice(positions);
+    addNormals(normals);
+
+    QList<GLuint> shared;
+    for (const Member &member : members)
+        if (!member.material)
+            shared += indices.mid(member.firstIndex, member.indexCount);
+    if (!shared.isEmpty())
+        addTriangles(sharedMaterial, shared);
+
+    for (const Member &member : members)
+        if (member.material)
+            addTriangles(member.material, indices.mid(member.firstIndex, member.indexCount));
+
+    //--------------------------------------------------------------------------
+    // Wireframe of the triangles, as for meshes converted on their own
+    GLfloatVector faceVertices;
+    for (int i = 0; i + 2 < indices.size(); i += 3)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            const int v = indices[i + j] * 3;
+            faceVertices << positions[v] << positions[v + 1] << positions[v + 2];
+        }
+        addVerticeGroup(faceVertices);
+        faceVertices.clear();
+    }
+
+    finish();
+}
@@ -0,0 +1,140 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <QString>
+
+#include <GLC_Material>
+#include <GLC_Point3d>
+#include "geometry/glc_mesh.h"
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+/**
+ * Combined mesh of small meshes that render with the same material.
+ *
+ * All members are drawn from a single material group, hence a single draw
+ * call. Each member is recorded as a sub-range of the vertices and indices,
+ * so that picks on the batch can be resolved to a member on the CPU. A
+ * member is split out into a group of its own, with a copy of the shared
+ * material, only once it is recoloured or highlighted. Splitting regroups
+ * the same mesh object, so that windows sharing the geometry see the same
+ * groups and their mesh maps stay valid.
+ */
+class RepoMeshBatch : public GLC_Mesh
+{
+
+public:
+
+    //! Takes ownership of the material shared by the members.
+    RepoMeshBatch(GLC_Material *sharedMaterial);
+
+    RepoMeshBatch(const RepoMeshBatch &other);
+
+    ~RepoMeshBatch();
+
+    virtual GLC_Geometry* clone() const { return new RepoMeshBatch(*this); }
+
+    /**
+     * Appends a member, positions and normals being 3 floats per vertex and
+     * the triangle indices local to the member. Call build() once all are in.
+     */
+    void addMember(const QString &id,
+                   const QVector<GLfloat> &positions,
+                   const QVector<GLfloat> &normals,
+                   const QList<GLuint> &indices);
+
+    //! Creates the material groups of the members added so far.
+    void build();
+
+    //! Returns true if the ID names a member of this batch.
+    bool hasMember(const QString &id) const
+    { return memberIndex.find(id) != memberIndex.end(); }
+
+    //! Returns the unique IDs of the members in order.
+    std::vector<QString> getMemberIds() const;
+
+    GLC_Material *getSharedMaterial() const { return sharedMaterial; }
+
+    //! Returns the materials of members split so far.
+    std::vector<GLC_Material*> getMemberMaterials() const;
+
+    //! Returns the material of a split member, null if not split.
+    GLC_Material *getMemberMaterial(const QString &id) const;
+
+    /**
+     * Returns the material of the member, splitting it out of the shared
+     * group on the first call. Groups change with the next update().
+     * @return returns null if the ID is not a member
+     */
+    GLC_Material *splitMember(const QString &id);
+
+    /**
+     * Regroups the mesh if members were split since the last call. Drops
+     * the buffers of the mesh, hence expects a shared context to be current.
+     * @return returns true if the mesh changed
+     */
+    bool update();
+
+    /**
+     * Returns the member with the triangle nearest to the point, given in
+     * the coordinates of the batch, empty if there are no members.
+     */
+    QString findMember(const GLC_Point3d &point) const;
+
+private:
+
+    //! Re-adds vertices and groups from the recorded members.
+    void rebuild();
+
+    struct Member
+    {
+        QString id;
+        GLuint firstVertex;
+        int firstIndex;
+        int indexCount;
+        //! Own material once split, null while in the shared group.
+        GLC_Material *material;
+    };
+
+    GLC_Material *sharedMaterial;
+
+    //! Keeps the materials alive while no group uses them.
+    GLC_uint holdUsage;
+
+    std::vector<Member> members;
+    std::map<QString, size_t> memberIndex;
+
+    //! Copies of the data, GLC drops its own once in buffers.
+    QVector<GLfloat> positions;
+    QVector<GLfloat> normals;
+    QList<GLuint> indices;
+
+    bool dirty;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
@@ -0,0 +1,426 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_mesh_codec.h"
+#include "../../logger/repo_logger.h"
+
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+//! Largest value of a quantised position or texture coordinate.
+static const float REPO_CODEC_QUANTISATION = 65535.0f;
+
+//! Flags of the optional vertex streams.
+static const quint8 REPO_CODEC_NORMALS = 1;
+static const quint8 REPO_CODEC_TEXELS = 2;
+static const quint8 REPO_CODEC_COLORS = 4;
+
+//------------------------------------------------------------------------------
+// Stream helpers
+
+static quint32 zigzag(qint32 value)
+{
+    return ((quint32) value << 1) ^ (quint32) (value >> 31);
+}
+
+static qint32 unzigzag(quint32 value)
+{
+    return (qint32) (value >> 1) ^ -(qint32) (value & 1);
+}
+
+static void putVarint(QByteArray &out, quint32 value)
+{
+    while (value >= 0x80)
+    {
+        out.append((char) ((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append((char) value);
+}
+
+static void putFloat(QByteArray &out, float value)
+{
+    char bytes[sizeof(float)];
+    std::memcpy(bytes, &value, sizeof(float));
+    out.append(bytes, sizeof(float));
+}
+
+//! Sequential reader failing on truncated input.
+struct RepoCodecReader
+{
+    const char *data;
+    const char *end;
+
+    bool getVarint(quint32 &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 35 && data < end; shift += 7)
+        {
+            const quint8 byte = (quint8) *data++;
+            value |= (quint32) (byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool getFloat(float &value)
+    {
+        if (end - data < (int) sizeof(float))
+            return false;
+        std::memcpy(&value, data, sizeof(float));
+        data += sizeof(float);
+        return true;
+    }
+
+    bool getByte(quint8 &value)
+    {
+        if (data >= end)
+            return false;
+        value = (quint8) *data++;
+        return true;
+    }
+};
+
+//! Quantises the components of interleaved tuples over their bounds and
+//! appends them delta coded.
+static void putQuantised(QByteArray &out, const GLfloatVector &values, int components)
+{
+    std::vector<float> lower(components, 0), scale(components, 0);
+    const int count = values.size() / components;
+    for (int c = 0; c < components; ++c)
+    {
+        float minimum = count ? values[c] : 0, maximum = minimum;
+        for (int i = 1; i < count; ++i)
+        {
+            minimum = std::min(minimum, values[i * components + c]);
+            maximum = std::max(maximum, values[i * components + c]);
+        }
+        lower[c] = minimum;
+        scale[c] = (maximum - minimum) / REPO_CODEC_QUANTISATION;
+        putFloat(out, lower[c]);
+        putFloat(out, scale[c]);
+    }
+
+    std::vector<qint32> previous(components, 0);
+    for (int i = 0; i < count; ++i)
+    {
+        for (int c = 0; c < components; ++c)
+        {
+            const float value = values[i * components + c];
+            const qint32 q = scale[c] > 0 ?
+                        (qint32) std::lround((value - lower[c]) / scale[c]) : 0;
+            putVarint(out, zigzag(q - previous[c]));
+            previous[c] = q;
+        }
+    }
+}
+
+static bool getQuantised(RepoCodecReader &in, GLfloatVector &values, int count, int components)
+{
+    std::vector<float> lower(components), scale(components);
+    for (int c = 0; c < components; ++c)
+        if (!in.getFloat(lower[c]) || !in.getFloat(scale[c]))
+            return false;
+
+    values.resize(count * components);
+    std::vector<qint32> previous(components, 0);
+    for (int i = 0; i < count; ++i)
+    {
+        for (int c = 0; c < components; ++c)
+        {
+            quint32 delta;
+            if (!in.getVarint(delta))
+                return false;
+            previous[c] += unzigzag(delta);
+            values[i * components + c] = lower[c] + previous[c] * scale[c];
+        }
+    }
+    return true;
+}
+
+//! Octahedral mapping of a unit vector to two bytes.
+static void putOctahedral(QByteArray &out, float x, float y, float z)
+{
+    const float l1 = std::fabs(x) + std::fabs(y) + std::fabs(z);
+    if (l1 > 0)
+    {
+        x /= l1;
+        y /= l1;
+    }
+    else
+    {
+        x = y = 0;
+        z = 1;
+    }
+
+    if (z < 0)
+    {
+        const float ox = (1 - std::fabs(y)) * (x >= 0 ? 1 : -1);
+        const float oy = (1 - std::fabs(x)) * (y >= 0 ? 1 : -1);
+        x = ox;
+        y = oy;
+    }
+    out.append((char) (quint8) std::lround((x * 0.5f + 0.5f) * 255));
+    out.append((char) (quint8) std::lround((y * 0.5f + 0.5f) * 255));
+}
+
+static void getOctahedral(quint8 u, quint8 v, GLfloat *normal)
+{
+    float x = u / 255.0f * 2 - 1;
+    float y = v / 255.0f * 2 - 1;
+    const float z = 1 - std::fabs(x) - std::fabs(y);
+    if (z < 0)
+    {
+        const float ox = (1 - std::fabs(y)) * (x >= 0 ? 1 : -1);
+        const float oy = (1 - std::fabs(x)) * (y >= 0 ? 1 : -1);
+        x = ox;
+        y = oy;
+    }
+    const float length = std::sqrt(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+//------------------------------------------------------------------------------
+
+bool RepoMeshCodec::encode(const GLC_3DRep &rep, RepoCompressedMesh &mesh)
+{
+    mesh = RepoCompressedMesh();
+    mesh.name = rep.name();
+    for (int i = 0; i < rep.numberOfBody(); ++i)
+    {
+        const GLC_Mesh *glcMesh = dynamic_cast<const GLC_Mesh*>(rep.geomAt(i));
+        RepoCompressedBody body;
+        if (!glcMesh || !encodeBody(glcMesh, body, mesh.rawBytes))
+        {
+            mesh = RepoCompressedMesh();
+            return false;
+        }
+        mesh.compressedBytes += body.data.size();
+        mesh.bodies.push_back(body);
+    }
+    return !mesh.bodies.empty();
+}
+
+bool RepoMeshCodec::encodeBody(
+        const GLC_Mesh *glcMesh,
+        RepoCompressedBody &body,
+        qint64 &rawBytes)
+{
+    const GLfloatVector positions = glcMesh->positionVector();
+    const GLfloatVector normals = glcMesh->normalVector();
+    const GLfloatVector texels = glcMesh->texelVector();
+    const GLfloatVector colors = glcMesh->colorVector();
+    const int vertexCount = positions.size() / 3;
+    if (!vertexCount)
+        return false;
+
+    quint8 flags = 0;
+    if (normals.size() == vertexCount * 3)
+        flags |= REPO_CODEC_NORMALS;
+    if (texels.size() == vertexCount * 2)
+        flags |= REPO_CODEC_TEXELS;
+    if (colors.size() == vertexCount * 4)
+        flags |= REPO_CODEC_COLORS;
+
+    QByteArray out;
+    putVarint(out, vertexCount);
+    out.append((char) flags);
+
+    //--------------------------------------------------------------------------
+    // Vertex streams
+    putQuantised(out, positions, 3);
+    rawBytes += positions.size() * sizeof(GLfloat);
+    if (flags & REPO_CODEC_NORMALS)
+    {
+        for (int i = 0; i < vertexCount; ++i)
+            putOctahedral(out, normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]);
+        rawBytes += normals.size() * sizeof(GLfloat);
+    }
+    if (flags & REPO_CODEC_TEXELS)
+    {
+        putQuantised(out, texels, 2);
+        rawBytes += texels.size() * sizeof(GLfloat);
+    }
+    if (flags & REPO_CODEC_COLORS)
+    {
+        for (const GLfloat value : colors)
+            out.append((char) (quint8) std::lround(std::max(0.0f, std::min(1.0f, value)) * 255));
+        rawBytes += colors.size() * sizeof(GLfloat);
+    }
+
+    //--------------------------------------------------------------------------
+    // Triangle groups, one per material
+    const QList<GLC_uint> materialIds = glcMesh->materialIds();
+    putVarint(out, materialIds.size());
+    for (const GLC_uint id : materialIds)
+    {
+        const QVector<GLuint> indices = glcMesh->getTrianglesIndex(0, id);
+        putVarint(out, indices.size());
+        qint32 previous = 0;
+        for (const GLuint index : indices)
+        {
+            putVarint(out, zigzag((qint32) index - previous));
+            previous = (qint32) index;
+        }
+        rawBytes += indices.size() * sizeof(GLuint);
+        body.materials.push_back(GLC_Material(*glcMesh->material(id)));
+        body.materialIds.push_back(id);
+    }
+
+    body.name = glcMesh->name();
+    body.data = qCompress(out);
+    return true;
+}
+
+GLC_3DRep *RepoMeshCodec::decode(
+        const RepoCompressedMesh &mesh,
+        std::map<QString, GLC_Material*> &matMap)
+{
+    GLC_3DRep *rep = nullptr;
+    std::map<GLC_uint, GLC_Material*> materials;
+    for (const RepoCompressedBody &body : mesh.bodies)
+    {
+        GLC_Mesh *glcMesh = decodeBody(body, materials);
+        if (!glcMesh)
+        {
+            repoLogError("Corrupt compressed geometry of " + mesh.name.toStdString());
+            delete rep;
+            return nullptr;
+        }
+        if (rep)
+            rep->addGeom(glcMesh);
+        else
+            rep = new GLC_3DRep(glcMesh);
+    }
+
+    if (rep)
+    {
+        rep->setName(mesh.name);
+        rep->clean();
+        for (const auto &pair : mesh.materialKeys)
+        {
+            auto it = materials.find(pair.second);
+            if (it != materials.end())
+                matMap[pair.first] = it->second;
+        }
+    }
+    return rep;
+}
+
+GLC_Mesh *RepoMeshCodec::decodeBody(
+        const RepoCompressedBody &body,
+        std::map<GLC_uint, GLC_Material*> &materials)
+{
+    const QByteArray data = qUncompress(body.data);
+    RepoCodecReader in = { data.constData(), data.constData() + data.size() };
+
+    quint32 vertexCount;
+    quint8 flags;
+    if (!in.getVarint(vertexCount) || !in.getByte(flags))
+        return nullptr;
+
+    //--------------------------------------------------------------------------
+    // Vertex streams
+    GLfloatVector positions, normals, texels, colors;
+    if (!getQuantised(in, positions, vertexCount, 3))
+        return nullptr;
+    if (flags & REPO_CODEC_NORMALS)
+    {
+        normals.resize(vertexCount * 3);
+        for (quint32 i = 0; i < vertexCount; ++i)
+        {
+            quint8 u, v;
+            if (!in.getByte(u) || !in.getByte(v))
+                return nullptr;
+            getOctahedral(u, v, normals.data() + i * 3);
+        }
+    }
+    if ((flags & REPO_CODEC_TEXELS) && !getQuantised(in, texels, vertexCount, 2))
+        return nullptr;
+    if (flags & REPO_CODEC_COLORS)
+    {
+        colors.resize(vertexCount * 4);
+        for (GLfloat &value : colors)
+        {
+            quint8 byte;
+            if (!in.getByte(byte))
+                return nullptr;
+            value = byte / 255.0f;
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Triangle groups
+    quint32 groupCount;
+    if (!in.getVarint(groupCount) || groupCount != body.materials.size() ||
+            groupCount != body.materialIds.size())
+        return nullptr;
+
+    std::vector<QList<GLuint>> groups(groupCount);
+    for (QList<GLuint> &indices : groups)
+    {
+        quint32 count;
+        if (!in.getVarint(count))
+            return nullptr;
+        qint32 previous = 0;
+        for (quint32 i = 0; i < count; ++i)
+        {
+            quint32 delta;
+            if (!in.getVarint(delta))
+                return nullptr;
+            previous += unzigzag(delta);
+            if (previous < 0 || (quint32) previous >= vertexCount)
+                return nullptr;
+            indices.append((GLuint) previous);
+        }
+    }
+
+    GLC_Mesh *glcMesh = new GLC_Mesh;
+    glcMesh->setName(body.name);
+    glcMesh->addVertice(positions);
+    if (!normals.isEmpty())
+        glcMesh->addNormals(normals);
+    if (!texels.isEmpty())
+        glcMesh->addTexels(texels);
+    if (!colors.isEmpty())
+    {
+        glcMesh->setColorPearVertex(true);
+        glcMesh->addColors(colors);
+    }
+    for (quint32 g = 0; g < groupCount; ++g)
+    {
+        // New IDs as at conversion, shared where the originals were
+        GLC_Material *&material = materials[body.materialIds[g]];
+        if (!material)
+        {
+            material = new GLC_Material(body.materials[g]);
+            material->setId(glc::GLC_GenID());
+        }
+        glcMesh->addTriangles(material, groups[g]);
+    }
+    glcMesh->finish();
+    return glcMesh;
+}
@@ -0,0 +1,115 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+
+#include <GLC_3DRep>
+#include <GLC_Material>
+#include "geometry/glc_mesh.h"
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+//! Encoded body of a representation with copies of its materials.
+struct RepoCompressedBody
+{
+    QString name;
+
+    //! Compressed vertex and index streams.
+    QByteArray data;
+
+    //! Materials of the triangle groups in stream order.
+    std::vector<GLC_Material> materials;
+
+    //! IDs the materials had, equal where bodies shared a material.
+    std::vector<GLC_uint> materialIds;
+};
+
+//! Encoded representation, empty if nothing was encoded.
+struct RepoCompressedMesh
+{
+    QString name;
+
+    std::vector<RepoCompressedBody> bodies;
+
+    //! Material map keys of the renderer by encoded material ID.
+    std::map<QString, GLC_uint> materialKeys;
+
+    //! Size of the float arrays and indices before encoding.
+    qint64 rawBytes;
+
+    qint64 compressedBytes;
+
+    RepoCompressedMesh() : rawBytes(0), compressedBytes(0) {}
+
+    bool isEmpty() const { return bodies.empty(); }
+};
+
+/**
+ * Compact in-memory encoding of GLC meshes for geometry that is not drawn.
+ *
+ * Positions and texture coordinates are quantised to 16 bits over their
+ * bounds and delta coded between consecutive vertices, normals are stored
+ * as 8 bit octahedral pairs, colours as bytes and triangle indices as
+ * deltas to the previous index. Deltas are zigzag varints, which leaves
+ * mostly small repetitive bytes that the entropy coding of qCompress
+ * shrinks well. Polygon outlines used for wireframes are not kept.
+ */
+class RepoMeshCodec
+{
+
+public:
+
+    /**
+     * Encodes all mesh bodies of the representation, which needs its
+     * vertex arrays in client memory, i.e. not yet moved into VBOs.
+     * @return returns false if any body has no data to encode
+     */
+    static bool encode(const GLC_3DRep &rep, RepoCompressedMesh &mesh);
+
+    /**
+     * Decodes the bodies into a new representation with new materials.
+     * @param matMap receives the new materials under their material keys
+     * @return returns nullptr if the data is corrupt
+     */
+    static GLC_3DRep *decode(const RepoCompressedMesh &mesh,
+                             std::map<QString, GLC_Material*> &matMap);
+
+protected:
+
+    static bool encodeBody(const GLC_Mesh *glcMesh, RepoCompressedBody &body, qint64 &rawBytes);
+
+    /**
+     * @param materials new materials by their encoded ID, shared between
+     *        the bodies of a representation
+     */
+    static GLC_Mesh *decodeBody(const RepoCompressedBody &body,
+                                std::map<GLC_uint, GLC_Material*> &materials);
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
@@ -0,0 +1,470 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_occlusion_culler.h"
+
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+//------------------------------------------------------------------------------
+#include "geometry/glc_mesh.h"
+#include <GLC_Camera>
+//------------------------------------------------------------------------------
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define REPO_OCCLUSION_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace repo::gui::renderer;
+
+//! Maximum number of occluder candidates retained from a world.
+static const size_t REPO_OCCLUSION_MAX_CANDIDATES = 1024;
+
+//! Meshes with more triangles than this are too costly to rasterise.
+static const unsigned int REPO_OCCLUSION_MAX_OCCLUDER_TRIANGLES = 2048;
+
+//! Number of occluders rasterised per frame.
+static const size_t REPO_OCCLUSION_MAX_OCCLUDERS_PER_FRAME = 64;
+
+//! Clip space w below which a vertex is considered behind the camera.
+static const float REPO_OCCLUSION_NEAR_W = 1e-5f;
+
+//! Depth bias to compensate for the coarse depth buffer resolution.
+static const float REPO_OCCLUSION_DEPTH_BIAS = 1e-4f;
+
+RepoOcclusionCuller::RepoOcclusionCuller(int width, int height)
+    : enabled(false)
+    , width(width)
+    , height(height)
+    , stride((width + 3) & ~3)
+    , depth(stride * height, FLT_MAX)
+    , culledCount(0)
+    , rasterisedCount(0)
+    , testedCount(0)
+{
+    std::fill(viewProjection, viewProjection + 16, 0.0);
+}
+
+RepoOcclusionCuller::~RepoOcclusionCuller() {}
+
+void RepoOcclusionCuller::clear()
+{
+    restore();
+    occluders.clear();
+}
+
+void RepoOcclusionCuller::setOccluders(GLC_World &world)
+{
+    clear();
+
+    //--------------------------------------------------------------------------
+    // Rank instances by their extent, largest first
+    QList<GLC_3DViewInstance*> instances = world.collection()->instancesHandle();
+    std::vector<std::pair<double, GLC_3DViewInstance*>> candidates;
+    candidates.reserve(instances.size());
+    for (GLC_3DViewInstance *instance : instances)
+    {
+        const GLC_BoundingBox bbox = instance->boundingBox();
+        if (bbox.isEmpty())
+            continue;
+
+        // Glazing is large and cheap but hides nothing behind it
+        unsigned int triangles = 0;
+        bool transparent = false;
+        for (int i = 0; i < instance->numberOfGeometry(); ++i)
+        {
+            triangles += instance->geomAt(i)->faceCount(0);
+            transparent |= instance->geomAt(i)->hasTransparentMaterials();
+        }
+        if (transparent)
+            continue;
+
+        if (triangles && triangles <= REPO_OCCLUSION_MAX_OCCLUDER_TRIANGLES)
+            candidates.push_back(std::make_pair(bbox.boundingSphereRadius(), instance));
+    }
+
+    const size_t count = std::min(candidates.size(), REPO_OCCLUSION_MAX_CANDIDATES);
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+                      [](const std::pair<double, GLC_3DViewInstance*> &a,
+                         const std::pair<double, GLC_3DViewInstance*> &b)
+    { return a.first > b.first; });
+
+    //--------------------------------------------------------------------------
+    // Cache triangles in world coordinates
+    occluders.reserve(count);
+    for (size_t c = 0; c < count; ++c)
+    {
+        GLC_3DViewInstance *instance = candidates[c].second;
+        const double *m = instance->matrix().getData();
+
+        Occluder occluder;
+        occluder.instance = instance;
+        occluder.center = instance->boundingBox().center();
+        occluder.radius = candidates[c].first;
+
+        for (int i = 0; i < instance->numberOfGeometry(); ++i)
+        {
+            GLC_Mesh *mesh = dynamic_cast<GLC_Mesh*>(instance->geomAt(i));
+            if (!mesh)
+                continue;
+
+            const GLfloatVector positions = mesh->positionVector();
+            for (const GLC_uint matId : mesh->materialIds())
+            {
+                if (!mesh->containsTriangles(0, matId))
+                    continue;
+
+                const QVector<GLuint> indices = mesh->getTrianglesIndex(0, matId);
+                for (const GLuint index : indices)
+                {
+                    const int p = index * 3;
+                    if (p + 2 >= positions.size())
+                        continue;
+                    const double x = positions[p];
+                    const double y = positions[p + 1];
+                    const double z = positions[p + 2];
+                    occluder.triangles.push_back(m[0] * x + m[4] * y + m[8]  * z + m[12]);
+                    occluder.triangles.push_back(m[1] * x + m[5] * y + m[9]  * z + m[13]);
+                    occluder.triangles.push_back(m[2] * x + m[6] * y + m[10] * z + m[14]);
+                }
+            }
+        }
+
+        // Drop any incomplete trailing triangle
+        occluder.triangles.resize(occluder.triangles.size() - occluder.triangles.size() % 9);
+        if (!occluder.triangles.empty())
+            occluders.push_back(std::move(occluder));
+    }
+}
+
+void RepoOcclusionCuller::restore()
+{
+    for (const auto &pair : culled)
+        pair.first->setViewable(pair.second);
+    culled.clear();
+}
+
+int RepoOcclusionCuller::cull(GLC_World &world, GLC_Viewport &viewport)
+{
+    culledCount = 0;
+    rasterisedCount = 0;
+    testedCount = 0;
+
+    if (!enabled || occluders.empty())
+        return 0;
+
+    updateViewProjection(viewport);
+    clearDepth();
+
+    //--------------------------------------------------------------------------
+    // Pick the occluders with the largest angular size
+    const GLC_Point3d eye = viewport.cameraHandle()->eye();
+    std::vector<std::pair<double, const Occluder*>> ranked;
+    ranked.reserve(occluders.size());
+    for (const Occluder &occluder : occluders)
+    {
+        const GLC_3DViewInstance *instance = occluder.instance;
+        if (!instance->isVisible() ||
+                instance->viewableFlag() == GLC_3DViewInstance::NoViewable)
+            continue;
+
+        const double distance = (occluder.center - eye).length();
+        const double score = distance > occluder.radius ?
+                    occluder.radius / distance : DBL_MAX;
+        ranked.push_back(std::make_pair(score, &occluder));
+    }
+
+    const size_t count = std::min(ranked.size(), REPO_OCCLUSION_MAX_OCCLUDERS_PER_FRAME);
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(),
+                      [](const std::pair<double, const Occluder*> &a,
+                         const std::pair<double, const Occluder*> &b)
+    { return a.first > b.first; });
+
+    for (size_t i = 0; i < count; ++i)
+        rasteriseOccluder(*ranked[i].second);
+    rasterisedCount = (int) count;
+
+    //--------------------------------------------------------------------------
+    // Test all remaining viewable instances
+    for (GLC_3DViewInstance *instance : world.collection()->instancesHandle())
+    {
+        const GLC_3DViewInstance::Viewable flag = instance->viewableFlag();
+        if (!instance->isVisible() || flag == GLC_3DViewInstance::NoViewable)
+            continue;
+
+        ++testedCount;
+        if (isOccluded(instance->boundingBox()))
+        {
+            culled.push_back(std::make_pair(instance, flag));
+            instance->setViewable(GLC_3DViewInstance::NoViewable);
+        }
+    }
+
+    culledCount = (int) culled.size();
+    return culledCount;
+}
+
+void RepoOcclusionCuller::updateViewProjection(GLC_Viewport &viewport)
+{
+    const GLC_Matrix4x4 composition = viewport.projectionMatrix() *
+            viewport.cameraHandle()->modelViewMatrix();
+    std::copy(composition.getData(), composition.getData() + 16, viewProjection);
+}
+
+void RepoOcclusionCuller::clearDepth()
+{
+    std::fill(depth.begin(), depth.end(), FLT_MAX);
+}
+
+bool RepoOcclusionCuller::project(double x, double y, double z, float *out) const
+{
+    const double *m = viewProjection;
+    const double w = m[3] * x + m[7] * y + m[11] * z + m[15];
+    if (w <= REPO_OCCLUSION_NEAR_W)
+        return false;
+
+    const double cx = m[0] * x + m[4] * y + m[8]  * z + m[12];
+    const double cy = m[1] * x + m[5] * y + m[9]  * z + m[13];
+    const double cz = m[2] * x + m[6] * y + m[10] * z + m[14];
+    out[0] = (float) ((cx / w * 0.5 + 0.5) * width);
+    out[1] = (float) ((cy / w * 0.5 + 0.5) * height);
+    out[2] = (float) (cz / w);
+    return true;
+}
+
+void RepoOcclusionCuller::rasteriseOccluder(const Occluder &occluder)
+{
+    const double *m = viewProjection;
+    const std::vector<float> &tris = occluder.triangles;
+
+    for (size_t t = 0; t + 8 < tris.size(); t += 9)
+    {
+        //----------------------------------------------------------------------
+        // Transform into clip space
+        float clip[3][4];
+        int behind = 0;
+        for (int v = 0; v < 3; ++v)
+        {
+            const float x = tris[t + v * 3];
+            const float y = tris[t + v * 3 + 1];
+            const float z = tris[t + v * 3 + 2];
+            clip[v][0] = (float) (m[0] * x + m[4] * y + m[8]  * z + m[12]);
+            clip[v][1] = (float) (m[1] * x + m[5] * y + m[9]  * z + m[13]);
+            clip[v][2] = (float) (m[2] * x + m[6] * y + m[10] * z + m[14]);
+            clip[v][3] = (float) (m[3] * x + m[7] * y + m[11] * z + m[15]);
+            if (clip[v][3] <= REPO_OCCLUSION_NEAR_W)
+                ++behind;
+        }
+
+        if (behind == 3)
+            continue;
+
+        //----------------------------------------------------------------------
+        // Clip against the near plane (Sutherland-Hodgman), at most 4 vertices
+        float polygon[4][4];
+        int n = 0;
+        for (int v = 0; v < 3; ++v)
+        {
+            const float *a = clip[v];
+            const float *b = clip[(v + 1) % 3];
+            const bool aIn = a[3] > REPO_OCCLUSION_NEAR_W;
+            const bool bIn = b[3] > REPO_OCCLUSION_NEAR_W;
+            if (aIn)
+                std::copy(a, a + 4, polygon[n++]);
+            if (aIn != bIn)
+            {
+                const float s = (REPO_OCCLUSION_NEAR_W - a[3]) / (b[3] - a[3]);
+                for (int k = 0; k < 4; ++k)
+                    polygon[n][k] = a[k] + s * (b[k] - a[k]);
+                polygon[n][3] = REPO_OCCLUSION_NEAR_W * 1.0001f;
+                ++n;
+            }
+        }
+
+        //----------------------------------------------------------------------
+        // Project to screen space and fan triangulate
+        float screen[4][3];
+        for (int v = 0; v < n; ++v)
+        {
+            const float invW = 1.0f / polygon[v][3];
+            screen[v][0] = (polygon[v][0] * invW * 0.5f + 0.5f) * width;
+            screen[v][1] = (polygon[v][1] * invW * 0.5f + 0.5f) * height;
+            screen[v][2] = polygon[v][2] * invW;
+        }
+
+        for (int v = 1; v + 1 < n; ++v)
+            rasteriseTriangle(screen[0], screen[v], screen[v + 1]);
+    }
+}
+
+void RepoOcclusionCuller::rasteriseTriangle(
+        const float *v0, const float *v1, const float *v2)
+{
+    float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v2[0] - v0[0]) * (v1[1] - v0[1]);
+    if (std::fabs(area) < 1e-8f)
+        return;
+
+    // Occluders are rendered double sided, hence enforce counter clockwise
+    if (area < 0)
+    {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    //--------------------------------------------------------------------------
+    // Screen space bounds
+    const int minX = std::max(0, (int) std::floor(std::min(v0[0], std::min(v1[0], v2[0]))));
+    const int maxX = std::min(width - 1, (int) std::ceil(std::max(v0[0], std::max(v1[0], v2[0]))));
+    const int minY = std::max(0, (int) std::floor(std::min(v0[1], std::min(v1[1], v2[1]))));
+    const int maxY = std::min(height - 1, (int) std::ceil(std::max(v0[1], std::max(v1[1], v2[1]))));
+    if (minX > maxX || minY > maxY)
+        return;
+
+    //--------------------------------------------------------------------------
+    // Edge functions E(p) = A * px + B * py + C, positive inside
+    const float a12 = v1[1] - v2[1], b12 = v2[0] - v1[0], c12 = v1[0] * v2[1] - v2[0] * v1[1];
+    const float a20 = v2[1] - v0[1], b20 = v0[0] - v2[0], c20 = v2[0] * v0[1] - v0[0] * v2[1];
+    const float a01 = v0[1] - v1[1], b01 = v1[0] - v0[0], c01 = v0[0] * v1[1] - v1[0] * v0[1];
+
+    // Depth plane from barycentric weights
+    const float invArea = 1.0f / area;
+    const float za = (a12 * v0[2] + a20 * v1[2] + a01 * v2[2]) * invArea;
+    const float zb = (b12 * v0[2] + b20 * v1[2] + b01 * v2[2]) * invArea;
+    const float zc = (c12 * v0[2] + c20 * v1[2] + c01 * v2[2]) * invArea;
+
+    // Rows are padded to a multiple of 4 so blocks never overrun
+    const int startX = minX & ~3;
+
+    for (int y = minY; y <= maxY; ++y)
+    {
+        const float py = y + 0.5f;
+        float *row = &depth[y * stride];
+
+#ifdef REPO_OCCLUSION_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 four = _mm_set1_ps(4.0f);
+        const __m128 a12v = _mm_set1_ps(a12), a20v = _mm_set1_ps(a20), a01v = _mm_set1_ps(a01);
+        const __m128 zav = _mm_set1_ps(za);
+        const __m128 e12Row = _mm_set1_ps(b12 * py + c12);
+        const __m128 e20Row = _mm_set1_ps(b20 * py + c20);
+        const __m128 e01Row = _mm_set1_ps(b01 * py + c01);
+        const __m128 zRow = _mm_set1_ps(zb * py + zc);
+
+        __m128 px = _mm_add_ps(_mm_set1_ps((float) startX),
+                               _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+        for (int x = startX; x <= maxX; x += 4)
+        {
+            const __m128 e12 = _mm_add_ps(_mm_mul_ps(a12v, px), e12Row);
+            const __m128 e20 = _mm_add_ps(_mm_mul_ps(a20v, px), e20Row);
+            const __m128 e01 = _mm_add_ps(_mm_mul_ps(a01v, px), e01Row);
+            const __m128 inside = _mm_and_ps(_mm_cmpge_ps(e12, zero),
+                                             _mm_and_ps(_mm_cmpge_ps(e20, zero),
+                                                        _mm_cmpge_ps(e01, zero)));
+            if (_mm_movemask_ps(inside))
+            {
+                const __m128 z = _mm_add_ps(_mm_mul_ps(zav, px), zRow);
+                const __m128 current = _mm_loadu_ps(row + x);
+                const __m128 nearest = _mm_min_ps(current, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest),
+                                                 _mm_andnot_ps(inside, current)));
+            }
+            px = _mm_add_ps(px, four);
+        }
+#else
+        for (int x = startX; x <= maxX; ++x)
+        {
+            const float px = x + 0.5f;
+            if (a12 * px + b12 * py + c12 >= 0 &&
+                    a20 * px + b20 * py + c20 >= 0 &&
+                    a01 * px + b01 * py + c01 >= 0)
+            {
+                const float z = za * px + zb * py + zc;
+                if (z < row[x])
+                    row[x] = z;
+            }
+        }
+#endif
+    }
+}
+
+bool RepoOcclusionCuller::isRectOccluded(
+        int minX, int minY, int maxX, int maxY, float minZ) const
+{
+    const float threshold = minZ - REPO_OCCLUSION_DEPTH_BIAS;
+    for (int y = minY; y <= maxY; ++y)
+    {
+        const float *row = &depth[y * stride];
+        int x = minX;
+#ifdef REPO_OCCLUSION_SSE2
+        const __m128 thresholdv = _mm_set1_ps(threshold);
+        for (; x + 3 <= maxX; x += 4)
+        {
+            // Any texel at or beyond the box means the box may be visible
+            if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), thresholdv)))
+                return false;
+        }
+#endif
+        for (; x <= maxX; ++x)
+        {
+            if (row[x] >= threshold)
+                return false;
+        }
+    }
+    return true;
+}
+
+bool RepoOcclusionCuller::isOccluded(const GLC_BoundingBox &bbox) const
+{
+    if (bbox.isEmpty())
+        return false;
+
+    const GLC_Point3d &lower = bbox.lowerCorner();
+    const GLC_Point3d &upper = bbox.upperCorner();
+
+    float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+    float maxX = -FLT_MAX, maxY = -FLT_MAX;
+    for (int i = 0; i < 8; ++i)
+    {
+        float p[3];
+        if (!project(i & 1 ? upper.x() : lower.x(),
+                     i & 2 ? upper.y() : lower.y(),
+                     i & 4 ? upper.z() : lower.z(), p))
+        {
+            // Box straddles the camera, treat as visible
+            return false;
+        }
+        minX = std::min(minX, p[0]);
+        maxX = std::max(maxX, p[0]);
+        minY = std::min(minY, p[1]);
+        maxY = std::max(maxY, p[1]);
+        minZ = std::min(minZ, p[2]);
+    }
+
+    const int x0 = std::max(0, (int) std::floor(minX));
+    const int x1 = std::min(width - 1, (int) std::floor(maxX));
+    const int y0 = std::max(0, (int) std::floor(minY));
+    const int y1 = std::min(height - 1, (int) std::floor(maxY));
+
+    // Entirely off screen is left to frustum culling
+    if (x0 > x1 || y0 > y1)
+        return false;
+
+    return isRectOccluded(x0, y0, x1, y1, minZ);
+}
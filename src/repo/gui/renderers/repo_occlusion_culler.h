@@ -0,0 +1,165 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <vector>
+#include <utility>
+
+#include <GLC_World>
+#include <GLC_Viewport>
+#include <GLC_3DViewInstance>
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+/**
+ * CPU occlusion culling pass.
+ *
+ * Rasterises a low resolution depth buffer from the largest occluders that
+ * are close to the camera and tests the bounding box of every viewable
+ * instance against it. Instances whose boxes are entirely behind the
+ * occluders are flagged as not viewable for the current frame so that GLC
+ * skips them in glcWorld.render().
+ *
+ * Usage per frame:
+ *  1) restore() before the collection recomputes its frustum viewable state,
+ *  2) cull() once the viewable state and the camera are up to date.
+ */
+class RepoOcclusionCuller
+{
+
+public:
+
+    RepoOcclusionCuller(int width = 256, int height = 128);
+
+    ~RepoOcclusionCuller();
+
+    /**
+     * Collects occluder candidates from the given world. Only meshes that
+     * are large in extent but cheap in triangles are retained (walls, slabs,
+     * etc.) and their triangles are cached in world coordinates.
+     * Must be called before the meshes are moved into VBOs.
+     * @param world world to collect the occluders from
+     */
+    void setOccluders(GLC_World &world);
+
+    /**
+     * Drops all cached occluders and restores any culled instances.
+     */
+    void clear();
+
+    /**
+     * Re-enables instances culled by the previous call to cull() by
+     * reinstating their original viewable flags.
+     */
+    void restore();
+
+    /**
+     * Runs the occlusion pass for the current camera of the viewport.
+     * @param world world whose instances are to be culled
+     * @param viewport viewport holding the current camera and projection
+     * @return returns the number of instances culled
+     */
+    int cull(GLC_World &world, GLC_Viewport &viewport);
+
+    void setEnabled(bool on) { enabled = on; }
+
+    bool isEnabled() const { return enabled; }
+
+    //! Returns the number of instances culled by the last pass.
+    int getCulledCount() const { return culledCount; }
+
+    //! Returns the number of occluders rasterised by the last pass.
+    int getOccluderCount() const { return rasterisedCount; }
+
+    //! Returns the number of instances tested by the last pass.
+    int getTestedCount() const { return testedCount; }
+
+protected:
+
+    //! Occluder candidate with its triangles in world coordinates.
+    struct Occluder
+    {
+        GLC_3DViewInstance *instance;
+        GLC_Point3d center;
+        double radius;
+        std::vector<float> triangles; //! 9 floats per triangle
+    };
+
+    //! Recomputes the view projection matrix from the viewport.
+    void updateViewProjection(GLC_Viewport &viewport);
+
+    //! Clears the depth buffer to the far plane.
+    void clearDepth();
+
+    /**
+     * Rasterises a single occluder into the depth buffer.
+     */
+    void rasteriseOccluder(const Occluder &occluder);
+
+    /**
+     * Rasterises a screen space triangle, vertices are x, y, z (ndc depth).
+     */
+    void rasteriseTriangle(const float *v0, const float *v1, const float *v2);
+
+    /**
+     * Returns true if the whole screen space rectangle is behind the depth
+     * buffer, i.e. every covered texel holds a nearer occluder depth.
+     */
+    bool isRectOccluded(int minX, int minY, int maxX, int maxY, float minZ) const;
+
+    /**
+     * Returns true if the given bounding box is fully occluded.
+     */
+    bool isOccluded(const GLC_BoundingBox &bbox) const;
+
+    /**
+     * Projects a world point to screen space.
+     * @return returns false if the point is behind the near plane
+     */
+    bool project(double x, double y, double z, float *out) const;
+
+    //! Whether the pass is active.
+    bool enabled;
+
+    //! Resolution of the depth buffer.
+    int width, height, stride;
+
+    //! Depth buffer, padded to a multiple of 4 for SIMD.
+    std::vector<float> depth;
+
+    //! Column major view projection matrix.
+    double viewProjection[16];
+
+    //! All occluder candidates.
+    std::vector<Occluder> occluders;
+
+    //! Instances culled by the last pass with their original flags.
+    std::vector<std::pair<GLC_3DViewInstance*, GLC_3DViewInstance::Viewable>> culled;
+
+    int culledCount;
+    int rasterisedCount;
+    int testedCount;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
@@ -0,0 +1,227 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_pixel_readback.h"
+
+//------------------------------------------------------------------------------
+#include <cstring>
+//------------------------------------------------------------------------------
+#include <QOpenGLContext>
+//------------------------------------------------------------------------------
+
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+
+using namespace repo::gui::renderer;
+
+//! Wait for a single read when polling with wait, one second in ns.
+static const GLuint64 REPO_READBACK_TIMEOUT = 1000000000;
+
+RepoPixelReadback::RepoPixelReadback()
+    : initialized(false)
+    , asynchronous(false)
+    , fenceSync(nullptr)
+    , clientWaitSync(nullptr)
+    , deleteSync(nullptr)
+    , mapBuffer(nullptr)
+    , unmapBuffer(nullptr)
+{}
+
+RepoPixelReadback::~RepoPixelReadback() {}
+
+bool RepoPixelReadback::initialize()
+{
+    if (initialized)
+        return asynchronous;
+    initialized = true;
+
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (!context || context->isOpenGLES())
+        return false;
+
+    const QSurfaceFormat format = context->format();
+    const bool hasPBO = format.version() >= qMakePair(2, 1) ||
+            context->hasExtension("GL_ARB_pixel_buffer_object");
+    const bool hasSync = format.version() >= qMakePair(3, 2) ||
+            context->hasExtension("GL_ARB_sync");
+    if (!hasPBO || !hasSync)
+        return false;
+
+    fenceSync = (FenceSync) context->getProcAddress("glFenceSync");
+    clientWaitSync = (ClientWaitSync) context->getProcAddress("glClientWaitSync");
+    deleteSync = (DeleteSync) context->getProcAddress("glDeleteSync");
+    mapBuffer = (MapBuffer) context->getProcAddress("glMapBuffer");
+    unmapBuffer = (UnmapBuffer) context->getProcAddress("glUnmapBuffer");
+
+    asynchronous = fenceSync && clientWaitSync && deleteSync && mapBuffer && unmapBuffer;
+    return asynchronous;
+}
+
+bool RepoPixelReadback::isAsynchronous()
+{
+    return initialize();
+}
+
+void RepoPixelReadback::readColor(const QRect &area, const ImageCallback &callback)
+{
+    Request request;
+    request.area = area;
+    request.imageCallback = callback;
+    read(request, GL_RGBA, GL_UNSIGNED_BYTE, 4);
+}
+
+void RepoPixelReadback::readDepth(const QRect &area, const DepthCallback &callback)
+{
+    Request request;
+    request.area = area;
+    request.depthCallback = callback;
+    read(request, GL_DEPTH_COMPONENT, GL_FLOAT, sizeof(float));
+}
+
+void RepoPixelReadback::read(Request &request, GLenum format, GLenum type, int pixelSize)
+{
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    const QRect &area = request.area;
+    const int size = area.width() * area.height() * pixelSize;
+
+    request.buffer = 0;
+    request.fence = 0;
+    f->glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    if (initialize())
+    {
+        f->glGenBuffers(1, &request.buffer);
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, request.buffer);
+        f->glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        // Offset into the bound buffer rather than a client pointer
+        f->glReadPixels(area.x(), area.y(), area.width(), area.height(), format, type, nullptr);
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        request.fence = fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    else
+    {
+        request.data.resize(size);
+        f->glReadPixels(area.x(), area.y(), area.width(), area.height(),
+                        format, type, request.data.data());
+    }
+
+    f->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    requests.push_back(request);
+}
+
+int RepoPixelReadback::poll(bool wait)
+{
+    int delivered = 0;
+    while (!requests.empty())
+    {
+        Request request = requests.front();
+        if (request.fence)
+        {
+            const GLenum status = clientWaitSync(
+                        request.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                        wait ? REPO_READBACK_TIMEOUT : 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break; // kept in order, later reads are not done either
+        }
+
+        // Popped first as callbacks may queue further reads
+        requests.pop_front();
+        deliver(request);
+        ++delivered;
+    }
+    return delivered;
+}
+
+void RepoPixelReadback::deliver(Request &request)
+{
+    if (request.buffer)
+    {
+        QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+        const int size = request.area.width() * request.area.height() *
+                (request.imageCallback ? 4 : (int) sizeof(float));
+
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, request.buffer);
+        const void *mapped = mapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        if (mapped)
+        {
+            request.data.resize(size);
+            std::memcpy(request.data.data(), mapped, size);
+            unmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        f->glDeleteBuffers(1, &request.buffer);
+        deleteSync(request.fence);
+    }
+
+    const QSize size = request.area.size();
+    if (request.imageCallback)
+    {
+        QImage image(size, QImage::Format_RGBA8888);
+        if (request.data.size() == size.width() * size.height() * 4)
+        {
+            // GL rows go upwards
+            for (int y = 0; y < size.height(); ++y)
+                std::memcpy(image.scanLine(size.height() - 1 - y),
+                            request.data.constData() + y * size.width() * 4,
+                            size.width() * 4);
+        }
+        else
+            image.fill(Qt::transparent);
+        request.imageCallback(image);
+    }
+    else if (request.depthCallback)
+    {
+        std::vector<float> depths(size.width() * size.height(), 1.0f);
+        if (request.data.size() == (int) (depths.size() * sizeof(float)))
+            std::memcpy(depths.data(), request.data.constData(), request.data.size());
+        request.depthCallback(depths, size);
+    }
+}
+
+void RepoPixelReadback::clear()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    for (Request &request : requests)
+    {
+        if (request.buffer && context)
+        {
+            context->functions()->glDeleteBuffers(1, &request.buffer);
+            deleteSync(request.fence);
+        }
+    }
+    requests.clear();
+}
@@ -0,0 +1,128 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include <QByteArray>
+#include <QImage>
+#include <QOpenGLFunctions>
+#include <QRect>
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+/**
+ * Asynchronous readback of the bound framebuffer.
+ *
+ * Reads go into pixel buffer objects followed by a fence, so that issuing
+ * them does not wait for the GPU. poll() hands the pixels to the callbacks
+ * once their fences have signalled, typically on the next frame, which
+ * lets many captures be pipelined. Without pixel buffer objects or sync
+ * objects the reads are synchronous but still delivered by poll().
+ * All calls expect the same GL context to be current.
+ */
+class RepoPixelReadback
+{
+
+public:
+
+    //! Receives the colours of the area, top row first.
+    typedef std::function<void(const QImage &)> ImageCallback;
+
+    //! Receives the window depths of the area, bottom row first.
+    typedef std::function<void(const std::vector<float> &, const QSize &)> DepthCallback;
+
+    RepoPixelReadback();
+
+    //! Drops pending reads without deleting GL objects, see clear().
+    ~RepoPixelReadback();
+
+    /**
+     * Starts reading the RGBA colours of the area of the bound framebuffer.
+     * @param area area in GL window coordinates, bottom left origin
+     */
+    void readColor(const QRect &area, const ImageCallback &callback);
+
+    /**
+     * Starts reading the depths of the area of the bound framebuffer.
+     * @param area area in GL window coordinates, bottom left origin
+     */
+    void readDepth(const QRect &area, const DepthCallback &callback);
+
+    /**
+     * Delivers the completed reads in the order they were issued.
+     * @param wait if true, waits for all pending reads
+     * @return returns the number of reads delivered
+     */
+    int poll(bool wait = false);
+
+    //! Deletes the GL objects of pending reads without delivering them.
+    void clear();
+
+    int getPendingCount() const { return (int) requests.size(); }
+
+    //! Returns true if reads do not stall, false if they fall back to glReadPixels.
+    bool isAsynchronous();
+
+protected:
+
+    struct Request
+    {
+        QRect area;
+        GLuint buffer;
+        GLsync fence;
+        QByteArray data; //!< pixels of synchronous reads
+        ImageCallback imageCallback;
+        DepthCallback depthCallback;
+    };
+
+    //! Resolves the entry points missing from QOpenGLFunctions.
+    bool initialize();
+
+    void read(Request &request, GLenum format, GLenum type, int pixelSize);
+
+    //! Copies the pixels out of the buffer and hands them over.
+    void deliver(Request &request);
+
+    std::deque<Request> requests;
+
+    bool initialized;
+    bool asynchronous;
+
+    typedef GLsync (QOPENGLF_APIENTRYP FenceSync)(GLenum, GLbitfield);
+    typedef GLenum (QOPENGLF_APIENTRYP ClientWaitSync)(GLsync, GLbitfield, GLuint64);
+    typedef void (QOPENGLF_APIENTRYP DeleteSync)(GLsync);
+    typedef void* (QOPENGLF_APIENTRYP MapBuffer)(GLenum, GLenum);
+    typedef GLboolean (QOPENGLF_APIENTRYP UnmapBuffer)(GLenum);
+
+    FenceSync fenceSync;
+    ClientWaitSync clientWaitSync;
+    DeleteSync deleteSync;
+    MapBuffer mapBuffer;
+    UnmapBuffer unmapBuffer;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
@@ -0,0 +1,606 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_point_cloud.h"
+#include "../../logger/repo_logger.h"
+
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <queue>
+#include <unordered_set>
+//------------------------------------------------------------------------------
+#include <QOpenGLContext>
+#include <QSettings>
+//------------------------------------------------------------------------------
+#include <GLC_Camera>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+const QString RepoPointCloud::REPO_SETTINGS_POINT_BUDGET = "RepoGUI/pointBudget";
+
+//! Points drawn per frame when not set.
+static const int REPO_POINT_DEFAULT_BUDGET = 5000000;
+
+//! Cells per side of the grid a node keeps one point per cell of.
+static const int REPO_POINT_GRID = 64;
+
+//! Nodes with fewer points keep all of them.
+static const int REPO_POINT_LEAF_SIZE = 20000;
+
+//! Deepest level, stops the split of coincident points.
+static const int REPO_POINT_MAX_DEPTH = 16;
+
+//! Chunks copied from the file into buffers per frame.
+static const int REPO_POINT_UPLOADS_PER_FRAME = 32;
+
+//! Nodes smaller than this on screen are not refined further.
+static const double REPO_POINT_MIN_NODE_PIXELS = 16;
+
+//! Largest point size of coarse levels seen from close by.
+static const double REPO_POINT_MAX_SIZE = 8;
+
+static const double REPO_POINT_PI = 3.14159265358979323846;
+
+//! Levels kept in memory while points stream in, 8^depth bucket files below.
+static const int REPO_POINT_BUCKET_DEPTH = 2;
+
+//! Points buffered per bucket before they are written.
+static const size_t REPO_POINT_BUCKET_BUFFER = 65536;
+
+RepoPointCloud::RepoPointCloud()
+    : points(nullptr)
+    , pointBudget(REPO_POINT_DEFAULT_BUDGET)
+    , renderedCount(0)
+    , residentCount(0)
+    , frame(0)
+{}
+
+RepoPointCloud::~RepoPointCloud()
+{
+    // Buffers go with their context, the chunk file with the cloud
+    file.close();
+    if (!data.path.isEmpty())
+        QFile::remove(data.path);
+}
+
+int RepoPointCloud::getBudgetSetting()
+{
+    QSettings settings;
+    const int budget = settings.value(
+                REPO_SETTINGS_POINT_BUDGET, REPO_POINT_DEFAULT_BUDGET).toInt();
+    return std::max(REPO_POINT_LEAF_SIZE, budget);
+}
+
+static quint32 getCellKey(const RepoPoint &point, const RepoPointCloudNode &node)
+{
+    quint32 key = 0;
+    for (int a = 0; a < 3; ++a)
+    {
+        const int cell = (int) ((point.position[a] - node.lower[a]) / node.spacing);
+        key = key * REPO_POINT_GRID + std::max(0, std::min(REPO_POINT_GRID - 1, cell));
+    }
+    return key;
+}
+
+static int getOctant(const RepoPoint &point, const RepoPointCloudNode &node)
+{
+    const float half = (node.upper[0] - node.lower[0]) / 2;
+    return (point.position[0] >= node.lower[0] + half ? 1 : 0) |
+            (point.position[1] >= node.lower[1] + half ? 2 : 0) |
+            (point.position[2] >= node.lower[2] + half ? 4 : 0);
+}
+
+static RepoPointCloudNode getChild(const RepoPointCloudNode &node, int octant)
+{
+    const float half = (node.upper[0] - node.lower[0]) / 2;
+    RepoPointCloudNode child;
+    for (int a = 0; a < 3; ++a)
+    {
+        child.lower[a] = (octant & (1 << a)) ? node.lower[a] + half : node.lower[a];
+        child.upper[a] = child.lower[a] + half;
+    }
+    return child;
+}
+
+bool RepoPointCloud::buildNodes(
+        std::vector<RepoPoint> &points,
+        int root,
+        int depth,
+        QFile &file,
+        qint64 &written,
+        RepoPointCloudData &data,
+        const volatile bool *cancelled)
+{
+    //--------------------------------------------------------------------------
+    // Depth first, each node owns a contiguous range of the points
+    struct Range
+    {
+        int node;
+        size_t begin;
+        size_t end;
+        int depth;
+    };
+    std::vector<Range> stack = { { root, 0, points.size(), depth } };
+    std::vector<unsigned char> kept;
+    std::unordered_set<quint32> cells;
+
+    while (!stack.empty())
+    {
+        if (cancelled && *cancelled)
+            return false;
+
+        const Range range = stack.back();
+        stack.pop_back();
+
+        RepoPointCloudNode node = data.nodes[range.node];
+        const float size = node.upper[0] - node.lower[0];
+        node.spacing = size / REPO_POINT_GRID;
+        std::fill(node.children, node.children + 8, -1);
+
+        size_t keptEnd = range.end;
+        if (range.end - range.begin > (size_t) REPO_POINT_LEAF_SIZE &&
+                range.depth < REPO_POINT_MAX_DEPTH)
+        {
+            //------------------------------------------------------------------
+            // One point per grid cell stays, kept points move to the front
+            cells.clear();
+            kept.assign(range.end - range.begin, 0);
+            for (size_t i = range.begin; i < range.end; ++i)
+                kept[i - range.begin] = cells.insert(getCellKey(points[i], node)).second;
+            keptEnd = range.begin;
+            for (size_t i = range.begin; i < range.end; ++i)
+                if (kept[i - range.begin])
+                    std::swap(points[i], points[keptEnd++]);
+
+            //------------------------------------------------------------------
+            // The rest is sorted by octant, one child per non-empty octant
+            std::sort(points.begin() + keptEnd, points.begin() + range.end,
+                      [&node](const RepoPoint &a, const RepoPoint &b)
+            {
+                return getOctant(a, node) < getOctant(b, node);
+            });
+
+            size_t begin = keptEnd;
+            while (begin < range.end)
+            {
+                const int octant = getOctant(points[begin], node);
+                size_t end = begin;
+                while (end < range.end && getOctant(points[end], node) == octant)
+                    ++end;
+
+                node.children[octant] = (int) data.nodes.size();
+                data.nodes.push_back(getChild(node, octant));
+                stack.push_back({ node.children[octant], begin, end, range.depth + 1 });
+                begin = end;
+            }
+        }
+
+        //----------------------------------------------------------------------
+        // Chunk of the node
+        node.offset = written;
+        node.count = (int) (keptEnd - range.begin);
+        const qint64 bytes = node.count * (qint64) sizeof(RepoPoint);
+        if (file.write((const char *) &points[range.begin], bytes) != bytes)
+        {
+            repoLogError("Failed to write point chunks to " + file.fileName().toStdString());
+            return false;
+        }
+        written += node.count;
+        data.nodes[range.node] = node;
+    }
+    return true;
+}
+
+RepoPointCloudBuilder::RepoPointCloudBuilder(
+        const QString &path,
+        const float lower[3],
+        const float upper[3])
+    : path(path)
+    , pointCount(0)
+    , failed(false)
+{
+    //--------------------------------------------------------------------------
+    // Cube around all points so that spacing is the same along every axis
+    RepoPointCloudNode root;
+    float extent = 0;
+    for (int i = 0; i < 3; ++i)
+        extent = std::max(extent, upper[i] - lower[i]);
+    extent = extent > 0 ? extent : 1;
+    for (int i = 0; i < 3; ++i)
+    {
+        root.lower[i] = lower[i];
+        root.upper[i] = lower[i] + extent;
+    }
+
+    size_t cellCount = 0;
+    size_t levelCount = 1;
+    for (int depth = 0; depth < REPO_POINT_BUCKET_DEPTH; ++depth, levelCount *= 8)
+        cellCount += levelCount;
+
+    cells.resize(cellCount);
+    cells[0].node = root;
+    for (size_t i = 0; i < cellCount; ++i)
+    {
+        RepoPointCloudNode &node = cells[i].node;
+        node.spacing = (node.upper[0] - node.lower[0]) / REPO_POINT_GRID;
+        cells[i].count = 0;
+        for (int octant = 0; octant < 8 && 8 * i + 1 + octant < cellCount; ++octant)
+            cells[8 * i + 1 + octant].node = getChild(node, octant);
+    }
+
+    buckets.resize(levelCount);
+    bucketBuffers.resize(levelCount);
+    bucketCounts.assign(levelCount, 0);
+    for (size_t b = 0; b < levelCount; ++b)
+    {
+        buckets[b].reset(new QFile(path + ".bucket" + QString::number(b)));
+        if (!buckets[b]->open(QIODevice::ReadWrite | QIODevice::Truncate))
+        {
+            repoLogError("Failed to write point bucket " + buckets[b]->fileName().toStdString());
+            failed = true;
+        }
+    }
+}
+
+RepoPointCloudBuilder::~RepoPointCloudBuilder()
+{
+    for (const auto &bucket : buckets)
+        bucket->remove();
+}
+
+bool RepoPointCloudBuilder::add(const RepoPoint *points, size_t count)
+{
+    for (size_t p = 0; p < count && !failed; ++p)
+    {
+        //----------------------------------------------------------------------
+        // Down the top levels until a cell keeps the point, else into a bucket
+        const RepoPoint &point = points[p];
+        size_t i = 0;
+        bool kept = false;
+        while (i < cells.size())
+        {
+            Cell &cell = cells[i];
+            ++cell.count;
+            if (cell.cells.insert(getCellKey(point, cell.node)).second)
+            {
+                cell.kept.push_back(point);
+                kept = true;
+                break;
+            }
+            i = 8 * i + 1 + getOctant(point, cell.node);
+        }
+        ++pointCount;
+        if (kept)
+            continue;
+
+        const size_t bucket = i - cells.size();
+        bucketBuffers[bucket].push_back(point);
+        ++bucketCounts[bucket];
+        if (bucketBuffers[bucket].size() >= REPO_POINT_BUCKET_BUFFER && !flush(bucket))
+            failed = true;
+    }
+    return !failed;
+}
+
+bool RepoPointCloudBuilder::flush(size_t bucket)
+{
+    std::vector<RepoPoint> &buffer = bucketBuffers[bucket];
+    const qint64 bytes = buffer.size() * (qint64) sizeof(RepoPoint);
+    const bool ok = buckets[bucket]->write((const char *) buffer.data(), bytes) == bytes;
+    if (!ok)
+        repoLogError("Failed to write point bucket " + buckets[bucket]->fileName().toStdString());
+    buffer.clear();
+    return ok;
+}
+
+bool RepoPointCloudBuilder::finish(RepoPointCloudData &data, const volatile bool *cancelled)
+{
+    data = RepoPointCloudData();
+    data.path = path;
+    if (failed || !pointCount)
+        return false;
+    for (size_t b = 0; b < buckets.size(); ++b)
+        if (!bucketBuffers[b].empty() && !flush(b))
+            return false;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        repoLogError("Failed to write point chunks to " + path.toStdString());
+        return false;
+    }
+
+    qint64 written = 0;
+    bool ok = true;
+    finishCell(0, 0, file, written, data, cancelled, ok);
+    data.pointCount = written;
+    return ok;
+}
+
+int RepoPointCloudBuilder::finishCell(
+        size_t cell,
+        int depth,
+        QFile &file,
+        qint64 &written,
+        RepoPointCloudData &data,
+        const volatile bool *cancelled,
+        bool &ok)
+{
+    //--------------------------------------------------------------------------
+    // Buckets are sorted in memory one at a time
+    if (cell >= cells.size())
+    {
+        const size_t bucket = cell - cells.size();
+        if (!bucketCounts[bucket] || !ok)
+            return -1;
+
+        std::vector<RepoPoint> points(bucketCounts[bucket]);
+        const qint64 bytes = points.size() * (qint64) sizeof(RepoPoint);
+        QFile &bucketFile = *buckets[bucket];
+        if (!bucketFile.seek(0) || bucketFile.read((char *) points.data(), bytes) != bytes)
+        {
+            repoLogError("Failed to read point bucket " + bucketFile.fileName().toStdString());
+            ok = false;
+            return -1;
+        }
+        bucketFile.resize(0);
+
+        const int index = (int) data.nodes.size();
+        data.nodes.push_back(getChild(cells[(cell - 1) / 8].node, (int) ((cell - 1) % 8)));
+        ok = RepoPointCloud::buildNodes(points, index, depth, file, written, data, cancelled);
+        return index;
+    }
+
+    //--------------------------------------------------------------------------
+    // Top level cells hold the subsample kept as the points streamed in
+    Cell &top = cells[cell];
+    if (!top.count || !ok || (cancelled && *cancelled))
+    {
+        ok = ok && !(cancelled && *cancelled);
+        return -1;
+    }
+
+    const int index = (int) data.nodes.size();
+    RepoPointCloudNode node = top.node;
+    std::fill(node.children, node.children + 8, -1);
+    node.offset = written;
+    node.count = (int) top.kept.size();
+    const qint64 bytes = node.count * (qint64) sizeof(RepoPoint);
+    if (file.write((const char *) top.kept.data(), bytes) != bytes)
+    {
+        repoLogError("Failed to write point chunks to " + path.toStdString());
+        ok = false;
+        return -1;
+    }
+    written += node.count;
+    std::vector<RepoPoint>().swap(top.kept);
+    data.nodes.push_back(node);
+
+    for (int octant = 0; octant < 8; ++octant)
+    {
+        const int child = finishCell(8 * cell + 1 + octant, depth + 1,
+                                     file, written, data, cancelled, ok);
+        data.nodes[index].children[octant] = child;
+    }
+    return index;
+}
+
+void RepoPointCloud::setData(const RepoPointCloudData &data)
+{
+    clear();
+    if (data.nodes.empty())
+        return;
+
+    file.setFileName(data.path);
+    if (file.open(QIODevice::ReadOnly))
+        points = (const RepoPoint *) file.map(0, file.size());
+    if (!points)
+    {
+        repoLogError("Failed to map point chunks " + data.path.toStdString());
+        file.close();
+        QFile::remove(data.path);
+        return;
+    }
+    this->data = data;
+}
+
+void RepoPointCloud::clear()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (context)
+        for (const auto &pair : resident)
+            context->functions()->glDeleteBuffers(1, &pair.second.buffer);
+    resident.clear();
+    lru.clear();
+    residentCount = 0;
+    renderedCount = 0;
+
+    points = nullptr;
+    file.close();
+    if (!data.path.isEmpty())
+        QFile::remove(data.path);
+    data = RepoPointCloudData();
+}
+
+GLC_BoundingBox RepoPointCloud::getBoundingBox() const
+{
+    if (data.nodes.empty())
+        return GLC_BoundingBox();
+    const RepoPointCloudNode &root = data.nodes[0];
+    return GLC_BoundingBox(GLC_Point3d(root.lower[0], root.lower[1], root.lower[2]),
+                           GLC_Point3d(root.upper[0], root.upper[1], root.upper[2]));
+}
+
+bool RepoPointCloud::render(GLC_Viewport &viewport)
+{
+    renderedCount = 0;
+    if (data.nodes.empty())
+        return false;
+    ++frame;
+
+    //--------------------------------------------------------------------------
+    // Pixels per world unit at unit distance
+    const GLC_Camera *camera = viewport.cameraHandle();
+    const GLC_Point3d eye = camera->eye();
+    const double halfAngle = viewport.viewAngle() * REPO_POINT_PI / 360.0;
+    const double pixelsPerUnit = viewport.size().height() / (2.0 * std::tan(halfAngle));
+    const bool ortho = viewport.useOrtho();
+    const GLC_Frustum &frustum = viewport.frustum();
+
+    auto getDistance = [&](const RepoPointCloudNode &node)
+    {
+        if (ortho)
+            return camera->distEyeTarget();
+        const GLC_Point3d center((node.lower[0] + node.upper[0]) / 2,
+                                 (node.lower[1] + node.upper[1]) / 2,
+                                 (node.lower[2] + node.upper[2]) / 2);
+        // Nodes around the eye come first
+        return std::max((center - eye).length(), (double) node.spacing);
+    };
+    auto isInView = [&](const RepoPointCloudNode &node)
+    {
+        const GLC_BoundingBox bbox(GLC_Point3d(node.lower[0], node.lower[1], node.lower[2]),
+                                   GLC_Point3d(node.upper[0], node.upper[1], node.upper[2]));
+        return frustum.localizeBoundingBox(bbox) != GLC_Frustum::OutFrustum;
+    };
+
+    //--------------------------------------------------------------------------
+    // Largest nodes on screen first until the budget is spent
+    std::vector<int> selected;
+    std::priority_queue<std::pair<double, int>> queue;
+    if (isInView(data.nodes[0]))
+        queue.push(std::make_pair(0.0, 0));
+    qint64 selectedCount = 0;
+    while (!queue.empty())
+    {
+        const int index = queue.top().second;
+        queue.pop();
+        const RepoPointCloudNode &node = data.nodes[index];
+        if (selectedCount + node.count > pointBudget && !selected.empty())
+            break;
+        selected.push_back(index);
+        selectedCount += node.count;
+
+        for (const int child : node.children)
+        {
+            if (child < 0 || !isInView(data.nodes[child]))
+                continue;
+            const RepoPointCloudNode &childNode = data.nodes[child];
+            const double size = (childNode.upper[0] - childNode.lower[0]) * std::sqrt(3.0);
+            const double pixels = size / getDistance(childNode) * pixelsPerUnit;
+            if (pixels >= REPO_POINT_MIN_NODE_PIXELS)
+                queue.push(std::make_pair(pixels, child));
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Draw
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_PROGRAM_POINT_SIZE);
+    glEnable(GL_DEPTH_TEST);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    bool pending = false;
+    int uploads = REPO_POINT_UPLOADS_PER_FRAME;
+    for (const int index : selected)
+    {
+        const RepoPointCloudNode &node = data.nodes[index];
+        const GLuint buffer = getBuffer(index, uploads);
+        if (!buffer)
+        {
+            pending = true;
+            continue;
+        }
+
+        // Points as wide as the spacing of their level on screen
+        const double size = node.spacing / getDistance(node) * pixelsPerUnit;
+        glPointSize((GLfloat) std::max(1.0, std::min(REPO_POINT_MAX_SIZE, size)));
+
+        f->glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glVertexPointer(3, GL_FLOAT, sizeof(RepoPoint), (const GLvoid *) offsetof(RepoPoint, position));
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(RepoPoint), (const GLvoid *) offsetof(RepoPoint, color));
+        glDrawArrays(GL_POINTS, 0, node.count);
+        renderedCount += node.count;
+    }
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glPopClientAttrib();
+    glPopAttrib();
+
+    evict();
+    return pending;
+}
+
+GLuint RepoPointCloud::getBuffer(int node, int &uploads)
+{
+    auto it = resident.find(node);
+    if (it != resident.end())
+    {
+        lru.splice(lru.begin(), lru, it->second.lru);
+        it->second.frame = frame;
+        return it->second.buffer;
+    }
+
+    if (uploads <= 0)
+        return 0;
+    --uploads;
+
+    //--------------------------------------------------------------------------
+    // Pages of the mapped file are read in by the copy
+    const RepoPointCloudNode &chunk = data.nodes[node];
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    GLuint buffer = 0;
+    f->glGenBuffers(1, &buffer);
+    f->glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    f->glBufferData(GL_ARRAY_BUFFER, chunk.count * sizeof(RepoPoint),
+                    points + chunk.offset, GL_STATIC_DRAW);
+
+    lru.push_front(node);
+    Resident entry;
+    entry.buffer = buffer;
+    entry.lru = lru.begin();
+    entry.frame = frame;
+    resident[node] = entry;
+    residentCount += chunk.count;
+    return buffer;
+}
+
+void RepoPointCloud::evict()
+{
+    const qint64 limit = 2 * (qint64) pointBudget;
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    while (residentCount > limit && !lru.empty())
+    {
+        auto it = resident.find(lru.back());
+        if (it->second.frame == frame)
+            break; // all others were drawn in this frame too
+
+        f->glDeleteBuffers(1, &it->second.buffer);
+        residentCount -= data.nodes[it->first].count;
+        resident.erase(it);
+        lru.pop_back();
+    }
+}
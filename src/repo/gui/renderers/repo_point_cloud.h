@@ -0,0 +1,275 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <QFile>
+#include <QMetaType>
+#include <QOpenGLFunctions>
+#include <QString>
+
+#include <GLC_BoundingBox>
+#include <GLC_Viewport>
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+//! Point as stored in the chunk file, interleaved for a single buffer.
+struct RepoPoint
+{
+    float position[3];
+    unsigned char color[4];
+};
+
+//! Chunk of the point hierarchy, an octree cell.
+struct RepoPointCloudNode
+{
+    //! Cubic bounds of the cell.
+    float lower[3];
+    float upper[3];
+
+    //! Distance between points kept at this level, finer in the children.
+    float spacing;
+
+    //! First point and number of points in the chunk file.
+    qint64 offset;
+    int count;
+
+    //! Child cells by octant, -1 if empty.
+    int children[8];
+};
+
+/**
+ * Point hierarchy as produced by workers, the points themselves stay in
+ * the chunk file.
+ */
+struct RepoPointCloudData
+{
+    //! Chunk file, points of each node contiguous.
+    QString path;
+
+    //! Nodes with the root first.
+    std::vector<RepoPointCloudNode> nodes;
+
+    qint64 pointCount;
+
+    RepoPointCloudData() : pointCount(0) {}
+};
+
+/**
+ * Level of detail rendering of large point clouds.
+ *
+ * Points are sorted into an octree whose every cell keeps a subsample at
+ * its own spacing, passing the rest down to its children. Each frame the
+ * cells in view are taken by decreasing screen size until the point budget
+ * is spent, and drawn with a point size matching their projected spacing
+ * so that coarse levels still close the gaps. Chunks are read from the
+ * memory-mapped file into buffers on demand, a few per frame, and the
+ * least recently drawn are dropped beyond twice the budget.
+ */
+class RepoPointCloud
+{
+
+public:
+
+    //! Settings key of the number of points drawn per frame.
+    static const QString REPO_SETTINGS_POINT_BUDGET;
+
+    RepoPointCloud();
+
+    //! Removes the chunk file, buffers are only deleted by clear().
+    ~RepoPointCloud();
+
+    //! Returns the point budget of the settings.
+    static int getBudgetSetting();
+
+    /**
+     * Maps the chunk file of the data, replacing any previous cloud.
+     * Expects the GL context of the buffers to be current.
+     */
+    void setData(const RepoPointCloudData &data);
+
+    //! Deletes the buffers and unmaps the file, with the context current.
+    void clear();
+
+    bool isEmpty() const { return data.nodes.empty(); }
+
+    void setPointBudget(int points) { pointBudget = points; }
+
+    int getPointBudget() const { return pointBudget; }
+
+    //! Returns the points drawn in the last frame.
+    qint64 getRenderedCount() const { return renderedCount; }
+
+    //! Returns the points held in buffers.
+    qint64 getResidentCount() const { return residentCount; }
+
+    qint64 getPointCount() const { return data.pointCount; }
+
+    //! Returns the bounds of the root cell, empty without points.
+    GLC_BoundingBox getBoundingBox() const;
+
+    /**
+     * Draws the cells in view within the point budget. Expects the camera
+     * matrices to be set and no shader to be bound.
+     * @return returns true if chunks in view are still to be streamed in
+     */
+    bool render(GLC_Viewport &viewport);
+
+protected:
+
+    friend class RepoPointCloudBuilder;
+
+    /**
+     * Sorts the points into the subtree of the given node, whose bounds are
+     * set, appending the chunks to the file.
+     * @param points points within the node, reordered on return
+     * @param depth level of the node
+     * @param written points in the file so far, updated
+     * @return returns false if the file could not be written or cancelled
+     */
+    static bool buildNodes(std::vector<RepoPoint> &points,
+                           int root,
+                           int depth,
+                           QFile &file,
+                           qint64 &written,
+                           RepoPointCloudData &data,
+                           const volatile bool *cancelled);
+
+    struct Resident
+    {
+        GLuint buffer;
+        std::list<int>::iterator lru;
+        quint64 frame; //!< last frame drawn
+    };
+
+    /**
+     * Returns the buffer of the node, uploading it from the mapped file if
+     * uploads are left in this frame.
+     */
+    GLuint getBuffer(int node, int &uploads);
+
+    //! Drops least recently drawn buffers beyond the resident limit,
+    //! keeping those of the current frame.
+    void evict();
+
+    RepoPointCloudData data;
+
+    QFile file;
+
+    //! Start of the mapped chunk file.
+    const RepoPoint *points;
+
+    int pointBudget;
+
+    qint64 renderedCount;
+
+    qint64 residentCount;
+
+    quint64 frame;
+
+    //! Node buffers, most recently drawn first in lru.
+    std::unordered_map<int, Resident> resident;
+    std::list<int> lru;
+
+}; // end class
+
+/**
+ * Builds the point hierarchy of a cloud larger than memory.
+ *
+ * Points are added in batches, e.g. mesh by mesh, once the bounds of all
+ * of them are known. The top levels of the hierarchy keep their subsample
+ * in memory as the points stream through, the rest is spilled into one
+ * bucket file per cell below them. Each bucket is then read back and
+ * sorted on its own, so only the points of a single cell are in memory.
+ */
+class RepoPointCloudBuilder
+{
+
+public:
+
+    /**
+     * @param path chunk file to write, buckets are written next to it
+     * @param lower lower corner of the bounds of all points
+     * @param upper upper corner of the bounds of all points
+     */
+    RepoPointCloudBuilder(const QString &path, const float lower[3], const float upper[3]);
+
+    //! Removes the bucket files.
+    ~RepoPointCloudBuilder();
+
+    //! Sorts the points into the top levels or their buckets.
+    //! @return returns false if a bucket could not be written
+    bool add(const RepoPoint *points, size_t count);
+
+    /**
+     * Sorts each bucket and writes the chunk file.
+     * @param cancelled stops the build when set
+     * @return returns false without points, if the file could not be
+     * written or cancelled
+     */
+    bool finish(RepoPointCloudData &data, const volatile bool *cancelled = nullptr);
+
+    qint64 getPointCount() const { return pointCount; }
+
+protected:
+
+    //! Top level cell, children of cell i at 8i + 1 to 8i + 8.
+    struct Cell
+    {
+        RepoPointCloudNode node;
+        std::unordered_set<quint32> cells;
+        std::vector<RepoPoint> kept;
+        qint64 count; //!< points in the cell and below
+    };
+
+    //! Writes the buffered points of a bucket to its file.
+    bool flush(size_t bucket);
+
+    //! Appends the chunks of the cell and below, returns the node index.
+    int finishCell(size_t cell, int depth, QFile &file, qint64 &written,
+                   RepoPointCloudData &data, const volatile bool *cancelled, bool &ok);
+
+    const QString path;
+
+    std::vector<Cell> cells;
+
+    std::vector<std::unique_ptr<QFile>> buckets;
+
+    std::vector<std::vector<RepoPoint>> bucketBuffers;
+
+    std::vector<qint64> bucketCounts;
+
+    qint64 pointCount;
+
+    bool failed;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
+
+Q_DECLARE_METATYPE(repo::gui::renderer::RepoPointCloudData)
@@ -0,0 +1,248 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_render_queue.h"
+
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <unordered_set>
+//------------------------------------------------------------------------------
+#include <GLC_Material>
+#include <GLC_State>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+//! Fraction of new entries above which a full sort beats insertion sort.
+static const double REPO_QUEUE_FULL_SORT_RATIO = 0.125;
+
+RepoRenderQueue::RepoRenderQueue(QueueOrder order)
+    : order(order)
+    , enabled(true)
+    , unsortedStateChanges(0)
+    , sortedStateChanges(0)
+{}
+
+RepoRenderQueue::~RepoRenderQueue() {}
+
+void RepoRenderQueue::clear()
+{
+    entries.clear();
+    unsortedStateChanges = 0;
+    sortedStateChanges = 0;
+}
+
+bool RepoRenderQueue::isBeforeByState(const Entry &a, const Entry &b)
+{
+    if (a.texture != b.texture)
+        return a.texture < b.texture;
+    if (a.material != b.material)
+        return a.material < b.material;
+    return a.depth < b.depth;
+}
+
+bool RepoRenderQueue::isBeforeByDepth(const Entry &a, const Entry &b)
+{
+    return a.depth > b.depth;
+}
+
+bool RepoRenderQueue::isBefore(const Entry &a, const Entry &b) const
+{
+    return order == QueueOrder::BACK_TO_FRONT ?
+                isBeforeByDepth(a, b) : isBeforeByState(a, b);
+}
+
+void RepoRenderQueue::setStateKey(Entry &entry)
+{
+    entry.texture = 0;
+    entry.material = 0;
+    if (entry.instance->numberOfGeometry() > 0)
+    {
+        GLC_Geometry *geometry = entry.instance->geomAt(0);
+        const QList<GLC_uint> materialIds = geometry->materialIds();
+        if (!materialIds.isEmpty())
+        {
+            GLC_Material *material = geometry->material(materialIds.first());
+            if (material)
+            {
+                entry.material = material->id();
+                if (material->hasTexture())
+                    entry.texture = (quintptr) material->textureHandle();
+            }
+        }
+    }
+}
+
+bool RepoRenderQueue::isQueued(GLC_3DViewCollection *collection,
+                               GLC_3DViewInstance *instance) const
+{
+    if (instance->viewableFlag() == GLC_3DViewInstance::NoViewable ||
+            instance->isVisible() != collection->showState() ||
+            collection->isSelected(instance->id()) ||
+            collection->isInAShadingGroup(instance->id()))
+        return false;
+
+    if (order == QueueOrder::BACK_TO_FRONT)
+    {
+        for (int i = 0; i < instance->numberOfGeometry(); ++i)
+        {
+            if (instance->geomAt(i)->hasTransparentMaterials())
+                return true;
+        }
+        return false;
+    }
+    return true;
+}
+
+int RepoRenderQueue::countStateChanges(const std::vector<Entry> &entries)
+{
+    int changes = 0;
+    for (size_t i = 1; i < entries.size(); ++i)
+    {
+        if (entries[i].texture != entries[i - 1].texture)
+            ++changes;
+        if (entries[i].material != entries[i - 1].material)
+            ++changes;
+    }
+    return changes;
+}
+
+void RepoRenderQueue::update(GLC_World &world, const GLC_Point3d &eye)
+{
+    if (!enabled)
+        return;
+
+    GLC_3DViewCollection *collection = world.collection();
+
+    //--------------------------------------------------------------------------
+    // Currently drawn instances in collection order
+    std::vector<Entry> unsorted;
+    std::unordered_set<GLC_3DViewInstance*> drawn;
+    for (GLC_3DViewInstance *instance : collection->instancesHandle())
+    {
+        if (isQueued(collection, instance))
+        {
+            Entry entry;
+            entry.instance = instance;
+            entry.depth = 0;
+            setStateKey(entry);
+            unsorted.push_back(entry);
+            drawn.insert(instance);
+        }
+    }
+    unsortedStateChanges = countStateChanges(unsorted);
+
+    //--------------------------------------------------------------------------
+    // Keep the previous order of instances still drawn, append the new ones
+    std::unordered_set<GLC_3DViewInstance*> kept;
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [&](const Entry &entry)
+    {
+        return !drawn.count(entry.instance);
+    }), entries.end());
+    for (const Entry &entry : entries)
+        kept.insert(entry.instance);
+
+    const size_t previous = entries.size();
+    for (const Entry &entry : unsorted)
+        if (!kept.count(entry.instance))
+            entries.push_back(entry);
+
+    //--------------------------------------------------------------------------
+    // View depth and key refresh, materials may have been swapped since
+    for (Entry &entry : entries)
+    {
+        setStateKey(entry);
+        entry.depth = (entry.instance->boundingBox().center() - eye).length();
+    }
+
+    //--------------------------------------------------------------------------
+    // Sort, insertion sort is close to linear on the previous order
+    // unless too many entries were added, or it moves them too far, e.g.
+    // when the view jumps and the previous order no longer holds
+    const auto isBeforeInOrder =
+            order == QueueOrder::BACK_TO_FRONT ? isBeforeByDepth : isBeforeByState;
+    const size_t added = entries.size() - previous;
+    bool sorted = added <= entries.size() * REPO_QUEUE_FULL_SORT_RATIO;
+
+    // Flipping the camera inverts every depth, turn the order around first
+    // so that the insertion sort starts from nearly sorted again
+    if (sorted && order == QueueOrder::BACK_TO_FRONT && entries.size() > 2)
+    {
+        size_t descents = 0;
+        for (size_t i = 1; i < entries.size(); ++i)
+            if (isBeforeByDepth(entries[i], entries[i - 1]))
+                ++descents;
+        if (descents > (entries.size() - 1) / 2)
+            std::reverse(entries.begin(), entries.end());
+    }
+
+    if (sorted)
+    {
+        size_t log = 1;
+        while ((size_t(1) << log) < entries.size())
+            ++log;
+        const size_t maxShifts = entries.size() * log;
+        size_t shifts = 0;
+        for (size_t i = 1; i < entries.size() && sorted; ++i)
+        {
+            Entry entry = entries[i];
+            size_t j = i;
+            for (; j > 0 && isBefore(entry, entries[j - 1]); --j)
+                entries[j] = entries[j - 1];
+            entries[j] = entry;
+            shifts += i - j;
+            sorted = shifts <= maxShifts;
+        }
+    }
+    if (!sorted)
+        std::sort(entries.begin(), entries.end(), isBeforeInOrder);
+
+    sortedStateChanges = countStateChanges(entries);
+}
+
+void RepoRenderQueue::render(glc::RenderFlag renderFlag, GLC_Viewport *viewport) const
+{
+    const bool setState = !GLC_State::isInSelectionMode();
+    if (setState && renderFlag == glc::TransparentRenderFlag)
+    {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+    }
+    else if (setState)
+    {
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    for (const Entry &entry : entries)
+    {
+        // Flags may have been changed after the update by culling passes
+        if (entry.instance->viewableFlag() != GLC_3DViewInstance::NoViewable)
+            entry.instance->render(renderFlag, true, viewport);
+    }
+
+    if (setState && renderFlag == glc::TransparentRenderFlag)
+    {
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+    }
+}
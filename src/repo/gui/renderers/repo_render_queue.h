@@ -0,0 +1,128 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <vector>
+
+#include <GLC_World>
+#include <GLC_Viewport>
+#include <GLC_3DViewInstance>
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+//! Draw order of a render queue.
+enum class QueueOrder {
+    STATE_FRONT_TO_BACK, //!< texture, material, then nearest first
+    BACK_TO_FRONT //!< farthest first, for blending
+};
+
+/**
+ * Sorted render queue of the main (unselected, unshaded) instances.
+ *
+ * GLC draws instances in hash order which makes textures and materials
+ * change between most consecutive instances and blends transparent faces
+ * in arbitrary order. The opaque queue orders instances by texture and
+ * material so that equal states are drawn together, and front to back
+ * within each bucket for early depth rejection. The transparent queue holds
+ * only instances with transparent materials, farthest first.
+ * Membership follows the viewable state and the previous order is kept so
+ * that re-sorting after small camera moves is close to linear.
+ */
+class RepoRenderQueue
+{
+
+public:
+
+    RepoRenderQueue(QueueOrder order = QueueOrder::STATE_FRONT_TO_BACK);
+
+    ~RepoRenderQueue();
+
+    /**
+     * Drops all entries, to be called whenever instances may be deleted.
+     */
+    void clear();
+
+    /**
+     * Updates membership from the current viewable state of the world and
+     * re-sorts with view depths from the given eye.
+     */
+    void update(GLC_World &world, const GLC_Point3d &eye);
+
+    /**
+     * Renders the queued instances with the same GL state the GLC
+     * collection sets up for the opaque or transparent pass.
+     */
+    void render(glc::RenderFlag renderFlag, GLC_Viewport *viewport) const;
+
+    bool isEnabled() const { return enabled; }
+
+    void setEnabled(bool on) { enabled = on; }
+
+    int getSize() const { return (int) entries.size(); }
+
+    //! Returns the number of texture and material changes in collection order.
+    int getUnsortedStateChanges() const { return unsortedStateChanges; }
+
+    //! Returns the number of texture and material changes in queue order.
+    int getSortedStateChanges() const { return sortedStateChanges; }
+
+protected:
+
+    struct Entry
+    {
+        GLC_3DViewInstance *instance;
+        quintptr texture;
+        GLC_uint material;
+        double depth;
+    };
+
+    //! Returns true if a is to be drawn before b in the opaque pass.
+    static bool isBeforeByState(const Entry &a, const Entry &b);
+
+    //! Returns true if a is farther than b.
+    static bool isBeforeByDepth(const Entry &a, const Entry &b);
+
+    bool isBefore(const Entry &a, const Entry &b) const;
+
+    //! Fills in the texture and material keys of the first material.
+    static void setStateKey(Entry &entry);
+
+    //! Returns true if the instance is drawn by the main pass of this queue.
+    bool isQueued(GLC_3DViewCollection *collection,
+                  GLC_3DViewInstance *instance) const;
+
+    static int countStateChanges(const std::vector<Entry> &entries);
+
+    std::vector<Entry> entries;
+
+    QueueOrder order;
+
+    bool enabled;
+
+    int unsortedStateChanges;
+
+    int sortedStateChanges;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
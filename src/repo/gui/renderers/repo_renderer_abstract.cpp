@@ -22,4 +22,17 @@ using namespace repo::gui::renderer;
 
 AbstractRenderer::AbstractRenderer(){}
 
-AbstractRenderer::~AbstractRenderer(){}
\ No newline at end of file
+AbstractRenderer::~AbstractRenderer(){}
+
+QColor AbstractRenderer::encodeId(quint32 id)
+{
+    return QColor(id & 0xFF, (id >> 8) & 0xFF, (id >> 16) & 0xFF, 0xFF - (id >> 24));
+}
+
+quint32 AbstractRenderer::decodeId(const uchar *rgba)
+{
+    return (quint32) rgba[0] |
+            ((quint32) rgba[1] << 8) |
+            ((quint32) rgba[2] << 16) |
+            ((quint32) (0xFF - rgba[3]) << 24);
+}
\ No newline at end of file
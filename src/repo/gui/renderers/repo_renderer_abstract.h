@@ -18,15 +18,20 @@
 
 #pragma once
 
+#include <QColor>
 #include <QObject>
 #include <QOpenGLFunctions>
 #include <QFile>
 #include <QPainter>
+#include <QRect>
+#include <repo/repo_controller.h>
 #include <repo/core/model/collection/repo_scene.h>
 #include <repo/core/model/repo_node_utils.h>
 #include <repo/manipulator/modelutility/spatialpartitioning/repo_spatial_partitioner_abstract.h>
 
 #include "repo_fpscounter.h"
+#include "repo_frame_profiler.h"
+#include "repo_pixel_readback.h"
 
 namespace repo {
 namespace gui {
@@ -53,6 +58,16 @@ public:
 
     virtual ~AbstractRenderer();
 
+    /**
+     * Colour of an ID in false colour images. The low 24 bits go into red,
+     * green and blue as in GLC, the high 8 bits inverted into alpha so that
+     * IDs below 2^24 stay opaque and an opaque black background is ID 0.
+     */
+    static QColor encodeId(quint32 id);
+
+    //! Returns the ID of an RGBA pixel of a false colour image.
+    static quint32 decodeId(const uchar *rgba);
+
     /**
     * Delete shaders
     */
@@ -78,11 +93,34 @@ public:
      * in false coloring with no lighting effects.
      * @param idMap (return value) this function will fill in the ID mapping
      *              of decoded ints to unique ID of original meshes
-     * @return returns a QImage of the current view with no lighting effects
+     * @return returns a non premultiplied RGBA image to decode with decodeId()
      */
     virtual QImage getCurrentImageWithFalseColoring(
             std::vector<QString> &idMap, int w = 0, int h = 0) = 0;
 
+    /**
+     * Renders false colour ID images of many views with a single assignment
+     * of IDs, queuing each view's readback while the next one renders.
+     * The background is black, i.e. ID 0, pixels decode with decodeId().
+     * @param cameras views to render
+     * @param readback readback to queue the reads on, polled as views go
+     * @param callback receives the index of the camera and its image
+     * @return returns the ID mapping shared by all views, decoded ints to
+     *         unique IDs of original meshes
+     */
+    virtual std::vector<QString> requestIdBuffers(
+            const std::vector<CameraSettings> &cameras,
+            int w, int h,
+            RepoPixelReadback &readback,
+            const std::function<void(size_t, const QImage &)> &callback) = 0;
+
+    /**
+     * Returns cameras looking at the centre of the model from the 26
+     * directions of the faces, edges and corners of its bounding cube,
+     * far enough for the whole model to be in view.
+     */
+    virtual std::vector<CameraSettings> getSurroundingCameras() = 0;
+
     /**
     * Increase velocity
     * @param vel velocity delta
@@ -102,6 +140,43 @@ public:
     virtual void loadModel(repo::core::model::RepoScene *scene,
                            const std::vector<double>    &offsetVector) = 0;
 
+    /**
+    * Release the geometry of the loaded model to save memory, keeping the
+    * camera and colour overrides for restoreModel()
+    * @return returns true if any geometry was released
+    */
+    virtual bool releaseModel() = 0;
+
+    /**
+    * Reload the geometry released by releaseModel(), if any
+    * @param scene scene to reload from if the previous one was released by
+    *        releaseScene(), nullptr to reuse the previous one
+    */
+    virtual void restoreModel(repo::core::model::RepoScene *scene = nullptr) = 0;
+
+    /**
+    * Forget the scene of released geometry so that its owner can delete it
+    * @return returns false if the geometry is loaded or workers still read
+    *         the scene
+    */
+    virtual bool releaseScene() = 0;
+
+    /**
+    * Returns true if workers started by the renderer are still running
+    */
+    virtual bool hasActiveWorkers() const = 0;
+
+    /**
+    * Returns true if the geometry has been released
+    */
+    virtual bool isModelReleased() const = 0;
+
+    /**
+    * Returns an estimate of the memory taken by the loaded geometry
+    * @return returns the estimate in bytes
+    */
+    virtual qint64 getModelFootprint() const = 0;
+
 
     /**
     * Navigate around the model
@@ -131,12 +206,15 @@ public:
 
 
     /**
-    * Select a component given the position
+    * Select a component given the position, without waiting for the GPU.
+    * The component is highlighted once the readback is polled after the
+    * GPU has finished, followed by repaintNeeded().
+    * @param readback readback to queue the read on
     * @param x position in x
     * @param position in y
     * @param multiSelection true if allow multiple selection
     */
-    virtual void selectComponent(QOpenGLContext *context, int x, int y, bool multiSelection) = 0;
+    virtual void selectComponent(RepoPixelReadback &readback, int x, int y, bool multiSelection) = 0;
 
     /**
     * Set the colour of the mesh given its name
@@ -147,6 +225,14 @@ public:
             const qreal &opacity,
             const QColor &color) = 0;
 
+    /**
+    * Shows or hides the meshes of the given unique IDs, e.g. all meshes
+    * below a node of the scene graph, in every placement.
+    */
+    virtual void setMeshVisibility(
+            const std::vector<repoUUID> &uniqueIDs,
+            bool visible) = 0;
+
     /**
     * Turn on navigation mode
     * @param mode which navigation mode
@@ -178,6 +264,23 @@ public:
     */
     virtual void resizeWindow(const int &width, const int &height) = 0;
 
+    /**
+    * Restrict rendering to a tile of a larger image. The view is framed as
+    * for an image of imageWidth x imageHeight but only the tile is drawn,
+    * into the lower left corner of the current framebuffer.
+    * @param imageWidth width of the whole image
+    * @param imageHeight height of the whole image
+    * @param tile tile in image pixels, top left origin, null to stop tiling
+    */
+    virtual void setTile(int imageWidth, int imageHeight, const QRect &tile) = 0;
+
+    /**
+    * Shift the image by a fraction of a pixel, for accumulation passes
+    * @param dx offset to the right in pixels
+    * @param dy offset downwards in pixels
+    */
+    virtual void setSubPixelOffset(double dx, double dy) = 0;
+
     /**
     * Set activiation flag
     * @param flag true/false
@@ -191,6 +294,14 @@ public:
     */
     virtual void setAndInitSelectionShaders(QFile &vertexFile, QFile &fragmentFile, QOpenGLContext *context) = 0;
 
+    /**
+    * Set the shader that writes all 32 bits of component IDs in false
+    * colour images and initialise it
+    * @param vertexFile vertex shader file
+    * @param fragmentFile fragment shader file
+    */
+    virtual void setAndInitIdShaders(QFile &vertexFile, QFile &fragmentFile, QOpenGLContext *context) = 0;
+
     /**
      * Appends and compiles given vertex and fragments shaders which can then
      * be selected based on their assigned number in the shaders list.
@@ -232,9 +343,15 @@ public:
     */
     virtual void setBackgroundColor(const QColor &color) = 0;
 
+    /**
+    * Toggle between show/hide the spatial partitioning of the scene,
+    * computed asynchronously the first time it is shown
+    * @param controller controller to the core library
+    * @param scene scene to partition
+    */
     virtual void toggleGenericPartitioning(
-            const std::vector<repo_vector_t> &sceneBbox,
-            const std::shared_ptr<repo_partitioning_tree_t> &tree) = 0;
+            repo::RepoController *controller,
+            repo::core::model::RepoScene *scene) = 0;
 
     /**
     * Toggle between show/hide mesh bounding boxes
@@ -242,11 +359,22 @@ public:
     virtual void toggleMeshBoundingBoxes(
                          const repo::core::model::RepoScene *scene) = 0;
 
+    /**
+    * Cycle the mesh bounding boxes through showing all levels and a single
+    * level of the scene graph at a time
+    */
+    virtual void cycleMeshBoundingBoxLevel() = 0;
+
     /**
     * Toggle between show/hide octree
     */
     virtual void toggleOctree() = 0;
 
+    /**
+    * Toggle CPU occlusion culling on/off
+    */
+    virtual void toggleOcclusionCulling() = 0;
+
     /**
     * Toggle between different projection modes
     */
@@ -280,6 +408,22 @@ public:
      */
     virtual void setClippingPlaneVisibility(bool on) = 0;
 
+    /**
+     * Sets the section box from per-axis fractions from 0 to 1 of the
+     * scene bounding box, enabling it if necessary. Replaces the clipping
+     * plane while on.
+     *
+     * @param lower x, y and z fractions of the lower corner
+     * @param upper x, y and z fractions of the upper corner
+     */
+    virtual void setSectionBox(const std::vector<double> &lower,
+                               const std::vector<double> &upper) = 0;
+
+    /**
+     * Sets section box visibility to true or false.
+     */
+    virtual void setSectionBoxVisibility(bool on) = 0;
+
     /**
     * Zoom/unzoom camera
     * @param zoom zoom factor
@@ -297,6 +441,11 @@ signals :
 
     void modelLoadProgress(int value, int maximum);
 
+    /**
+    * Signal that is emitted once the geometry of a loaded model is in place
+    */
+    void modelLoaded();
+
     void cameraChanged(const CameraSettings &camera);
 
 public slots :
@@ -310,10 +459,27 @@ public slots :
     void notifyCameraChange()
     { emit cameraChanged(getCurrentCamera()); }
 
+    /**
+    * Toggle between show/hide per-phase frame timings
+    */
+    void toggleFrameTimings()
+    { frameProfiler.setOverlayVisible(!frameProfiler.isOverlayVisible()); }
+
+    /**
+    * Export recorded per-phase frame timings
+    * @param path CSV file to write to
+    * @return returns true upon success
+    */
+    bool exportFrameTimings(const QString &path)
+    { return frameProfiler.exportCSV(path); }
+
 protected:
 
     RepoFPSCounter fpsCounter;
 
+    //! Per-phase timings of the most recent frames.
+    RepoFrameProfiler frameProfiler;
+
 }; // end class
 } //end namespace renderer
 } // end namespace gui
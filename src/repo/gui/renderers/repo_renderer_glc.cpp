@@ -17,9 +17,20 @@
 
 
 #include "repo_renderer_glc.h"
+#include "repo_shader_cache.h"
+#include "../../workers/repo_worker_geometry_stream.h"
 #include "../../workers/repo_worker_glc_export.h"
+#include "../../workers/repo_worker_mesh_bounding_boxes.h"
+#include "../../workers/repo_worker_mesh_index.h"
+#include "../../workers/repo_worker_point_cloud.h"
+#include "../../workers/repo_worker_scene_partitioning.h"
 #include <repo/core/model/bson/repo_bson_factory.h>
 
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
 //------------------------------------------------------------------------------
 #include <GLC_UserInput>
 #include <GLC_Context>
@@ -27,9 +38,24 @@
 #include <GLC_State>
 #include <glc_renderstatistics.h>
 //------------------------------------------------------------------------------
+#include <QDir>
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QUuid>
+//------------------------------------------------------------------------------
 
 using namespace repo::gui::renderer;
 
+//! Highest ID of a false colour image, 0 being the background.
+static const quint64 REPO_MAX_COMPONENT_ID = 0xFFFFFFFFull;
+
+//! Estimated bytes per vertex (position, normal, texel) and per triangle.
+static const qint64 REPO_FOOTPRINT_VERTEX_BYTES = 32;
+static const qint64 REPO_FOOTPRINT_FACE_BYTES = 12;
+
+//! Meshes converted per stream worker.
+static const size_t REPO_STREAM_BATCH_SIZE = 64;
+
 GLCRenderer::GLCRenderer()
     : AbstractRenderer()
     , glcLight()
@@ -38,10 +64,39 @@ GLCRenderer::GLCRenderer()
     , glc3DWidgetManager(&glcViewport)
     , renderingFlag(glc::ShadingFlag)
     , clippingPlaneWidgets({nullptr, nullptr, nullptr})
+    , clippingPlane(nullptr)
     , clippingPlaneReverse(false)
+    , sectionPlanes(6, nullptr)
+    , clippedInstances(0)
     , shaderID(0)
+    , idShader(nullptr)
+    , isIdColoring(false)
     , isWireframe(false)
     , currentlyHighLighted("")
+    , occludersPending(false)
+    , cameraDirty(true)
+    , visibilityDirty(true)
+    , geometryDirty(true)
+    , cachedOrtho(false)
+    , cachedViewAngle(0)
+    , skippedUpdates(0)
+    , culledBodies(0)
+    , transparentQueue(QueueOrder::BACK_TO_FRONT)
+    , meshBBoxOverlay(Qt::cyan)
+    , meshBBoxVisible(false)
+    , meshBBoxPending(false)
+    , partitionVisible(false)
+    , partitionPending(false)
+    , pointCloudUpdated(false)
+    , pointCloudPending(false)
+    , streamPending(false)
+    , streamGeneration(0)
+    , streamingAllowed(true)
+    , loadedScene(nullptr)
+    , modelFootprint(0)
+    , modelReleased(false)
+    , modelRestoring(false)
+    , activeWorkers(0)
 {
     //--------------------------------------------------------------------------
     // GLC settings
@@ -82,35 +137,69 @@ GLCRenderer::GLCRenderer()
 
 GLCRenderer::~GLCRenderer()
 {
+    occlusionCuller.clear();
+    resetColors();
+    clearStreamedGeometry();
     glcWorld.clear();
+    pointCloud.clear();
+    RepoGeometryRegistry::getInstance().release(geometryKey);
 }
 
 
 std::vector<QString> GLCRenderer::applyFalseColoringMaterials()
 {
-    std::vector<QString> ids;
-    if(matMap.size() > (pow(2, 24) -1))
+    for (size_t id = 1; id < idTable.size(); ++id)
     {
-        //We represent indices using rgb values, which is 3*8 bit.
-        //0 can't be used as it will be the same as the background,
-        // so we can represent 2^24-1 components
-        repoError << "This model has too many components to support selection!";
-        return ids;
+        // Streamed meshes keep their IDs while not resident
+        if (matMap.find(idTable[id]) == matMap.end() &&
+                meshMap.find(idTable[id]) == meshMap.end())
+            continue;
+
+        // Opaque so that it is drawn without blending. Materials replace
+        // the alpha of their colours by the opacity, so the high bits of the
+        // ID go into the emissive red, which the ID shader writes as alpha
+        const QColor color = encodeId((quint32) id);
+        GLC_Material idMat;
+        idMat.setOpacity(1.0);
+        idMat.setAmbientColor(color);
+        idMat.setDiffuseColor(color);
+        idMat.setSpecularColor(QColor(0, 0, 0, 255));
+        idMat.setEmissiveColor(QColor(color.alpha(), 0, 0, 255));
+        changeMeshMaterial(idTable[id], idMat);
+
+        // Members of a batch are picked through its ID, split ones included
+        auto meshIt = meshMap.find(idTable[id]);
+        RepoMeshBatch *batch = meshIt != meshMap.end() ?
+                    dynamic_cast<RepoMeshBatch*>(meshIt->second) : nullptr;
+        if (batch && batch->name() == idTable[id])
+            for (GLC_Material *memberMat : batch->getMemberMaterials())
+                overrideMaterial(memberMat, idMat);
     }
+    return idTable;
+}
 
-    ids.push_back(""); //white is never used as the background will be white.
-    for(auto &matPair : matMap)
-    {
-        QVector<GLubyte> colorId(4);
-        glc::encodeRgbId(ids.size(),&colorId[0]);
-        ids.push_back(matPair.first);
-        QColor color((int)colorId[0], (int)colorId[1], (int)colorId[2], (int)colorId[3]);
-        setMeshColor(matPair.first, 1.0, color);
-    }
+void GLCRenderer::assignIds()
+{
+    idTable.clear();
 
-    return ids;
+    // Streamed meshes are numbered up front, resident or not
+    std::vector<QString> components;
+    if (geometryStreamer.isActive())
+        components = geometryStreamer.getComponents();
+    else
+        for (const auto &matPair : matMap)
+            components.push_back(matPair.first);
 
+    if (components.size() > REPO_MAX_COMPONENT_ID)
+    {
+        // IDs are 32 bit RGBA values and 0 is the background
+        repoError << "This model has too many components to support selection!";
+        return;
+    }
 
+    idTable.reserve(components.size() + 1);
+    idTable.push_back(""); // background
+    idTable.insert(idTable.end(), components.begin(), components.end());
 }
 
 CameraSettings GLCRenderer::convertToCameraSettings(GLC_Camera *cam)
@@ -139,8 +228,15 @@ void GLCRenderer::deleteShaders(QOpenGLContext *context)
 {
     GLC_SelectionMaterial::deleteShader(context);
     for (int i = 0; i < shaders.size(); ++i)
-        delete shaders[i];
+        RepoShaderCache::getInstance().release(shaders[i]);
     shaders.clear();
+    if (idShader)
+        RepoShaderCache::getInstance().release(idShader);
+    idShader = nullptr;
+
+    // Timer queries and point buffers live in the same context as the shaders
+    frameProfiler.destroy();
+    pointCloud.clear();
 }
 
 
@@ -151,6 +247,7 @@ void GLCRenderer::disableSelectionMode()
     {
         GLC_State::setSelectionMode(false);
         GLC_State::setUseCustomFalseColor(false);
+        isIdColoring = false;
         resetColors();
     }
     else
@@ -168,13 +265,9 @@ std::vector<QString> GLCRenderer::enableSelectionMode(const bool useCurrentMater
     {
         repoError << "Trying to enable selectionMode when it is in selection mode!";
     }
-    else if(matMap.size() > (pow(2, 24) -1))
+    else if(!useCurrentMaterials && idTable.empty())
     {
-        //We represent indices using rgb values, which is 3*8 bit.
-        //0 can't be used as it will be the same as the background,
-        // so we can represent 2^24-1 components
         repoError << "This model has too many components to support selection!";
-
     }
     else
     {
@@ -189,21 +282,41 @@ std::vector<QString> GLCRenderer::enableSelectionMode(const bool useCurrentMater
             glcWorld.collection()->setSpacePartitionningUsage(true);
         }
 
+        // Viewable state above ignored the occlusion culling results
+        markVisibilityDirty();
+
         GLC_State::setSelectionMode(true);
         GLC_State::setUseCustomFalseColor(true);
         if(!useCurrentMaterials)
         {
             idMapping = applyFalseColoringMaterials();
+            isIdColoring = true;
+            if (!idShader && idTable.size() > 0x1000000)
+                repoLogError("No ID shader, components past 2^24 will be picked wrongly");
         }
 
 
         glEnable(GL_DEPTH_TEST);
+        // Alpha holds ID bits rather than opacity
+        glDisable(GL_BLEND);
 
     }
 
     return idMapping;
 }
 
+QImage GLCRenderer::readIdImage(int w, int h)
+{
+    QImage image(w, h, QImage::Format_RGBA8888);
+    QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+    f->glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    // GL rows go upwards
+    for (int y = 0; y < h; ++y)
+        f->glReadPixels(0, h - 1 - y, w, 1, GL_RGBA, GL_UNSIGNED_BYTE, image.scanLine(y));
+    f->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    return image;
+}
+
 
 void GLCRenderer::extractMeshes(GLC_StructOccurrence * occurrence)
 {
@@ -297,14 +410,21 @@ QImage GLCRenderer::getCurrentImageWithNoShading(
 
     fbo.bind();
 
+    // Background decodes to the empty ID 0
+    const QColor originalBackground = glcViewport.backgroundColor();
+    if (useFalseColoring)
+        glcViewport.setBackgroundColor(Qt::black);
+
     idMap = enableSelectionMode(!useFalseColoring);
     render(nullptr);
 
-    auto image = fbo.toImage();
+    // Premultiplied images would lose the ID bits in alpha
+    auto image = useFalseColoring ? readIdImage(w, h) : fbo.toImage();
 
     disableSelectionMode();
     fbo.release();
     fbo.bindDefault();
+    glcViewport.setBackgroundColor(originalBackground);
 
     // Reset to original window size.
     resizeWindow(originalWidth, originalHeight);
@@ -329,6 +449,100 @@ QImage GLCRenderer::getCurrentImageWithFalseColoring(
 
 }
 
+std::vector<QString> GLCRenderer::requestIdBuffers(
+        const std::vector<CameraSettings> &cameras,
+        int w, int h,
+        RepoPixelReadback &readback,
+        const std::function<void(size_t, const QImage &)> &callback)
+{
+    resetColors();
+
+    const CameraSettings originalCamera = getCurrentCamera();
+    const QColor originalBackground = glcViewport.backgroundColor();
+    const QSize originalSize = glcViewport.size();
+    resizeWindow(w, h);
+
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    QOpenGLFramebufferObject fbo(w, h, format);
+
+    fbo.bind();
+
+    // Background decodes to the empty ID 0
+    glcViewport.setBackgroundColor(Qt::black);
+
+    // Materials are swapped once for all views
+    const std::vector<QString> idMap = enableSelectionMode(false);
+    for (size_t i = 0; i < cameras.size(); ++i)
+    {
+        setCamera(cameras[i]);
+        render(nullptr);
+
+        // The buffer is reused, reads are ordered before the next clear
+        readback.readColor(QRect(0, 0, w, h), [callback, i](const QImage &image)
+        {
+            callback(i, image);
+        });
+
+        // Hand over the views the GPU is already done with
+        readback.poll();
+    }
+
+    disableSelectionMode();
+    fbo.release();
+    fbo.bindDefault();
+
+    glcViewport.setBackgroundColor(originalBackground);
+    setCamera(originalCamera);
+    resizeWindow(originalSize.width(), originalSize.height());
+
+    return idMap;
+}
+
+std::vector<CameraSettings> GLCRenderer::getSurroundingCameras()
+{
+    std::vector<CameraSettings> cameras;
+    const GLC_BoundingBox bbox = glcWorld.boundingBox();
+    if (bbox.isEmpty())
+        return cameras;
+
+    const GLC_Point3d center = bbox.center();
+    const double halfAngle = glcViewport.viewAngle() * std::acos(-1.0) / 360.0;
+    const double distance = bbox.boundingSphereRadius() / std::sin(halfAngle);
+
+    for (int x = -1; x <= 1; ++x)
+    {
+        for (int y = -1; y <= 1; ++y)
+        {
+            for (int z = -1; z <= 1; ++z)
+            {
+                if (!x && !y && !z)
+                    continue;
+
+                GLC_Vector3d direction(x, y, z);
+                direction.normalize();
+                const GLC_Point3d eye = center + direction * distance;
+
+                // Y up unless looking straight up or down
+                const GLC_Vector3d up = (!x && !z) ? glc::Z_AXIS : glc::Y_AXIS;
+
+                CameraSettings camera;
+                camera.eye.x = eye.x();
+                camera.eye.y = eye.y();
+                camera.eye.z = eye.z();
+                camera.target.x = center.x();
+                camera.target.y = center.y();
+                camera.target.z = center.z();
+                camera.up.x = up.x();
+                camera.up.y = up.y();
+                camera.up.z = up.z();
+                cameras.push_back(camera);
+            }
+        }
+    }
+    return cameras;
+}
+
 void GLCRenderer::highlightMesh(
         const QString &meshId)
 {
@@ -369,6 +583,12 @@ void GLCRenderer::changeMeshMaterial(
         mat = matIt->second;
 
     }
+    else if(RepoMeshBatch *batch = findBatch(uuidString))
+    {
+        // Out of the shared group of the batch with the next frame
+        mat = batch->splitMember(uuidString);
+        splitBatches.insert(batch);
+    }
     else if(meshIt != meshMap.end())
     {
         GLC_Mesh *mesh = meshIt->second;
@@ -391,16 +611,32 @@ void GLCRenderer::changeMeshMaterial(
     }
 
     if (mat)
+        overrideMaterial(mat, newMat);
+}
+
+void GLCRenderer::overrideMaterial(
+        GLC_Material *mat,
+        const GLC_Material &newMat)
+{
+    if (changedMats.find(mat) == changedMats.end())
     {
-        if (changedMats.find(mat) == changedMats.end())
-        {
-            //preserve original material
-            changedMats[mat] = GLC_Material(*mat);
-        }
+        //preserve original material
+        changedMats[mat] = GLC_Material(*mat);
+    }
 
-        *mat=newMat;
+    // Applied while rendering, the geometry may be shared with other windows
+    overriddenMats[mat] = newMat;
 
-    }
+    // Opacity decides the render queue and the sort key of the mesh
+    markVisibilityDirty();
+}
+
+RepoMeshBatch *GLCRenderer::findBatch(const QString &uuidString) const
+{
+    auto meshIt = meshMap.find(uuidString);
+    RepoMeshBatch *batch = meshIt != meshMap.end() ?
+                dynamic_cast<RepoMeshBatch*>(meshIt->second) : nullptr;
+    return batch && batch->hasMember(uuidString) ? batch : nullptr;
 }
 
 
@@ -463,28 +699,19 @@ void GLCRenderer::initialize()
     // Initialize fps counter
     fpsCounter.initialize();
 
+    //--------------------------------------------------------------------------
+    // Initialize GL timer queries of the frame profiler
+    frameProfiler.initialize();
+
 }
 
 void GLCRenderer::loadModel(
         repo::core::model::RepoScene *scene,
         const std::vector<double> &offsetVector)
 {
-    //We have a scene, fire up the GLC worker to get a GLC World representation
-    //--------------------------------------------------------------------------
-    // Establish and connect the new worker.
-    repo::worker::GLCExportWorker* worker =
-            new repo::worker::GLCExportWorker(scene, offsetVector);
-    connect(worker, &repo::worker::GLCExportWorker::finished,
-            this, &GLCRenderer::setGLCWorld);
-    connect(worker, &repo::worker::GLCExportWorker::progress, this, &GLCRenderer::workerProgress);
-
-    QObject::connect(
-                this, &AbstractRenderer::killWorker,
-                worker, &repo::worker::GLCExportWorker::cancel, Qt::DirectConnection);
-
-    //--------------------------------------------------------------------------
-    // Fire up the asynchronous calculation.
-    QThreadPool::globalInstance()->start(worker);
+    loadedScene = scene;
+    loadedOffset = offsetVector;
+    modelReleased = false;
 
 	if (offsetVector.size())
 	{
@@ -494,7 +721,90 @@ void GLCRenderer::loadModel(
 
 		offset = dOffset;
 	}
-    
+
+    //--------------------------------------------------------------------------
+    // Streaming places meshes by their own matrices, references would need
+    // an index of their own
+    clearStreamedGeometry();
+    if (!modelRestoring)
+        visibilityIndex.clear();
+    const bool streaming = streamingAllowed && RepoGeometryStreamer::isEnabledSetting() &&
+            scene->getAllReferences(scene->getViewGraph()).empty();
+
+    //--------------------------------------------------------------------------
+    // Reuse the geometry of another window showing the same revision
+    RepoGeometryRegistry &registry = RepoGeometryRegistry::getInstance();
+    resetColors();
+    // The current world keeps its geometry alive until replaced
+    registry.release(geometryKey);
+    geometryKey = streaming ? QString() : RepoGeometryRegistry::getKey(scene, offsetVector);
+
+    GLC_World sharedWorld;
+    std::map<QString, GLC_Mesh*> sharedMeshMap;
+    std::map<QString, GLC_Material*> sharedMatMap;
+    if (streaming)
+    {
+        //----------------------------------------------------------------------
+        // Structure and bounds first, geometry follows the view
+        repo::worker::MeshIndexWorker* indexWorker =
+                new repo::worker::MeshIndexWorker(scene, offset);
+        connect(indexWorker, &repo::worker::MeshIndexWorker::finished,
+                this, &GLCRenderer::setStreamIndex);
+        connect(indexWorker, &repo::worker::MeshIndexWorker::progress,
+                this, &GLCRenderer::workerProgress);
+        QObject::connect(
+                    this, &AbstractRenderer::killWorker,
+                    indexWorker, &repo::worker::MeshIndexWorker::cancel, Qt::DirectConnection);
+        startWorker(indexWorker);
+    }
+    else if (registry.acquire(geometryKey, sharedWorld, sharedMeshMap, sharedMatMap))
+        setGLCWorld(sharedWorld, sharedMeshMap, sharedMatMap);
+    else
+    {
+        //We have a scene, fire up the GLC worker to get a GLC World representation
+        //----------------------------------------------------------------------
+        // Establish and connect the new worker.
+        repo::worker::GLCExportWorker* worker =
+                new repo::worker::GLCExportWorker(scene, offsetVector);
+        connect(worker, &repo::worker::GLCExportWorker::finished,
+                this, &GLCRenderer::setConvertedGLCWorld);
+        connect(worker, &repo::worker::GLCExportWorker::progress, this, &GLCRenderer::workerProgress);
+
+        QObject::connect(
+                    this, &AbstractRenderer::killWorker,
+                    worker, &repo::worker::GLCExportWorker::cancel, Qt::DirectConnection);
+
+        //----------------------------------------------------------------------
+        // Fire up the asynchronous calculation.
+        startWorker(worker);
+    }
+
+    // Boxes of a previous model still being collected are discarded
+    meshBBoxOverlay.clear();
+    meshBBoxVisible = false;
+    meshBBoxPending = false;
+    partitionOverlay.clear();
+    partitionVisible = false;
+    partitionPending = false;
+
+    //--------------------------------------------------------------------------
+    // Point clouds are sorted on the side, the chunk file outlives releases
+    if (!modelRestoring)
+    {
+        if (!pointCloud.isEmpty())
+            pointCloudUpdated = true; // cleared on the next frame
+        pointCloudPending = true;
+        const QString path = QDir::temp().filePath(
+                    "3drepo_points_" + QUuid::createUuid().toString().mid(1, 36) + ".bin");
+        repo::worker::PointCloudWorker* pointWorker =
+                new repo::worker::PointCloudWorker(scene, offset, path);
+        connect(pointWorker, &repo::worker::PointCloudWorker::finished,
+                this, &GLCRenderer::setPointCloud);
+        QObject::connect(
+                    this, &AbstractRenderer::killWorker,
+                    pointWorker, &repo::worker::PointCloudWorker::cancel, Qt::DirectConnection);
+        startWorker(pointWorker);
+    }
 }
 
 bool GLCRenderer::move(const int &x, const int &y)
@@ -560,8 +870,33 @@ void GLCRenderer::setMeshColor(
     changeMeshMaterial(uuidString, coloredMat);
 }
 
+void GLCRenderer::setMeshVisibility(
+        const std::vector<repoUUID> &uniqueIDs,
+        bool visible)
+{
+    std::vector<QString> keys;
+    keys.reserve(uniqueIDs.size());
+    for (const repoUUID &uniqueID : uniqueIDs)
+        keys.push_back(QString::fromStdString(UUIDtoString(uniqueID)));
+
+    QElapsedTimer timer;
+    timer.start();
+    const int changed = visibilityIndex.setVisible(glcWorld, meshMap, keys, visible);
+    repoLogDebug(std::string(visible ? "Shown " : "Hidden ") + std::to_string(keys.size()) +
+                 " meshes in " + std::to_string(changed) + " instances in " +
+                 std::to_string(timer.elapsed()) + " ms");
+    markVisibilityDirty();
+}
+
 void GLCRenderer::startNavigation(const NavMode &mode, const int &x, const int &y)
 {
+    QSettings settings;
+    frameGovernor.setTargetFPS(settings.value(
+        RepoFrameGovernor::REPO_SETTINGS_TARGET_FPS, frameGovernor.getTargetFPS()).toDouble());
+    pointCloud.setPointBudget(RepoPointCloud::getBudgetSetting());
+    geometryStreamer.setBudget(RepoGeometryStreamer::getBudgetSetting());
+    frameGovernor.setNavigating(true);
+
     switch (mode)
     {
     case NavMode::TURNTABLE:
@@ -617,6 +952,203 @@ void GLCRenderer::stopNavigation()
     {
         glcMoverController.setNoMover();
     }
+
+    // Back to full quality once the camera stops
+    if (frameGovernor.setNavigating(false))
+        applyGovernorLevel();
+}
+
+std::vector<const GLC_Plane*> GLCRenderer::getActiveClipPlanes() const
+{
+    std::vector<const GLC_Plane*> planes;
+    if (clippingPlane)
+        planes.push_back(clippingPlane);
+    for (const GLC_Plane *plane : sectionPlanes)
+        if (plane)
+            planes.push_back(plane);
+    return planes;
+}
+
+bool GLCRenderer::isClippedOut(
+        const GLC_BoundingBox &bbox,
+        const std::vector<const GLC_Plane*> &planes)
+{
+    const GLC_Point3d &l = bbox.lowerCorner();
+    const GLC_Point3d &u = bbox.upperCorner();
+    for (const GLC_Plane *plane : planes)
+    {
+        // Corner furthest along the normal, kept if on the positive side
+        const double x = plane->coefA() >= 0 ? u.x() : l.x();
+        const double y = plane->coefB() >= 0 ? u.y() : l.y();
+        const double z = plane->coefC() >= 0 ? u.z() : l.z();
+        if (plane->coefA() * x + plane->coefB() * y + plane->coefC() * z + plane->coefD() < 0)
+            return true;
+    }
+    return false;
+}
+
+void GLCRenderer::updateGeometryViewableState()
+{
+    culledBodies = 0;
+    clippedInstances = 0;
+    const GLC_Frustum &frustum = glcViewport.frustum();
+    const std::vector<const GLC_Plane*> planes = getActiveClipPlanes();
+    std::vector<bool> inFrustum;
+    for (GLC_3DViewInstance *instance : glcWorld.collection()->instancesHandle())
+    {
+        if (!instance->isVisible() ||
+                instance->viewableFlag() == GLC_3DViewInstance::NoViewable)
+            continue;
+
+        // Clipping reduces the work drawn, not only the pixels
+        if (!planes.empty() && isClippedOut(instance->boundingBox(), planes))
+        {
+            instance->setViewable(GLC_3DViewInstance::NoViewable);
+            ++clippedInstances;
+            continue;
+        }
+
+        const int count = instance->numberOfGeometry();
+        if (count < 2)
+            continue;
+
+        // Bodies hidden by the user count as neither viewable nor culled
+        const std::vector<bool> *hidden = visibilityIndex.hasHiddenBodies() ?
+                    visibilityIndex.getHiddenBodies(instance) : nullptr;
+        int visible = 0;
+        int hiddenCount = 0;
+        inFrustum.assign(count, true);
+        for (int i = 0; i < count; ++i)
+        {
+            if (hidden && (*hidden)[i])
+            {
+                inFrustum[i] = false;
+                ++hiddenCount;
+                continue;
+            }
+            GLC_BoundingBox bbox = instance->geomAt(i)->boundingBox();
+            bbox.transform(instance->matrix());
+            inFrustum[i] = frustum.localizeBoundingBox(bbox) != GLC_Frustum::OutFrustum &&
+                    (planes.empty() || !isClippedOut(bbox, planes));
+            if (inFrustum[i])
+                ++visible;
+        }
+
+        if (visible == count)
+            continue;
+
+        if (visible)
+        {
+            instance->setViewable(GLC_3DViewInstance::PartialViewable);
+            for (int i = 0; i < count; ++i)
+                instance->setGeomViewable(i, inFrustum[i]);
+        }
+        else
+            instance->setViewable(GLC_3DViewInstance::NoViewable);
+        culledBodies += count - visible - hiddenCount;
+    }
+}
+
+void GLCRenderer::applyGovernorLevel()
+{
+    glcViewport.setMinimumPixelCullingSize(frameGovernor.getMinimumPixelCullingSize());
+    markVisibilityDirty();
+}
+
+bool GLCRenderer::releaseModel()
+{
+    if (modelReleased || !loadedScene || glcWorld.isEmpty())
+        return false;
+
+    releasedCamera = getCurrentCamera();
+    releasedOverrides.clear();
+    for (const auto &pair : matMap)
+    {
+        auto it = overriddenMats.find(pair.second);
+        if (it != overriddenMats.end())
+            releasedOverrides[pair.first] = it->second;
+    }
+    for (const auto &pair : meshMap)
+    {
+        // Split members of batches, named by their unique IDs
+        RepoMeshBatch *batch = dynamic_cast<RepoMeshBatch*>(pair.second);
+        if (batch && batch->name() == pair.first)
+            for (GLC_Material *memberMat : batch->getMemberMaterials())
+            {
+                auto it = overriddenMats.find(memberMat);
+                if (it != overriddenMats.end())
+                    releasedOverrides[memberMat->name()] = it->second;
+            }
+    }
+    resetColors();
+    currentlyHighLighted = "";
+
+    //--------------------------------------------------------------------------
+    // Nothing may point to the instances once the world is gone
+    frameGovernor.restore();
+    occlusionCuller.clear();
+    occludersPending = false;
+    renderQueue.clear();
+    transparentQueue.clear();
+    splitBatches.clear();
+    meshMap.clear();
+    matMap.clear();
+    idTable.clear();
+    clearStreamedGeometry();
+    glcWorld = GLC_World();
+    visibilityIndex.reset(glcWorld, meshMap);
+    markGeometryDirty();
+
+    RepoGeometryRegistry::getInstance().release(geometryKey);
+    geometryKey.clear();
+
+    repoLog("Released " + std::to_string(modelFootprint / (1024 * 1024)) + " MB of geometry");
+    modelFootprint = 0;
+    modelReleased = true;
+    return true;
+}
+
+void GLCRenderer::restoreModel(repo::core::model::RepoScene *scene)
+{
+    if (scene)
+        loadedScene = scene;
+    if (!modelReleased || !loadedScene)
+        return;
+
+    modelRestoring = true;
+    loadModel(loadedScene, loadedOffset);
+}
+
+bool GLCRenderer::releaseScene()
+{
+    // Running workers read the scene until they are deleted
+    if (!modelReleased || !loadedScene || activeWorkers > 0)
+        return false;
+    loadedScene = nullptr;
+    return true;
+}
+
+void GLCRenderer::startWorker(repo::worker::RepoAbstractWorker *worker)
+{
+    // Deleted by the pool thread once run, the decrement is queued back here
+    ++activeWorkers;
+    QObject::connect(worker, &QObject::destroyed, this, [this]() { --activeWorkers; });
+    QThreadPool::globalInstance()->start(worker);
+}
+
+qint64 GLCRenderer::getModelFootprint() const
+{
+    const int useCount = RepoGeometryRegistry::getInstance().getUseCount(geometryKey);
+    return useCount > 1 ? modelFootprint / useCount : modelFootprint;
+}
+
+void GLCRenderer::setConvertedGLCWorld(
+        GLC_World                        &world,
+        std::map<QString, GLC_Mesh*>     &_meshMap,
+        std::map<QString, GLC_Material*> &_matMap)
+{
+    RepoGeometryRegistry::getInstance().share(geometryKey, world, _meshMap, _matMap);
+    setGLCWorld(world, _meshMap, _matMap);
 }
 
 void GLCRenderer::setGLCWorld(GLC_World                        &world,
@@ -630,8 +1162,17 @@ void GLCRenderer::setGLCWorld(GLC_World                        &world,
 
     meshMap    = _meshMap;
     matMap     = _matMap;
-
+    splitBatches.clear();
+    assignIds();
+
+    frameGovernor.restore();
+    occlusionCuller.clear();
+    renderQueue.clear();
+    transparentQueue.clear();
+    markGeometryDirty();
     this->glcWorld = world;
+    modelFootprint = world.numberOfVertex() * REPO_FOOTPRINT_VERTEX_BYTES +
+            world.numberOfFaces() * REPO_FOOTPRINT_FACE_BYTES;
     this->glcWorld.collection()->setLodUsage(true, &glcViewport);
     this->glcWorld.collection()->setVboUsage(true);
 
@@ -640,11 +1181,30 @@ void GLCRenderer::setGLCWorld(GLC_World                        &world,
     octree->updateSpacePartitioning();
     this->glcWorld.collection()->bindSpacePartitioning(octree);
     this->glcWorld.collection()->updateSpacePartitionning();
+    visibilityIndex.reset(this->glcWorld, meshMap);
     this->glcWorld.collection()->updateInstanceViewableState(glcViewport.frustum());
 
     GLC_BoundingBox bbox = this->glcWorld.boundingBox();
     glcViewport.setDistMinAndMax(bbox);
-    setCamera(CameraView::ISO);
+    if (modelRestoring)
+    {
+        // Transparent to the user, the view is as it was before the release
+        setCamera(releasedCamera);
+        for (const auto &pair : releasedOverrides)
+            changeMeshMaterial(pair.first, pair.second);
+        releasedOverrides.clear();
+        modelRestoring = false;
+    }
+    else
+        setCamera(CameraView::ISO);
+
+    // Collected by the first frame before it draws, i.e. before the meshes of
+    // a fresh world are moved into VBOs, while those of a world shared from
+    // the registry can only be read back from their VBOs with the context
+    // current
+    occludersPending = true;
+
+    emit modelLoaded();
     //extractMeshes(this->glcWorld.rootOccurrence());
 
 
@@ -737,9 +1297,78 @@ void GLCRenderer::paintInfo(QPainter *painter,
                           tr("Tris") + ": " + locale.toString((qulonglong)GLC_RenderStatistics::triangleCount()));
         painter->drawText(9, 30, QString() +
                           tr("Objs") + ": " + locale.toString((uint)GLC_RenderStatistics::bodyCount()));
+        int line = 46;
+        if (occlusionCuller.isEnabled())
+        {
+            painter->drawText(9, line, QString() +
+                              tr("Occluded") + ": " + locale.toString(occlusionCuller.getCulledCount()) +
+                              " / " + locale.toString(occlusionCuller.getTestedCount()));
+            line += 16;
+        }
+        painter->drawText(9, line, QString() +
+                          tr("Cached") + ": " + locale.toString((qulonglong)skippedUpdates));
+        line += 16;
+        if (culledBodies > 0)
+        {
+            painter->drawText(9, line, QString() +
+                              tr("Culled bodies") + ": " + locale.toString(culledBodies));
+            line += 16;
+        }
+        if (clippedInstances > 0)
+        {
+            painter->drawText(9, line, QString() +
+                              tr("Clipped") + ": " + locale.toString(clippedInstances));
+            line += 16;
+        }
+        if (frameGovernor.getLevel() > 0)
+        {
+            painter->drawText(9, line, QString() +
+                              tr("Reduced quality") + ": " + QString::number(frameGovernor.getLevel()) +
+                              " (" + QString::number(frameGovernor.getFrameTime(), 'f', 1) + " ms, " +
+                              tr("proxies") + ": " + locale.toString(frameGovernor.getProxyCount()) + ")");
+            line += 16;
+        }
+        if (!pointCloud.isEmpty())
+        {
+            painter->drawText(9, line, QString() +
+                              tr("Points") + ": " + locale.toString(pointCloud.getRenderedCount()) +
+                              " / " + locale.toString(pointCloud.getPointCount()));
+            line += 16;
+        }
+        if (geometryStreamer.isActive())
+        {
+            painter->drawText(9, line, QString() +
+                              tr("Streamed") + ": " + locale.toString(geometryStreamer.getResidentCount()) +
+                              " / " + locale.toString(geometryStreamer.getMeshCount()) +
+                              " (" + locale.toString(geometryStreamer.getResidentBytes() / (1024 * 1024)) + " MB)");
+            line += 16;
+            painter->drawText(9, line, QString() +
+                              tr("Compressed") + ": " + locale.toString(geometryStreamer.getCompressedCount()) +
+                              " (" + locale.toString(geometryStreamer.getCompressedBytes() / (1024 * 1024)) + " MB, 1:" +
+                              locale.toString(geometryStreamer.getCompressionRatio(), 'f', 1) + "), " +
+                              tr("decode") + " " + locale.toString(geometryStreamer.getAverageDecodeTime(), 'f', 2) + " ms");
+            line += 16;
+        }
+        if (visibilityIndex.getHiddenCount() > 0)
+        {
+            painter->drawText(9, line, QString() +
+                              tr("Hidden") + ": " + locale.toString(visibilityIndex.getHiddenCount()));
+            line += 16;
+        }
+        if (renderQueue.isEnabled())
+        {
+            painter->drawText(9, line, QString() +
+                              tr("State changes") + ": " + locale.toString(renderQueue.getUnsortedStateChanges()) +
+                              " -> " + locale.toString(renderQueue.getSortedStateChanges()));
+        }
 
         painter->drawText(screenWidth - 60, 14, fpsCounter.getFPSString());
 
+        //----------------------------------------------------------------------
+        // Display per-phase frame timings (CPU / GPU in ms)
+        if (frameProfiler.isOverlayVisible())
+            frameProfiler.paint(painter, screenWidth - 220, 30);
+
         //----------------------------------------------------------------------
         // Display selection
         if (!currentlyHighLighted.isEmpty())
@@ -755,60 +1384,193 @@ void GLCRenderer::render(QPainter *painter,
                          const int &screenHeight,
                          const int &screenWidth)
 {
+    frameProfiler.beginFrame();
+
+    // Regrouped with the original materials in place
+    if (!splitBatches.empty())
+    {
+        for (RepoMeshBatch *batch : splitBatches)
+            batch->update();
+        splitBatches.clear();
+        markVisibilityDirty();
+    }
+
+    // Materials hold the originals between frames as the geometry may be
+    // shared with other windows
+    applyMaterialOverrides();
 
     try
     {
         GLC_RenderStatistics::reset();
 
-        //----------------------------------------------------------------------
-        // Calculate camera's depth of view
-        glcViewport.setDistMinAndMax(glcWorld.boundingBox());
-        glcWorld.collection()->updateInstanceViewableState();
+        if (frameGovernor.frame())
+            applyGovernorLevel();
 
-        //----------------------------------------------------------------------
-        // Clear screen
-        QColor bc = glcViewport.backgroundColor();
-        glClearColor(bc.redF(), bc.greenF(), bc.blueF(), 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (pointCloudUpdated)
+        {
+            pointCloud.setData(pointCloudUpdate);
+            pointCloud.setPointBudget(RepoPointCloud::getBudgetSetting());
+            pointCloudUpdate = RepoPointCloudData();
+            pointCloudUpdated = false;
+            markGeometryDirty();
+        }
+
+        if (!streamedUpdate.empty())
+            applyStreamedGeometry();
 
+        if (occludersPending)
+        {
+            occlusionCuller.setOccluders(glcWorld);
+            occludersPending = false;
+            markVisibilityDirty();
+        }
 
         //----------------------------------------------------------------------
-        // Load identity matrix
-        GLC_Context::current()->glcLoadIdentity();
-        glEnable(GL_MULTISAMPLE);
+        // Calculate camera's depth of view, only if the camera or scene changed
+        const bool isRecalculated = updateDirtyState();
+        if (isRecalculated)
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::VIEWABLE_STATE);
+            if (geometryDirty)
+            {
+                worldBoundingBox = glcWorld.boundingBox();
+                if (!pointCloud.isEmpty())
+                    worldBoundingBox.combine(pointCloud.getBoundingBox());
+                if (geometryStreamer.isActive())
+                    worldBoundingBox.combine(geometryStreamer.getBoundingBox());
+            }
+            glcViewport.setDistMinAndMax(worldBoundingBox);
+        }
+        else
+            ++skippedUpdates;
+
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::SETUP);
+
+            //------------------------------------------------------------------
+            // Clear screen
+            QColor bc = glcViewport.backgroundColor();
+            glClearColor(bc.redF(), bc.greenF(), bc.blueF(), 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+
+            //------------------------------------------------------------------
+            // Load identity matrix
+            GLC_Context::current()->glcLoadIdentity();
+            glEnable(GL_MULTISAMPLE);
+
+            glEnable(GL_PROGRAM_POINT_SIZE);
+            glPointSize(getPointSize());
+
+
+            //------------------------------------------------------------------
+            // Define the light
+            glcLight.glExecute();
 
-        glEnable(GL_PROGRAM_POINT_SIZE);
-        glPointSize(getPointSize());
+            //------------------------------------------------------------------
+            // Define view matrix
+            glcViewport.glExecuteCam();
 
+            if (!tile.isNull() || !subPixelOffset.isNull())
+                applyTileProjection();
+
+            glcViewport.useClipPlane(true);
+        }
 
         //----------------------------------------------------------------------
-        // Define the light
-        glcLight.glExecute();
+        // The frustum is taken from the matrices of this frame, hence only
+        // once the camera is executed, or culling would lag one view behind
+        if (isRecalculated)
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::VIEWABLE_STATE);
+            frameGovernor.restore();
+            occlusionCuller.restore();
+            glcWorld.collection()->updateInstanceViewableState();
+            updateGeometryViewableState();
+
+            cameraDirty = visibilityDirty = geometryDirty = false;
+
+            // Captures and tiles show what is resident
+            if (geometryStreamer.isActive() && !streamPending &&
+                    tile.isNull() && !GLC_State::isInSelectionMode())
+                requestGeometry();
+        }
 
         //----------------------------------------------------------------------
-        // Define view matrix
-        glcViewport.glExecuteCam();
+        // Hide instances behind the largest nearby occluders, previous
+        // results remain valid until the viewable state is recalculated
+        if (isRecalculated)
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::OCCLUSION);
+            occlusionCuller.cull(glcWorld, glcViewport);
+
+            // Replace tiny objects by box proxies when behind the target frame rate
+            frameGovernor.applyProxies(glcWorld, glcViewport);
+
+            renderQueue.update(glcWorld, glcViewport.cameraHandle()->eye());
 
-        glcViewport.useClipPlane(true);
+            // Recalculated on every camera move, the previous order keeps
+            // the insertion sort near-linear
+            if (!frameGovernor.isTransparentSkipped())
+                transparentQueue.update(glcWorld, glcViewport.cameraHandle()->eye());
+        }
 
-        // Apply global shader if set.
-        if (shaderID && !GLC_State::isInSelectionMode())
-            GLC_Shader::use(shaderID);
+        // Apply global shader if set, false colour IDs have their own
+        const GLuint programID = !GLC_State::isInSelectionMode() ? shaderID :
+                (isIdColoring && idShader ? idShader->id() : 0);
+        if (programID)
+            GLC_Shader::use(programID);
 
         // Display opaque instanced objects
-        glcWorld.render(0, renderingFlag);
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::OPAQUE_PASS);
+            // False colours do not depend on draw order
+            if (renderQueue.isEnabled() && !GLC_State::isInSelectionMode())
+                renderQueue.render(renderingFlag, &glcViewport);
+            else
+                glcWorld.render(0, renderingFlag);
+        }
         if (GLC_State::glslUsed())
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::OPAQUE_SHADER_GROUP);
             glcWorld.renderShaderGroup(renderingFlag);
+        }
+
+        // Point clouds carry their own colours and are not selectable
+        if (!pointCloud.isEmpty() && !GLC_State::isInSelectionMode())
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::POINT_CLOUD);
+            if (shaderID)
+                GLC_Shader::unuse();
+            if (pointCloud.render(glcViewport))
+                emit repaintNeeded(); // chunks in view still to stream in
+            if (shaderID)
+                GLC_Shader::use(shaderID);
+        }
 
         // Display transparent instanced objects
-        glcWorld.render(0, glc::TransparentRenderFlag);
-        if (GLC_State::glslUsed())
+        if (!frameGovernor.isTransparentSkipped())
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::TRANSPARENT_PASS);
+            if (transparentQueue.isEnabled() && !GLC_State::isInSelectionMode())
+                transparentQueue.render(glc::TransparentRenderFlag, &glcViewport);
+            else
+                glcWorld.render(0, glc::TransparentRenderFlag);
+        }
+        if (GLC_State::glslUsed() && !frameGovernor.isTransparentSkipped())
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::TRANSPARENT_SHADER_GROUP);
             glcWorld.renderShaderGroup(glc::TransparentRenderFlag);
+        }
 
 
         // Render the collection which contains bounding boxes
-        glcViewCollection.render(0, glc::WireRenderFlag); // To see a box edged
-        glcViewCollection.render(0, glc::TransparentRenderFlag); // Render transparent faces
+        if (!frameGovernor.isOverlaySkipped())
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::OVERLAYS);
+            glcViewCollection.render(0, glc::WireRenderFlag); // To see a box edged
+            glcViewCollection.render(0, glc::TransparentRenderFlag); // Render transparent faces
+        }
 
         //----------------------------------------------------------------------
         // Display selected objects
@@ -817,6 +1579,7 @@ void GLCRenderer::render(QPainter *painter,
                 GLC_State::selectionShaderUsed() &&
                 !GLC_State::isInSelectionMode())
         {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::SELECTION);
             //if (selectedNodesCount != glcWorld.collection()->drawableObjectsSize())
             //{
             //Draw the selection with Zbuffer
@@ -832,28 +1595,53 @@ void GLCRenderer::render(QPainter *painter,
             glPopAttrib();
         }
         else if (selectedNodesCount > 0)
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::SELECTION);
             glcWorld.render(1, renderingFlag);
+        }
 
         // Remove global shader if set.
-        if (shaderID)
+        if (programID)
             GLC_Shader::unuse();
 
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::OVERLAYS);
+            // Proxies stand in for culled instances, they cannot be picked
+            if (!GLC_State::isInSelectionMode())
+                frameGovernor.renderProxies();
+            if (meshBBoxVisible && !frameGovernor.isOverlaySkipped() &&
+                    !GLC_State::isInSelectionMode())
+                meshBBoxOverlay.render();
+            if (partitionVisible && !frameGovernor.isOverlaySkipped() &&
+                    !GLC_State::isInSelectionMode())
+                partitionOverlay.render();
+            if (geometryStreamer.isActive() && !frameGovernor.isOverlaySkipped() &&
+                    !GLC_State::isInSelectionMode())
+                geometryStreamer.renderProxies();
+        }
+
         glcViewport.useClipPlane(false);
 
-        if (!GLC_State::isInSelectionMode())
-            glc3DWidgetManager.render();
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::WIDGETS);
+            if (!GLC_State::isInSelectionMode() && !frameGovernor.isOverlaySkipped())
+                glc3DWidgetManager.render();
 
-        //----------------------------------------------------------------------
-        // Display UI Info (orbit circle)
-        glDisable(GL_BLEND);
-        glDepthMask(GL_TRUE);
-        glEnable(GL_DEPTH_TEST);
+            //------------------------------------------------------------------
+            // Display UI Info (orbit circle)
+            glDisable(GL_BLEND);
+            glDepthMask(GL_TRUE);
+            glEnable(GL_DEPTH_TEST);
 
-        glcMoverController.drawActiveMoverRep();
+            glcMoverController.drawActiveMoverRep();
+        }
 
-        glDisable(GL_DEPTH_TEST);
-        GLC_ContextManager::instance()->currentContext()->glcMatrixMode(GL_MODELVIEW);
-        paintInfo(painter, screenHeight, screenWidth);
+        {
+            RepoFrameProfiler::ScopedPhase phase(frameProfiler, FramePhase::INFO);
+            glDisable(GL_DEPTH_TEST);
+            GLC_ContextManager::instance()->currentContext()->glcMatrixMode(GL_MODELVIEW);
+            paintInfo(painter, screenHeight, screenWidth);
+        }
 
         // So that models look nice
         glDisable(GL_CULL_FACE);
@@ -863,6 +1651,9 @@ void GLCRenderer::render(QPainter *painter,
     {
         repoLogError(e.what());
     }
+
+    restoreMaterialOverrides();
+    frameProfiler.endFrame();
 }
 
 void GLCRenderer::resetColors()
@@ -872,6 +1663,24 @@ void GLCRenderer::resetColors()
         *pair.first = pair.second;
     }
     changedMats.clear();
+    overriddenMats.clear();
+    markVisibilityDirty();
+}
+
+void GLCRenderer::applyMaterialOverrides()
+{
+    for (const auto &pair : overriddenMats)
+        *pair.first = pair.second;
+}
+
+void GLCRenderer::restoreMaterialOverrides()
+{
+    for (const auto &pair : overriddenMats)
+    {
+        auto changedIt = changedMats.find(pair.first);
+        if (changedIt != changedMats.end())
+            *pair.first = changedIt->second;
+    }
 }
 
 void GLCRenderer::resetView()
@@ -889,6 +1698,70 @@ void GLCRenderer::resizeWindow(const int &width, const int &height)
     glcViewport.setWinGLSize(width, height); // Compute window aspect ratio
 }
 
+void GLCRenderer::setTile(int imageWidth, int imageHeight, const QRect &newTile)
+{
+    if (newTile == tile)
+        return;
+    if (!newTile.isNull() && tile.isNull())
+        untiledSize = glcViewport.size();
+
+    // Frustum culling and the queues only hold for the projection of a tile
+    tile = newTile;
+    markVisibilityDirty();
+    if (!tile.isNull())
+        resizeWindow(imageWidth, imageHeight);
+    else if (untiledSize.isValid())
+    {
+        resizeWindow(untiledSize.width(), untiledSize.height());
+        untiledSize = QSize();
+    }
+}
+
+void GLCRenderer::setSubPixelOffset(double dx, double dy)
+{
+    const QPointF offset(dx, dy);
+    if (offset != subPixelOffset)
+    {
+        subPixelOffset = offset;
+        markVisibilityDirty();
+    }
+}
+
+void GLCRenderer::applyTileProjection()
+{
+    //--------------------------------------------------------------------------
+    // Scale and shift the tile's part of the normalised device coordinates
+    // onto the whole of them, y going up
+    const QSize size = glcViewport.size();
+    const QRect area = tile.isNull() ? QRect(QPoint(0, 0), size) : tile;
+    const double x0 = 2.0 * area.left() / size.width() - 1.0;
+    const double x1 = 2.0 * (area.left() + area.width()) / size.width() - 1.0;
+    const double y0 = 1.0 - 2.0 * (area.top() + area.height()) / size.height();
+    const double y1 = 1.0 - 2.0 * area.top() / size.height();
+    const double sx = 2.0 / (x1 - x0);
+    const double sy = 2.0 / (y1 - y0);
+
+    // Sub-pixel offset in the coordinates of the whole image
+    const double jx = 2.0 * subPixelOffset.x() / size.width();
+    const double jy = -2.0 * subPixelOffset.y() / size.height();
+
+    // Column major
+    const double tileMatrix[16] = {
+        sx, 0, 0, 0,
+        0, sy, 0, 0,
+        0, 0, 1, 0,
+        sx * (jx - (x0 + x1) / 2.0), sy * (jy - (y0 + y1) / 2.0), 0, 1 };
+
+    GLC_Context *context = GLC_ContextManager::instance()->currentContext();
+    context->glcMatrixMode(GL_PROJECTION);
+    context->glcLoadMatrix(GLC_Matrix4x4(tileMatrix) * glcViewport.projectionMatrix());
+    context->glcMatrixMode(GL_MODELVIEW);
+
+    // The viewport is sized to the whole image, beyond the GL limits
+    if (!tile.isNull())
+        glViewport(0, 0, tile.width(), tile.height());
+}
+
 void GLCRenderer::revertMeshMaterial(
         const QString &uuidString)
 {
@@ -900,6 +1773,11 @@ void GLCRenderer::revertMeshMaterial(
         mat = matIt->second;
 
     }
+    else if(RepoMeshBatch *batch = findBatch(uuidString))
+    {
+        // Null while still in the shared group, hence never changed
+        mat = batch->getMemberMaterial(uuidString);
+    }
     else if(meshIt != meshMap.end())
     {
         GLC_Mesh *mesh = meshIt->second;
@@ -927,6 +1805,8 @@ void GLCRenderer::revertMeshMaterial(
         {
             *mat = changedIt->second;
             changedMats.erase(changedIt);
+            overriddenMats.erase(mat);
+            markVisibilityDirty();
         }
 
     }
@@ -934,51 +1814,89 @@ void GLCRenderer::revertMeshMaterial(
 }
 
 
-void GLCRenderer::selectComponent(QOpenGLContext *context, int x, int y, bool multiSelection)
+void GLCRenderer::selectComponent(RepoPixelReadback &readback, int x, int y, bool multiSelection)
 {
     if(multiSelection)
         repoLogError("Multi-selection currently does not work");
     //FIXME: multi-selection doesn't work at the moment
-    if(matMap.size() > (pow(2, 24) -1))
+    if(idTable.empty())
     {
-        //We represent indices using rgb values, which is 3*8 bit.
-        //0 can't be used as it will be the same as the background,
-        // so we can represent 2^24-1 components
         repoError << "This model has too many components to support selection!";
         return;
     }
 
+    const QSize size = glcViewport.size();
+    const QRect pixel(x, size.height() - y, 1, 1);
+    if (!QRect(QPoint(0, 0), size).contains(pixel))
+        return;
+
     QOpenGLFramebufferObjectFormat format;
     format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
-    QOpenGLFramebufferObject fbo(glcViewport.size().width(), glcViewport.size().height(), format);
+    QOpenGLFramebufferObject fbo(size.width(), size.height(), format);
 
     fbo.bind();
     QColor backgroundColor = glcViewport.backgroundColor();
-    glcViewport.setBackgroundColor(QColor(Qt::white));
+    // Decodes to the empty ID 0
+    glcViewport.setBackgroundColor(QColor(Qt::black));
 
-    auto ids = enableSelectionMode(false);
+    const std::vector<QString> ids = enableSelectionMode(false);
 
     render(nullptr);
 
+    // Members of a batch share its ID and are told apart by the depth,
+    // unprojected with the matrices of this frame
+    const GLC_Matrix4x4 inverse = (glcViewport.projectionMatrix() *
+            glcViewport.cameraHandle()->modelViewMatrix()).inverted();
 
-    QVector<GLubyte> colorId(4); // 4 -> R G B A
-    context->functions()->glReadPixels(x, glcViewport.size().height() - y, 1, 1,
-                                       GL_RGBA, GL_UNSIGNED_BYTE, colorId.data());
+    //--------------------------------------------------------------------------
+    // Queued before the framebuffer goes, GL keeps the order and so do the
+    // callbacks, hence the ID is known once the depth arrives
+    std::shared_ptr<QString> picked = std::make_shared<QString>();
+    readback.readColor(pixel, [picked, ids](const QImage &image)
+    {
+        const QImage rgba = image.convertToFormat(QImage::Format_RGBA8888);
+        const quint32 returnId = decodeId(rgba.constBits());
+        if (returnId && returnId < ids.size())
+            *picked = ids[(int)returnId];
+    });
+    readback.readDepth(pixel, [this, picked, inverse, pixel, size](
+                       const std::vector<float> &depths, const QSize &)
+    {
+        if (picked->isEmpty() || depths.empty())
+            return;
+
+        QString meshId = *picked;
+        auto meshIt = meshMap.find(meshId);
+        RepoMeshBatch *batch = meshIt != meshMap.end() ?
+                    dynamic_cast<RepoMeshBatch*>(meshIt->second) : nullptr;
+        if (batch)
+        {
+            // Normalised device coordinates of the pixel centre, column major
+            const double ndc[4] = {
+                2.0 * (pixel.x() + 0.5) / size.width() - 1.0,
+                2.0 * (pixel.y() + 0.5) / size.height() - 1.0,
+                2.0 * depths[0] - 1.0,
+                1.0 };
+            const double *m = inverse.getData();
+            double p[4];
+            for (int i = 0; i < 4; ++i)
+                p[i] = m[i] * ndc[0] + m[4 + i] * ndc[1] + m[8 + i] * ndc[2] + m[12 + i] * ndc[3];
+            if (p[3] == 0)
+                return;
+            meshId = batch->findMember(GLC_Point3d(p[0] / p[3], p[1] / p[3], p[2] / p[3]));
+        }
+        if (!meshId.isEmpty())
+        {
+            highlightMesh(meshId);
+            emit repaintNeeded();
+        }
+    });
 
     disableSelectionMode();
-    GLC_uint returnId = glc::decodeRgbId(&colorId[0]);
-
-    if(returnId < ids.size())
-    {
-        highlightMesh(ids[(int)returnId]);
-    }
     fbo.release();
     fbo.bindDefault();
 
-
     glcViewport.setBackgroundColor(backgroundColor);
-
-    context->doneCurrent();
 }
 
 void GLCRenderer::setActivationFlag(const bool &flag)
@@ -996,11 +1914,16 @@ void GLCRenderer::setAndInitSelectionShaders(QFile &vertexFile, QFile &fragmentF
     }
 }
 
+void GLCRenderer::setAndInitIdShaders(QFile &vertexFile, QFile &fragmentFile, QOpenGLContext *context)
+{
+    if (GLC_State::glslUsed() && !idShader)
+        idShader = RepoShaderCache::getInstance().acquire(vertexFile, fragmentFile);
+}
+
 int GLCRenderer::appendAndInitRenderingShaders(QFile &vertexFile, QFile &fragmentFile, QOpenGLContext *context)
 {
-    GLC_Shader* shader= new GLC_Shader();
-    shader->setVertexAndFragmentShader(vertexFile, fragmentFile);
-    shader->createAndCompileProgrammShader();
+    // Compiled once for all windows as the contexts share programs
+    GLC_Shader* shader = RepoShaderCache::getInstance().acquire(vertexFile, fragmentFile);
     shaders.append(shader);
     return shaders.size() - 1;
 }
@@ -1062,196 +1985,242 @@ void GLCRenderer::setCamera(const CameraView& view)
         glcViewport.cameraHandle()->setIsoView();
     }
 
-    if (!glcWorld.isEmpty() && !glcWorld.boundingBox().isEmpty())
-        glcViewport.reframe(glcWorld.boundingBox());
+    GLC_BoundingBox bbox = glcWorld.isEmpty() ? GLC_BoundingBox() : glcWorld.boundingBox();
+    if (!pointCloud.isEmpty())
+        bbox.combine(pointCloud.getBoundingBox());
+    if (geometryStreamer.isActive())
+        bbox.combine(geometryStreamer.getBoundingBox());
+    if (!bbox.isEmpty())
+        glcViewport.reframe(bbox);
     else
     {
         repoLogError("GLC world is empty or bounding box is empty!");
     }
 }
 
-void GLCRenderer::createSPBoxes(
-        const std::shared_ptr<repo_partitioning_tree_t> &tree,
-        const std::vector<std::vector<float>>   &currentBox,
-         GLC_Material                      *mat
-        )
+void GLCRenderer::toggleGenericPartitioning(
+        repo::RepoController *controller,
+        repo::core::model::RepoScene *scene)
 {
-    if(tree)
-    {
-        //visualise this box
-        GLC_Point3d lower (currentBox[0][0], currentBox[0][1], currentBox[0][2]);
-        GLC_Point3d higher(currentBox[1][0], currentBox[1][1], currentBox[1][2]);
+    partitionVisible = !partitionVisible;
 
-        GLC_BoundingBox glcBbox(lower, higher);
-        auto box = GLC_Factory::instance()->createBox(glcBbox);
-        box.geomAt(0)->replaceMasterMaterial(mat);
-        glcViewCollection.add(box);
+    // Partitioning is computed once per model, toggling afterwards is instant
+    if (partitionVisible && partitionOverlay.isEmpty() && !partitionPending && scene)
+    {
+        partitionPending = true;
+        repo::worker::ScenePartitioningWorker* worker =
+                new repo::worker::ScenePartitioningWorker(controller, scene, offset);
+        connect(worker, &repo::worker::ScenePartitioningWorker::finished,
+                this, &GLCRenderer::setPartitioningBoxes);
+        connect(worker, &repo::worker::ScenePartitioningWorker::progress,
+                this, &GLCRenderer::workerProgress);
+        QObject::connect(
+                    this, &AbstractRenderer::killWorker,
+                    worker, &repo::worker::ScenePartitioningWorker::cancel, Qt::DirectConnection);
+        startWorker(worker);
+    }
+}
 
-        //recursively call this function for children
+void GLCRenderer::setPartitioningBoxes(
+        const repo::gui::renderer::RepoLineOverlayData &data)
+{
+    if (!partitionPending)
+        return;
+    partitionPending = false;
+    partitionOverlay.setData(data);
+    emit repaintNeeded();
+}
 
-        if(tree->type != repo::PartitioningTreeType::LEAF_NODE)
-        {
-            auto median = tree->pValue;
-            auto rightBox = currentBox;
-            auto leftBox = currentBox;
-            int axis = tree->type == repo::PartitioningTreeType::PARTITION_X? 0 :
-                                        (tree->type == repo::PartitioningTreeType::PARTITION_Y? 1 : 2);
-			double offsetAxis = offset.size() ? offset[axis] : 0;
-			rightBox[0][axis] = median + offsetAxis;
-			leftBox[1][axis] = median + offsetAxis;
-            createSPBoxes(tree->left, leftBox, mat);
-            createSPBoxes(tree->right, rightBox, mat);
-        }
+void GLCRenderer::toggleMeshBoundingBoxes(
+                     const repo::core::model::RepoScene *scene)
+{
+    meshBBoxVisible = !meshBBoxVisible;
 
+    // Boxes are collected once per model, toggling afterwards is instant
+    if (meshBBoxVisible && meshBBoxOverlay.isEmpty() && !meshBBoxPending && scene)
+    {
+        meshBBoxPending = true;
+        repo::worker::MeshBoundingBoxesWorker* worker =
+                new repo::worker::MeshBoundingBoxesWorker(scene, offset);
+        connect(worker, &repo::worker::MeshBoundingBoxesWorker::finished,
+                this, &GLCRenderer::setMeshBoundingBoxes);
+        connect(worker, &repo::worker::MeshBoundingBoxesWorker::progress,
+                this, &GLCRenderer::workerProgress);
+        QObject::connect(
+                    this, &AbstractRenderer::killWorker,
+                    worker, &repo::worker::MeshBoundingBoxesWorker::cancel, Qt::DirectConnection);
+        startWorker(worker);
     }
+}
 
+void GLCRenderer::setMeshBoundingBoxes(
+        const repo::gui::renderer::RepoLineOverlayData &data)
+{
+    if (!meshBBoxPending)
+        return;
+    meshBBoxPending = false;
+    meshBBoxOverlay.setData(data);
+    emit repaintNeeded();
 }
 
-void GLCRenderer::toggleGenericPartitioning(
-                       const std::vector<repo_vector_t> &sceneBbox,
-                       const std::shared_ptr<repo_partitioning_tree_t> &tree)
+void GLCRenderer::setPointCloud(
+        const repo::gui::renderer::RepoPointCloudData &data)
 {
+    if (!pointCloudPending)
+    {
+        QFile::remove(data.path);
+        return;
+    }
+    pointCloudPending = false;
+    if (pointCloudUpdated)
+        QFile::remove(pointCloudUpdate.path);
+    pointCloudUpdate = data;
+    pointCloudUpdated = true;
+    emit repaintNeeded();
+}
 
-    if (glcViewCollection.isEmpty())
+void GLCRenderer::setStreamIndex(
+        const repo::gui::renderer::RepoStreamIndex &index)
+{
+    if (index.meshes.empty())
     {
-        if(tree)
-        {
-            static GLC_Material* mat = new GLC_Material(Qt::yellow);
-            mat->setOpacity(0.1);
+        repoLogError("Nothing to stream in this model");
+        return;
+    }
 
-            std::vector<std::vector<float>> bbox = {
-                {sceneBbox[0].x, sceneBbox[0].y, sceneBbox[0].z},
-                {sceneBbox[1].x, sceneBbox[1].y, sceneBbox[1].z}
-            };
+    clearStreamedGeometry();
+    geometryStreamer.setIndex(index);
+    geometryStreamer.setBudget(RepoGeometryStreamer::getBudgetSetting());
 
-            if(offset.size())
-            {
-                for(int i = 0; i < offset.size(); ++i)
-                {
-                    bbox[0][i] += offset[i];
-                    bbox[1][i] += offset[i];
-                }
-            }
+    GLC_World world;
+    std::map<QString, GLC_Mesh*> emptyMeshMap;
+    std::map<QString, GLC_Material*> emptyMatMap;
+    setGLCWorld(world, emptyMeshMap, emptyMatMap);
+}
 
-            repoLog("Bounding box: ["+std::to_string(sceneBbox[0].x)+","+std::to_string(sceneBbox[0].y)+","+std::to_string(sceneBbox[0].z)
-                    +"]["+std::to_string(sceneBbox[1].x)+","+std::to_string(sceneBbox[1].y)+","+std::to_string(sceneBbox[1].z)
-                    +"]");
-            createSPBoxes(tree, bbox, mat);
-        }
+void GLCRenderer::requestGeometry()
+{
+    const std::vector<int> candidates = geometryStreamer.getCandidates(
+                glcViewport, REPO_STREAM_BATCH_SIZE);
+    if (candidates.empty() || !loadedScene)
+        return;
 
+    // Meshes seen before come back from their compressed copies
+    std::vector<RepoStreamIndexEntry> entries;
+    std::vector<RepoCompressedMesh> compressed;
+    for (const int candidate : candidates)
+    {
+        entries.push_back(geometryStreamer.getIndex().meshes[candidate]);
+        const RepoCompressedMesh *copy = geometryStreamer.getCompressed(candidate);
+        compressed.push_back(copy ? *copy : RepoCompressedMesh());
     }
-    else
-        glcViewCollection.clear();
-
+    geometryStreamer.setPending(candidates, true);
+    streamPending = true;
+
+    const int generation = streamGeneration;
+    repo::worker::GeometryStreamWorker* worker =
+            new repo::worker::GeometryStreamWorker(loadedScene, entries, candidates, compressed);
+    connect(worker, &repo::worker::GeometryStreamWorker::finished,
+            this, [this, generation](const RepoStreamedMeshes &meshes)
+    {
+        setStreamedGeometry(meshes, generation);
+    });
+    QObject::connect(
+                this, &AbstractRenderer::killWorker,
+                worker, &repo::worker::GeometryStreamWorker::cancel, Qt::DirectConnection);
+    startWorker(worker);
 }
 
-void GLCRenderer::createMeshBBoxes(
-        const repo::core::model::RepoScene            *scene,
-        const repo::core::model::RepoScene::GraphType &gType,
-        const repo::core::model::RepoNode             *node,
-        const std::vector<float>                      &matrix,
-              GLC_Material                            *mat)
+void GLCRenderer::setStreamedGeometry(
+        const RepoStreamedMeshes &meshes,
+        int generation)
 {
-    switch(node->getTypeAsEnum())
+    if (generation != streamGeneration)
     {
-        case repo::core::model::NodeType::MESH:
-        {
-            auto meshPtr = dynamic_cast<const repo::core::model::MeshNode*>(node);
-            if(meshPtr)
-            {
-                auto mappings = meshPtr->getMeshMapping();
-                if(mappings.size()>1)
-                {
-                    for(const auto &map : mappings)
-                    {
-                        auto min = multiplyMatVec(matrix,  map.min);
-                        auto max = multiplyMatVec(matrix,  map.max);
-
-                        GLC_Point3d lower (min.x, min.y, min.z);
-                        GLC_Point3d higher(max.x, max.y, max.z);
-
-                        GLC_BoundingBox glcBbox(lower, higher);
-                        auto box = GLC_Factory::instance()->createBox(glcBbox);
-                        box.geomAt(0)->replaceMasterMaterial(mat);
-                        glcViewCollection.add(box);
-                    }
-                }
-                else
-                {
-                    //single mesh, visualise this mesh's bounding box
-                    auto currentBox = meshPtr->getBoundingBox();
-                    for(auto &entry : currentBox)
-                    {
-                        entry = multiplyMatVec(matrix, entry);
-                    }
-
-                    GLC_Point3d lower (currentBox[0].x, currentBox[0].y, currentBox[0].z);
-                    GLC_Point3d higher(currentBox[1].x, currentBox[1].y, currentBox[1].z);
+        // Never attached to a world, hence without buffers
+        for (const RepoStreamedMesh &mesh : meshes)
+            delete mesh.occurrence;
+        return;
+    }
 
-                    GLC_BoundingBox glcBbox(lower, higher);
-                    auto box = GLC_Factory::instance()->createBox(glcBbox);
-                    box.geomAt(0)->replaceMasterMaterial(mat);
-                    glcViewCollection.add(box);
-                }
+    streamPending = false;
+    streamedUpdate.insert(streamedUpdate.end(), meshes.begin(), meshes.end());
+    emit repaintNeeded();
+}
 
-            }
+void GLCRenderer::applyStreamedGeometry()
+{
+    // Nothing may point to the instances about to be dropped
+    frameGovernor.restore();
+    occlusionCuller.clear();
+    renderQueue.clear();
+    transparentQueue.clear();
+
+    GLC_StructOccurrence *root = glcWorld.rootOccurrence();
+    for (const RepoStreamedMesh &mesh : streamedUpdate)
+    {
+        if (mesh.occurrence)
+            root->addChild(mesh.occurrence);
+        meshMap.insert(mesh.meshMap.begin(), mesh.meshMap.end());
+        matMap.insert(mesh.matMap.begin(), mesh.matMap.end());
+        geometryStreamer.insert(mesh, mesh.vertexCount * REPO_FOOTPRINT_VERTEX_BYTES +
+                                mesh.faceCount * REPO_FOOTPRINT_FACE_BYTES);
+    }
+    streamedUpdate.clear();
 
+    //--------------------------------------------------------------------------
+    // Colour overrides go with the materials of dropped meshes
+    for (const RepoStreamedMesh &mesh : geometryStreamer.evict())
+    {
+        for (const auto &pair : mesh.matMap)
+        {
+            changedMats.erase(pair.second);
+            overriddenMats.erase(pair.second);
+            matMap.erase(pair.first);
+            if (currentlyHighLighted == pair.first)
+                currentlyHighLighted = "";
         }
-        break;
-        case repo::core::model::NodeType::TRANSFORMATION:
+        for (const auto &pair : mesh.meshMap)
+            meshMap.erase(pair.first);
+        if (mesh.occurrence)
         {
-            auto transPtr = dynamic_cast<const repo::core::model::TransformationNode*>(node);
-            auto newTrans = matMult(matrix, transPtr->getTransMatrix(false));
-            auto children = scene->getChildrenAsNodes(gType, transPtr->getSharedID());
-            for(const auto &child : children)
-            {
-                createMeshBBoxes(scene, gType, child, newTrans, mat);
-            }
-
+            root->removeChild(mesh.occurrence);
+            delete mesh.occurrence;
         }
-        break;
     }
 
+    glcWorld.collection()->setLodUsage(true, &glcViewport);
+    glcWorld.collection()->setVboUsage(true);
+    GLC_SpacePartitioning* spacePartitioning = glcWorld.collection()->spacePartitioningHandle();
+    if (spacePartitioning)
+        spacePartitioning->updateSpacePartitioning();
+    glcWorld.collection()->updateSpacePartitionning();
+    visibilityIndex.reset(glcWorld, meshMap);
 
+    // Recollected from the merged instances right after this call
+    occludersPending = true;
 
+    modelFootprint = geometryStreamer.getResidentBytes();
+    markGeometryDirty();
 }
 
-void GLCRenderer::toggleMeshBoundingBoxes(
-                     const repo::core::model::RepoScene *scene)
+void GLCRenderer::clearStreamedGeometry()
 {
-    if (glcViewCollection.isEmpty())
-    {
-        if(scene)
-        {
-            GLC_Material* meshBboxMat = new GLC_Material(Qt::cyan);
-            meshBboxMat->setOpacity(0.1);
-
-            std::vector<float> identity = {
-                                           1,0,0,0,
-                                           0,1,0,0,
-                                           0,0,1,0,
-                                           0,0,0,1
-                                          };
-
-            if(offset.size())
-            {
-                identity[3] += offset[0];
-                identity[7] += offset[1];
-                identity[11] += offset[2];
-            }
-
-            auto gType = scene->getViewGraph();
-            createMeshBBoxes(scene, gType, scene->getRoot(gType), identity, meshBboxMat);
-        }
-
-    }
-    else
-    {
-        glcViewCollection.clear();
-    }
-
+    ++streamGeneration;
+    streamPending = false;
+    for (const RepoStreamedMesh &mesh : streamedUpdate)
+        delete mesh.occurrence;
+    streamedUpdate.clear();
+    // Attached meshes go with the world
+    geometryStreamer.clear();
 }
 
+void GLCRenderer::cycleMeshBoundingBoxLevel()
+{
+    // -1 (all levels), 0, 1, ..., n-1, -1, ...
+    const int level = meshBBoxOverlay.getLevel() + 1;
+    meshBBoxOverlay.setLevel(level < meshBBoxOverlay.getLevelCount() ? level : -1);
+}
 
 void GLCRenderer::toggleOctree()
 {
@@ -1275,6 +2244,43 @@ void GLCRenderer::toggleOctree()
         glcViewCollection.clear();
 }
 
+void GLCRenderer::toggleOcclusionCulling()
+{
+    occlusionCuller.setEnabled(!occlusionCuller.isEnabled());
+    if (!occlusionCuller.isEnabled())
+        occlusionCuller.restore();
+    markVisibilityDirty();
+}
+
+bool GLCRenderer::updateDirtyState()
+{
+    const GLC_Camera *camera = glcViewport.cameraHandle();
+    const GLC_Matrix4x4 modelView = camera->modelViewMatrix();
+    const QSize viewportSize = glcViewport.size();
+    const bool ortho = glcViewport.useOrtho();
+    const double viewAngle = glcViewport.viewAngle();
+
+    if (!cameraDirty)
+    {
+        const double *current = modelView.getData();
+        const double *cached = cachedModelView.getData();
+        cameraDirty = !std::equal(current, current + 16, cached) ||
+                viewportSize != cachedViewportSize ||
+                ortho != cachedOrtho ||
+                viewAngle != cachedViewAngle;
+    }
+
+    if (cameraDirty)
+    {
+        cachedModelView = modelView;
+        cachedViewportSize = viewportSize;
+        cachedOrtho = ortho;
+        cachedViewAngle = viewAngle;
+    }
+
+    return cameraDirty || visibilityDirty || geometryDirty;
+}
+
 void GLCRenderer::toggleProjection()
 {
     glcViewport.setToOrtho(!glcViewport.useOrtho());
@@ -1287,6 +2293,9 @@ void GLCRenderer::toggleSelectAll()
         glcWorld.unselectAll();
     else
         glcWorld.selectAllWith3DViewInstanceInCurrentShowState();
+
+    // Selected instances move out of the main render queue
+    markVisibilityDirty();
 }
 
 void GLCRenderer::toggleWireframe()
@@ -1298,10 +2307,11 @@ void GLCRenderer::toggleWireframe()
 void GLCRenderer::updateClippingPlane()
 {
     GLC_CuttingPlane* cuttingPlane= dynamic_cast<GLC_CuttingPlane*>(sender());
-    if (cuttingPlane)
+    if (cuttingPlane && clippingPlane)
     {
         double reverse = clippingPlaneReverse ? -1.0 : 1.0;
         clippingPlane->setPlane(reverse * cuttingPlane->normal(), cuttingPlane->center());
+        markVisibilityDirty();
     }
 }
 
@@ -1313,30 +2323,86 @@ void GLCRenderer::setClippingPlaneVisibility(bool on)
 
     if (on)
     {
-        clippingPlane = new GLC_Plane();
-        glcViewport.addClipPlane(GL_CLIP_PLANE0, clippingPlane);
+        if (!clippingPlane)
+        {
+            // Both use the first clip plane
+            setSectionBoxVisibility(false);
+            clippingPlane = new GLC_Plane();
+            glcViewport.addClipPlane(GL_CLIP_PLANE0, clippingPlane);
+        }
+    }
+    else
+    {
+        if (clippingPlane)
+        {
+            // Deleted by the viewport
+            glcViewport.removeClipPlane(GL_CLIP_PLANE0);
+            clippingPlane = nullptr;
+        }
+        for (auto w : clippingPlaneWidgets)
+        {
+            if (w)
+                w->setVisible(false);
+        }
+    }
+    markVisibilityDirty();
+}
+
+void GLCRenderer::setSectionBoxVisibility(bool on)
+{
+    if (on == (sectionPlanes[0] != nullptr))
+        return;
 
-        if (!clippingPlaneWidgets[0] && !clippingPlaneWidgets[1] && !clippingPlaneWidgets[2])
+    if (on)
+    {
+        setClippingPlaneVisibility(false);
+        for (size_t i = 0; i < sectionPlanes.size(); ++i)
         {
-            GLC_BoundingBox bbox = glcWorld.boundingBox();
-            double margin = 0.2 * std::max<double>(std::max<double>(bbox.xLength(), bbox.yLength()), bbox.zLength());
-            double x = bbox.xLength() + margin;
-            double y = bbox.yLength() + margin;
-            double z = bbox.zLength() + margin;
-            clippingPlaneWidgets[(int)Axis::X] = createCuttingPlane(bbox.center(), GLC_Vector3d(-glc::X_AXIS), z, y);
-            clippingPlaneWidgets[(int)Axis::Y] = createCuttingPlane(bbox.center(), GLC_Vector3d(-glc::Y_AXIS), x, z);
-            clippingPlaneWidgets[(int)Axis::Z] = createCuttingPlane(bbox.center(), GLC_Vector3d(-glc::Z_AXIS), x, y);
+            sectionPlanes[i] = new GLC_Plane();
+            glcViewport.addClipPlane(GL_CLIP_PLANE0 + (GLenum) i, sectionPlanes[i]);
         }
+        setSectionBox({0.0, 0.0, 0.0}, {1.0, 1.0, 1.0});
     }
     else
     {
-          glcViewport.removeClipPlane(GL_CLIP_PLANE0);
-          for (auto w : clippingPlaneWidgets)
-          {
-              if (w)
-                  w->setVisible(false);
-          }
+        for (size_t i = 0; i < sectionPlanes.size(); ++i)
+        {
+            glcViewport.removeClipPlane(GL_CLIP_PLANE0 + (GLenum) i);
+            sectionPlanes[i] = nullptr;
+        }
+    }
+    markVisibilityDirty();
+}
+
+void GLCRenderer::setSectionBox(
+        const std::vector<double> &lower,
+        const std::vector<double> &upper)
+{
+    if (lower.size() < 3 || upper.size() < 3)
+    {
+        repoLogError("Section box needs lower and upper fractions for x, y and z");
+        return;
+    }
+    setSectionBoxVisibility(true);
+
+    //--------------------------------------------------------------------------
+    // Two opposite planes per axis, facing inwards
+    const GLC_BoundingBox bbox = glcWorld.boundingBox();
+    const GLC_Point3d &l = bbox.lowerCorner();
+    const double origin[3] = {l.x(), l.y(), l.z()};
+    const double length[3] = {bbox.xLength(), bbox.yLength(), bbox.zLength()};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        GLC_Vector3d normal(axis == 0 ? 1.0 : 0.0, axis == 1 ? 1.0 : 0.0, axis == 2 ? 1.0 : 0.0);
+        double point[3] = {origin[0], origin[1], origin[2]};
+
+        point[axis] = origin[axis] + length[axis] * std::min(lower[axis], upper[axis]);
+        sectionPlanes[2 * axis]->setPlane(normal, GLC_Point3d(point[0], point[1], point[2]));
+
+        point[axis] = origin[axis] + length[axis] * std::max(lower[axis], upper[axis]);
+        sectionPlanes[2 * axis + 1]->setPlane(-normal, GLC_Point3d(point[0], point[1], point[2]));
     }
+    markVisibilityDirty();
 }
 
 GLC_CuttingPlane* GLCRenderer::createCuttingPlane(const GLC_Point3d &centroid, const GLC_Point3d &normal, double l1, double l2)
@@ -1349,6 +2415,30 @@ GLC_CuttingPlane* GLCRenderer::createCuttingPlane(const GLC_Point3d &centroid, c
     return cuttingPlane;
 }
 
+void GLCRenderer::getCuttingPlaneSize(Axis axis, double &l1, double &l2) const
+{
+    GLC_BoundingBox bbox = glcWorld.boundingBox();
+    double margin = 0.2 * std::max<double>(std::max<double>(bbox.xLength(), bbox.yLength()), bbox.zLength());
+    double x = bbox.xLength() + margin;
+    double y = bbox.yLength() + margin;
+    double z = bbox.zLength() + margin;
+    switch (axis)
+    {
+    case Axis::X:
+        l1 = z;
+        l2 = y;
+        break;
+    case Axis::Y:
+        l1 = x;
+        l2 = z;
+        break;
+    case Axis::Z:
+    default:
+        l1 = x;
+        l2 = y;
+    }
+}
+
 void GLCRenderer::updateClippingPlane(Axis axis, double value, bool reverse)
 {    
     clippingPlaneReverse = reverse;
@@ -1366,6 +2456,7 @@ void GLCRenderer::updateClippingPlane(Axis axis, double value, bool reverse)
     // Calculate clipping plane position
     GLC_BoundingBox bbox = glcWorld.boundingBox();
     GLC_Point3d centroid = bbox.center();
+    GLC_Vector3d normal;
 
     double pos;
     switch (axis)
@@ -1373,35 +2464,37 @@ void GLCRenderer::updateClippingPlane(Axis axis, double value, bool reverse)
     case Axis::X:
         pos = centroid.x() - bbox.xLength()/2 + (bbox.xLength() * (value));
         centroid.setX(pos);
+        normal = -glc::X_AXIS;
         break;
     case Axis::Y:
         pos = centroid.y() - bbox.yLength()/2 + (bbox.yLength() * (value));
         centroid.setY(pos);
+        normal = -glc::Y_AXIS;
         break;
     case Axis::Z:
         pos = centroid.z() - bbox.zLength()/2 + (bbox.zLength() * (value));
         centroid.setZ(pos);
+        normal = -glc::Z_AXIS;
         break;
     }
 
     //--------------------------------------------------------------------------
-    // Update position of the clipping plane widget and make sure it is set visible
+    // Place the plane directly, the widget only shows where it is
+    clippingPlane->setPlane((reverse ? -1.0 : 1.0) * normal, centroid);
+    markVisibilityDirty();
+
+    //--------------------------------------------------------------------------
+    // Widgets cannot be moved to an absolute position in one step, so the
+    // widget of the axis is recreated at the new position instead
     if (clippingPlaneWidgets.size() > (int) axis)
     {
-        GLC_CuttingPlane* clippingPlaneWidget = clippingPlaneWidgets[(int) axis];
-        // The move action does not get to the desired position on the first shot
-        // therefore iterate multiple times until reached. Stop at some fixed
-        // large number just in case to prevent accidental infinite looping.
-        int i = 0;
-        glc::WidgetEventFlag result;
-        clippingPlaneWidget->select(clippingPlaneWidget->center(), clippingPlaneWidget->id());
-        do {
-
-            result = clippingPlaneWidget->move(centroid, clippingPlaneWidget->id());
-            ++i;
-        }
-        while (clippingPlaneWidget->center() != centroid && i < 1000);
+        GLC_CuttingPlane *&clippingPlaneWidget = clippingPlaneWidgets[(int) axis];
+        if (clippingPlaneWidget)
+            glc3DWidgetManager.remove3DWidget(clippingPlaneWidget->id());
 
+        double l1, l2;
+        getCuttingPlaneSize(axis, l1, l2);
+        clippingPlaneWidget = createCuttingPlane(centroid, normal, l1, l2);
         clippingPlaneWidget->setVisible(true);
     }
 }
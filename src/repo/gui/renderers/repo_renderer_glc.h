@@ -19,6 +19,16 @@
 #pragma once
 
 #include "repo_renderer_abstract.h"
+#include "repo_occlusion_culler.h"
+#include "repo_frame_governor.h"
+#include "repo_render_queue.h"
+#include "repo_line_overlay.h"
+#include "repo_geometry_registry.h"
+#include "repo_point_cloud.h"
+#include "repo_geometry_streamer.h"
+#include "repo_visibility_index.h"
+#include "repo_mesh_batch.h"
+#include "../../workers/repo_worker_abstract.h"
 //------------------------------------------------------------------------------
 #ifdef __APPLE_CC__
 #include <OpenGL/OpenGL.h>
@@ -65,6 +75,12 @@ namespace repo {
                  */
                 std::vector<QString> applyFalseColoringMaterials();
 
+                /**
+                 * Numbers the materials of the loaded model into idTable,
+                 * once per load so that IDs are the same in every capture.
+                 */
+                void assignIds();
+
 				/**
 				* Recursively extracts meshes from a given occurrence. 
 				* Call with a root node.
@@ -102,6 +118,16 @@ namespace repo {
                 virtual QImage getCurrentImageWithFalseColoring(
                         std::vector<QString> &idMap, int w = 0, int h = 0);
 
+                //! See AbstractRenderer::requestIdBuffers()
+                std::vector<QString> requestIdBuffers(
+                        const std::vector<CameraSettings> &cameras,
+                        int w, int h,
+                        RepoPixelReadback &readback,
+                        const std::function<void(size_t, const QImage &)> &callback);
+
+                //! See AbstractRenderer::getSurroundingCameras()
+                std::vector<CameraSettings> getSurroundingCameras();
+
 				/**
 				* Increase velocity
 				* @param vel velocity delta
@@ -151,6 +177,15 @@ namespace repo {
                         const qreal &opacity,
                         const QColor &color);
 
+                /**
+                 * Hides or shows the meshes, touching only the instances
+                 * that draw them. Hidden meshes stay hidden when streamed
+                 * in or when released geometry is restored.
+                 */
+                virtual void setMeshVisibility(
+                        const std::vector<repoUUID> &uniqueIDs,
+                        bool visible);
+
 				/**
 				* Start navigate around the model
 				* @param mode which navigation mode
@@ -187,14 +222,22 @@ namespace repo {
 				* @param height new height
 				*/
 				virtual void resizeWindow(const int &width, const int &height);
+
+                //! See AbstractRenderer::setTile()
+                void setTile(int imageWidth, int imageHeight, const QRect &tile);
+
+                //! See AbstractRenderer::setSubPixelOffset()
+                void setSubPixelOffset(double dx, double dy);
 				
 				/**
 				* Select a component given a position. This will highlight the component
+				* once the readback delivers the ID and the depth under the position
+				* @param readback readback to queue the reads on
 				* @param x position in x
 				* @param y position in y
 				* @param multiSelection if multiple objects should be highlighted
 				*/
-                virtual void selectComponent(QOpenGLContext *context, int x, int y, bool multiSelection);
+                virtual void selectComponent(RepoPixelReadback &readback, int x, int y, bool multiSelection);
 
 
 				/**
@@ -211,6 +254,10 @@ namespace repo {
                 virtual void setAndInitSelectionShaders(QFile &vertexFile,
                     QFile &fragmentFile, QOpenGLContext *context);
 
+                //! See AbstractRenderer::setAndInitIdShaders()
+                virtual void setAndInitIdShaders(QFile &vertexFile,
+                    QFile &fragmentFile, QOpenGLContext *context);
+
                 /**
                  * Appends and compiles given vertex and fragments shaders which can then
                  * be selected based on their assigned number in the shaders list.
@@ -261,25 +308,91 @@ namespace repo {
                                  std::map<QString, GLC_Mesh*>     &_meshMap,
                                  std::map<QString, GLC_Material*> &_matMap);
 
+                //! See AbstractRenderer::releaseModel()
+                bool releaseModel();
+
+                //! See AbstractRenderer::restoreModel()
+                void restoreModel(repo::core::model::RepoScene *scene = nullptr);
+
+                //! See AbstractRenderer::releaseScene()
+                bool releaseScene();
+
+                bool hasActiveWorkers() const { return activeWorkers > 0; }
+
+                bool isModelReleased() const { return modelReleased; }
+
+                //! Allows geometry to be streamed in if set so in the settings,
+                //! off for renderers that need the whole model at once.
+                void setStreamingAllowed(bool on) { streamingAllowed = on; }
+
+                //! Vertex and face data of the world, split between windows sharing it.
+                qint64 getModelFootprint() const;
+
+                /**
+                * Registers a freshly converted world with the geometry registry,
+                * possibly swapping it for one another window registered first,
+                * and renders it.
+                */
+                void setConvertedGLCWorld(GLC_World &world,
+                                          std::map<QString, GLC_Mesh*>     &_meshMap,
+                                          std::map<QString, GLC_Material*> &_matMap);
+
 public slots :
 
                 /**
                 * Toggle between show/hide genericSpatialPartitioning
                 */
                 virtual void toggleGenericPartitioning(
-                        const std::vector<repo_vector_t> &sceneBbox,
-                        const std::shared_ptr<repo_partitioning_tree_t> &tree);
+                        repo::RepoController *controller,
+                        repo::core::model::RepoScene *scene);
+
+                /**
+                * Set the partitioning boxes computed by the worker
+                */
+                void setPartitioningBoxes(
+                        const repo::gui::renderer::RepoLineOverlayData &data);
 
                 /**
                 * Toggle between show/hide mesh bounding boxes
                 */
                 virtual void toggleMeshBoundingBoxes(
                                      const repo::core::model::RepoScene *scene);
+
+                /**
+                * Cycle the mesh bounding boxes through all levels and each
+                * single level of the scene graph
+                */
+                virtual void cycleMeshBoundingBoxLevel();
+
+                /**
+                * Set the mesh bounding boxes collected by the worker
+                */
+                void setMeshBoundingBoxes(
+                        const repo::gui::renderer::RepoLineOverlayData &data);
+
+                /**
+                * Set the point hierarchy sorted by the worker, mapped on
+                * the next frame as it needs the context
+                */
+                void setPointCloud(
+                        const repo::gui::renderer::RepoPointCloudData &data);
+
+                /**
+                * Set the streaming index built by the worker, rendering an
+                * empty world that is filled in as meshes come into view
+                */
+                void setStreamIndex(
+                        const repo::gui::renderer::RepoStreamIndex &index);
 				/**
 				* Toggle between show/hide octree
 				*/
 				virtual void toggleOctree();
 
+                /**
+                * Toggle CPU occlusion culling on/off
+                */
+                virtual void toggleOcclusionCulling();
+
 				/**
 				* Toggle between different projection modes
 				*/
@@ -301,6 +414,11 @@ public slots :
 
                 void setClippingPlaneVisibility(bool on);
 
+                void setSectionBox(const std::vector<double> &lower,
+                                   const std::vector<double> &upper);
+
+                void setSectionBoxVisibility(bool on);
+
 				/**
 				* Zoom/unzoom camera
 				* @param zoom zoom factor
@@ -315,18 +433,79 @@ public slots :
 
                 GLC_CuttingPlane * createCuttingPlane(const GLC_Point3d &centroid, const GLC_Point3d &normal, double l1, double l2);
 
-                void createMeshBBoxes(
-                        const repo::core::model::RepoScene            *scene,
-                        const repo::core::model::RepoScene::GraphType &gType,
-                        const repo::core::model::RepoNode             *node,
-                        const std::vector<float>                      &matrix,
-                         GLC_Material                            *mat);
+                /**
+                 * Detects camera and viewport changes since the last frame
+                 * and combines them with the explicitly raised dirty flags.
+                 * @return returns true if the depth of view and the viewable
+                 *         state of the instances need to be recalculated
+                 */
+                bool updateDirtyState();
+
+                //! Starts the worker on the global pool, counted until deleted.
+                void startWorker(repo::worker::RepoAbstractWorker *worker);
+
+                //! Applies quality settings of the current governor level.
+                void applyGovernorLevel();
+
+                /**
+                 * Culls instances entirely clipped away by the clipping plane
+                 * or section box, then the bodies of multi-body instances,
+                 * such as chunks of merged stash meshes, against the frustum
+                 * and clip planes on their own bounds. Instances with only
+                 * some bodies visible become partially viewable.
+                 */
+                void updateGeometryViewableState();
+
+                //! Narrows the projection to the current tile and shifts it
+                //! by the sub-pixel offset.
+                void applyTileProjection();
+
+                //! Returns the clip planes currently enabled in the viewport.
+                std::vector<const GLC_Plane*> getActiveClipPlanes() const;
+
+                //! Returns true if the box is on the clipped side of any plane.
+                static bool isClippedOut(const GLC_BoundingBox &bbox,
+                                         const std::vector<const GLC_Plane*> &planes);
 
-                void createSPBoxes(
-                        const std::shared_ptr<repo_partitioning_tree_t> &tree,
-                        const std::vector<std::vector<float>>   &currentBbox,
-                         GLC_Material                      *mat
-                        );
+                //! Returns the sizes of the cutting plane widget of the axis.
+                void getCuttingPlaneSize(Axis axis, double &l1, double &l2) const;
+
+                /**
+                 * Swaps this window's colour overrides into the materials,
+                 * which may be shared with other windows, for the frame.
+                 */
+                void applyMaterialOverrides();
+
+                //! Swaps the original materials back after rendering.
+                void restoreMaterialOverrides();
+
+                /**
+                 * Starts the conversion of the largest meshes in view that
+                 * are not resident, if any.
+                 */
+                void requestGeometry();
+
+                /**
+                 * Keeps the meshes converted by a stream worker until the
+                 * next frame, dropping them if the model changed meanwhile.
+                 */
+                void setStreamedGeometry(const RepoStreamedMeshes &meshes, int generation);
+
+                /**
+                 * Attaches the converted meshes to the world and detaches
+                 * the least recently seen ones beyond the memory budget.
+                 * Expects the context to be current.
+                 */
+                void applyStreamedGeometry();
+
+                //! Forgets streamed geometry, deleting meshes not yet attached.
+                void clearStreamedGeometry();
+
+                //! Flags the world as changed so that its bbox is recomputed.
+                void markGeometryDirty() { geometryDirty = true; }
+
+                //! Flags the viewable state of instances as out of date.
+                void markVisibilityDirty() { visibilityDirty = true; }
 
                 /**
                  * Change the colour of the material
@@ -337,6 +516,12 @@ public slots :
                         const QString &uuidString,
                         const GLC_Material &newMat);
 
+                //! Overrides the material while rendering, keeping the original.
+                void overrideMaterial(GLC_Material *mat, const GLC_Material &newMat);
+
+                //! Returns the batch the key is a member of, null if none.
+                RepoMeshBatch *findBatch(const QString &uuidString) const;
+
 				/**
 				* Given a pointer to GLC_Camera, convert it into a CameraSettings.
 				* @param cam GLC_Camera
@@ -361,6 +546,12 @@ public slots :
                 std::vector<QString> enableSelectionMode(
                         const bool useCurrentMaterials);
 
+                /**
+                 * Reads the bound framebuffer as non premultiplied RGBA,
+                 * keeping the ID bits in alpha exact.
+                 */
+                QImage readIdImage(int w, int h);
+
                 /**
                  * Retrieve a 2D Image at the current camera view
                  * with no lighting effects.
@@ -414,6 +605,11 @@ public slots :
 				std::map<QString, GLC_Mesh*> meshMap;
 				std::map<QString, GLC_Material*> matMap;
 				std::map<GLC_Material*, GLC_Material> changedMats; //Map the pointer of the GLC material that has been changed to the original
+                std::map<GLC_Material*, GLC_Material> overriddenMats; //Map the pointer of the GLC material that has been changed to its override
+                //! Batches with members split since the last frame.
+                std::set<RepoMeshBatch*> splitBatches;
+                //! Geometry registry key of the world, empty if not shared.
+                QString geometryKey;
 				glc::RenderFlag renderingFlag; //! Rendering flag.
 				bool isWireframe;
 
@@ -426,11 +622,119 @@ public slots :
 
                 bool clippingPlaneReverse;
 
+                //! Six planes of the section box, null while off.
+                std::vector<GLC_Plane*> sectionPlanes;
+
+                //! Number of instances culled by the clip planes.
+                int clippedInstances;
+
+                //! Tile of the offscreen image being drawn, null if not tiling.
+                QRect tile;
+
+                //! Viewport size to return to once tiling stops.
+                QSize untiledSize;
+
+                //! Offset of the image in pixels, for jittered passes.
+                QPointF subPixelOffset;
+
 				//! Globally applied shader ID.
 				GLuint shaderID;
 
+                //! Writes false colour IDs with their high bits, null without GLSL.
+                GLC_Shader *idShader;
+
+                //! Set while meshes carry false colour ID materials.
+                bool isIdColoring;
+
                 std::vector<double> offset;		
 
+                //! CPU occlusion culling pass, off by default.
+                RepoOcclusionCuller occlusionCuller;
+
+                //! Occluders are collected by the next frame, with the context current.
+                bool occludersPending;
+
+                //! Dirty state, depth of view and culling are only recalculated if set.
+                bool cameraDirty;
+                bool visibilityDirty;
+                bool geometryDirty;
+
+                //! Camera and viewport as of the last recalculation.
+                GLC_Matrix4x4 cachedModelView;
+                QSize cachedViewportSize;
+                bool cachedOrtho;
+                double cachedViewAngle;
+
+                //! Cached world bounding box, recomputed on geometry changes.
+                GLC_BoundingBox worldBoundingBox;
+
+                //! Number of frames that reused the cached state.
+                unsigned long long skippedUpdates;
+
+                //! Number of bodies outside the frustum in partially visible instances.
+                int culledBodies;
+
+                //! Trades quality for speed while navigating to hold the target frame rate.
+                RepoFrameGovernor frameGovernor;
+
+                //! Opaque instances sorted by texture, material and depth.
+                RepoRenderQueue renderQueue;
+
+                //! Transparent instances sorted back to front.
+                RepoRenderQueue transparentQueue;
+
+                //! Cached mesh bounding boxes, collected on a worker.
+                RepoLineOverlay meshBBoxOverlay;
+                bool meshBBoxVisible;
+                bool meshBBoxPending;
+
+                //! Cached spatial partitioning boxes, coloured by tree depth.
+                RepoLineOverlay partitionOverlay;
+                bool partitionVisible;
+                bool partitionPending;
+
+                //! Points of meshes without faces, drawn within a budget.
+                RepoPointCloud pointCloud;
+                RepoPointCloudData pointCloudUpdate;
+                bool pointCloudUpdated;
+                bool pointCloudPending;
+
+                //! Out-of-core geometry, converted as it comes into view.
+                RepoGeometryStreamer geometryStreamer;
+                RepoStreamedMeshes streamedUpdate;
+                bool streamPending;
+
+                //! Incremented per model so that late batches are dropped.
+                int streamGeneration;
+
+                bool streamingAllowed;
+
+                //! Meshes hidden by the user and the instances drawing them.
+                RepoVisibilityIndex visibilityIndex;
+
+                //! Scene and offset of the last load, to restore released geometry.
+                repo::core::model::RepoScene *loadedScene;
+                std::vector<double> loadedOffset;
+
+                //! Estimated size of the vertex and face data of the world.
+                qint64 modelFootprint;
+
+                //! True while the geometry is released.
+                bool modelReleased;
+
+                //! True while released geometry is being reloaded.
+                bool modelRestoring;
+
+                //! Workers started by this renderer that may still read the scene.
+                int activeWorkers;
+
+                //! Camera and colour overrides by mesh id at release time.
+                CameraSettings releasedCamera;
+                std::map<QString, GLC_Material> releasedOverrides;
+
+                //! Unique IDs of meshes by false colour ID, 0 is the background.
+                std::vector<QString> idTable;
+
 			}; // end class
 		} //end namespace renderer
 	} // end namespace gui
@@ -0,0 +1,90 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_shader_cache.h"
+
+//------------------------------------------------------------------------------
+#include <GLC_Exception>
+//------------------------------------------------------------------------------
+#include "../../logger/repo_logger.h"
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+RepoShaderCache::RepoShaderCache()
+    : compileCount(0)
+{}
+
+RepoShaderCache::~RepoShaderCache()
+{
+    // Remaining programs belong to contexts already gone at exit
+    entries.clear();
+}
+
+RepoShaderCache &RepoShaderCache::getInstance()
+{
+    // Static variable is created and destroyed only once.
+    static RepoShaderCache instance;
+    return instance;
+}
+
+GLC_Shader *RepoShaderCache::acquire(QFile &vertexFile, QFile &fragmentFile)
+{
+    const QString key = vertexFile.fileName() + "|" + fragmentFile.fileName();
+    auto it = entries.find(key);
+    if (it != entries.end())
+    {
+        ++it->second.useCount;
+        return it->second.shader;
+    }
+
+    GLC_Shader *shader = new GLC_Shader();
+    try
+    {
+        shader->setVertexAndFragmentShader(vertexFile, fragmentFile);
+        shader->createAndCompileProgrammShader();
+    }
+    catch (GLC_Exception &)
+    {
+        delete shader;
+        throw;
+    }
+    ++compileCount;
+    repoLog("Compiled shader program " + key.toStdString());
+
+    Entry &entry = entries[key];
+    entry.shader = shader;
+    entry.useCount = 1;
+    return shader;
+}
+
+void RepoShaderCache::release(GLC_Shader *shader)
+{
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+    {
+        if (it->second.shader == shader)
+        {
+            if (--it->second.useCount <= 0)
+            {
+                delete it->second.shader;
+                entries.erase(it);
+            }
+            return;
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <map>
+
+#include <QFile>
+#include <QString>
+
+#include <GLC_Shader>
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+/**
+ * Reference counted cache of compiled rendering shader programs.
+ *
+ * All contexts of the application share a group (Qt::AA_ShareOpenGLContexts)
+ * so a program linked in one window can be used by any other. Programs are
+ * keyed by their source files, compiled by the first window that asks for
+ * them and deleted with the last one. Only to be used from the GUI thread
+ * with a context of the shared group current.
+ */
+class RepoShaderCache
+{
+
+public:
+
+    static RepoShaderCache &getInstance();
+
+    /**
+     * Returns the program built from the given sources, compiling it only
+     * if not cached yet. Files are read only when compiling.
+     * @throw GLC_Exception if the program fails to compile
+     */
+    GLC_Shader *acquire(QFile &vertexFile, QFile &fragmentFile);
+
+    /**
+     * Releases one reference, deleting the program with the last one.
+     */
+    void release(GLC_Shader *shader);
+
+    //! Returns the number of cached programs.
+    int getSize() const { return (int) entries.size(); }
+
+    //! Returns the number of programs compiled since start up.
+    int getCompileCount() const { return compileCount; }
+
+private:
+
+    RepoShaderCache();
+
+    ~RepoShaderCache();
+
+    struct Entry
+    {
+        GLC_Shader *shader;
+        int useCount;
+    };
+
+    //! Programs by vertex and fragment file names.
+    std::map<QString, Entry> entries;
+
+    int compileCount;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
@@ -0,0 +1,180 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_visibility_index.h"
+
+//------------------------------------------------------------------------------
+#include <unordered_set>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::renderer;
+
+RepoVisibilityIndex::RepoVisibilityIndex()
+    : built(false)
+{}
+
+void RepoVisibilityIndex::clear()
+{
+    built = false;
+    keyGeometries.clear();
+    keyCounts.clear();
+    geometryInstances.clear();
+    hidden.clear();
+    hiddenCounts.clear();
+    hiddenBodies.clear();
+}
+
+void RepoVisibilityIndex::reset(
+        GLC_World &world,
+        const std::map<QString, GLC_Mesh*> &meshMap)
+{
+    built = false;
+    keyGeometries.clear();
+    keyCounts.clear();
+    geometryInstances.clear();
+    hiddenCounts.clear();
+    hiddenBodies.clear();
+    if (hidden.empty())
+        return;
+
+    build(world, meshMap);
+    std::unordered_set<GLC_3DViewInstance*> affected;
+    for (const auto &pair : hiddenCounts)
+    {
+        auto it = geometryInstances.find(pair.first);
+        if (it != geometryInstances.end())
+            for (const auto &placement : it->second)
+                affected.insert(placement.first);
+    }
+    for (GLC_3DViewInstance *instance : affected)
+        update(instance);
+}
+
+int RepoVisibilityIndex::setVisible(
+        GLC_World &world,
+        const std::map<QString, GLC_Mesh*> &meshMap,
+        const std::vector<QString> &keys,
+        bool visible)
+{
+    if (!built)
+        build(world, meshMap);
+
+    std::unordered_set<GLC_3DViewInstance*> affected;
+    for (const QString &key : keys)
+    {
+        const bool changed = visible ? hidden.erase(key) > 0 : hidden.insert(key).second;
+        auto it = keyGeometries.find(key);
+        if (!changed || it == keyGeometries.end())
+            continue;
+
+        // Only geometries whose last shown mesh changed need their instances
+        for (const GLC_Geometry *geometry : it->second)
+        {
+            const bool wasHidden = isHidden(geometry);
+            hiddenCounts[geometry] += visible ? -1 : 1;
+            if (isHidden(geometry) != wasHidden)
+                for (const auto &placement : geometryInstances[geometry])
+                    affected.insert(placement.first);
+        }
+    }
+
+    for (GLC_3DViewInstance *instance : affected)
+        update(instance);
+    return (int) affected.size();
+}
+
+const std::vector<bool> *RepoVisibilityIndex::getHiddenBodies(
+        const GLC_3DViewInstance *instance) const
+{
+    auto it = hiddenBodies.find(instance);
+    return it != hiddenBodies.end() ? &it->second : nullptr;
+}
+
+void RepoVisibilityIndex::build(
+        GLC_World &world,
+        const std::map<QString, GLC_Mesh*> &meshMap)
+{
+    //--------------------------------------------------------------------------
+    // Batched meshes are keyed by their members rather than their name
+    std::unordered_set<const GLC_Geometry*> batched;
+    for (const auto &pair : meshMap)
+    {
+        if (pair.second && pair.second->name() != pair.first)
+        {
+            keyGeometries[pair.first].push_back(pair.second);
+            ++keyCounts[pair.second];
+            batched.insert(pair.second);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    // Bodies are named after their mesh, shared between placements
+    for (GLC_3DViewInstance *instance : world.collection()->instancesHandle())
+    {
+        for (int i = 0; i < instance->numberOfGeometry(); ++i)
+        {
+            const GLC_Geometry *geometry = instance->geomAt(i);
+            auto &placements = geometryInstances[geometry];
+            if (placements.empty() && !batched.count(geometry))
+            {
+                keyGeometries[geometry->name()].push_back(geometry);
+                ++keyCounts[geometry];
+            }
+            placements.push_back(std::make_pair(instance, i));
+        }
+    }
+
+    for (const QString &key : hidden)
+    {
+        auto it = keyGeometries.find(key);
+        if (it != keyGeometries.end())
+            for (const GLC_Geometry *geometry : it->second)
+                ++hiddenCounts[geometry];
+    }
+    built = true;
+}
+
+bool RepoVisibilityIndex::isHidden(const GLC_Geometry *geometry) const
+{
+    auto count = keyCounts.find(geometry);
+    auto hiddenCount = hiddenCounts.find(geometry);
+    return count != keyCounts.end() && hiddenCount != hiddenCounts.end() &&
+            hiddenCount->second >= count->second;
+}
+
+void RepoVisibilityIndex::update(GLC_3DViewInstance *instance)
+{
+    const int count = instance->numberOfGeometry();
+    if (!count)
+        return;
+
+    std::vector<bool> mask(count);
+    int hiddenCount = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        mask[i] = isHidden(instance->geomAt(i));
+        if (mask[i])
+            ++hiddenCount;
+    }
+
+    instance->setVisibility(hiddenCount < count);
+    if (hiddenCount && hiddenCount < count)
+        hiddenBodies[instance] = mask;
+    else
+        hiddenBodies.erase(instance);
+}
@@ -0,0 +1,119 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <QString>
+
+#include <GLC_World>
+#include <GLC_3DViewInstance>
+#include "geometry/glc_mesh.h"
+
+namespace repo {
+namespace gui {
+namespace renderer {
+
+/**
+ * Hidden meshes of a world by their mesh map keys.
+ *
+ * Bodies are indexed once by the meshes they draw and the instances they
+ * are placed in, so that hiding or showing a whole subtree only touches
+ * the instances of its meshes. Instances with all bodies hidden are made
+ * invisible, which GLC and the render queues skip without changes to the
+ * space partitioning. Instances with only some bodies hidden keep a mask
+ * that is applied with the frustum state of their bodies. Small meshes
+ * merged into one batch are hidden once all of them are.
+ *
+ * Each renderer keeps an index of its own. Windows sharing geometry through
+ * RepoGeometryRegistry get their own instances, so they hide independently.
+ */
+class RepoVisibilityIndex
+{
+
+public:
+
+    RepoVisibilityIndex();
+
+    //! Forgets the hidden meshes and the indexed world, e.g. for a new model.
+    void clear();
+
+    /**
+     * Forgets the indexed world, e.g. once instances were added or deleted,
+     * and applies the hidden meshes to the current one if there are any.
+     * @param meshMap mesh map of the world including batched meshes
+     */
+    void reset(GLC_World &world, const std::map<QString, GLC_Mesh*> &meshMap);
+
+    /**
+     * Hides or shows the meshes of the given keys. Meshes not in the world
+     * yet are hidden once it is reset with them.
+     * @return returns the number of instances changed
+     */
+    int setVisible(GLC_World &world,
+                   const std::map<QString, GLC_Mesh*> &meshMap,
+                   const std::vector<QString> &keys,
+                   bool visible);
+
+    //! Returns the hidden bodies of the instance, null if none or all.
+    const std::vector<bool> *getHiddenBodies(const GLC_3DViewInstance *instance) const;
+
+    bool hasHiddenBodies() const { return !hiddenBodies.empty(); }
+
+    int getHiddenCount() const { return (int) hidden.size(); }
+
+protected:
+
+    //! Indexes the bodies of all instances of the world.
+    void build(GLC_World &world, const std::map<QString, GLC_Mesh*> &meshMap);
+
+    //! Returns true if all meshes drawn by the geometry are hidden.
+    bool isHidden(const GLC_Geometry *geometry) const;
+
+    //! Updates the visibility and the body mask of the instance.
+    void update(GLC_3DViewInstance *instance);
+
+    bool built;
+
+    //! Geometries drawing each mesh, several for split meshes.
+    std::map<QString, std::vector<const GLC_Geometry*>> keyGeometries;
+
+    //! Number of meshes drawn by each geometry, more than one for batches.
+    std::unordered_map<const GLC_Geometry*, int> keyCounts;
+
+    //! Instances and body positions of each geometry.
+    std::unordered_map<const GLC_Geometry*,
+            std::vector<std::pair<GLC_3DViewInstance*, int>>> geometryInstances;
+
+    std::set<QString> hidden;
+
+    //! Number of hidden meshes drawn by each geometry.
+    std::unordered_map<const GLC_Geometry*, int> hiddenCounts;
+
+    std::unordered_map<const GLC_3DViewInstance*, std::vector<bool>> hiddenBodies;
+
+}; // end class
+
+} // end namespace renderer
+} // end namespace gui
+} // end namespace repo
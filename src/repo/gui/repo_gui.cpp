@@ -17,6 +17,7 @@
 
 //------------------------------------------------------------------------------
 // Qt
+#include <QImageWriter>
 #include <QMessageBox>
 #include <QtSvg>
 
@@ -50,6 +51,7 @@
 //------------------------------------------------------------------------------
 #include "dialogs/repo_dialog_manager_access.h"
 #include "dialogs/repo_dialog_manager_connect.h"
+#include "renderers/repo_image_stream_writer.h"
 //------------------------------------------------------------------------------
 
 using namespace repo::gui::widget;
@@ -467,7 +469,7 @@ void repo::gui::RepoGUI::commit()
     QString project = ui->widgetRepository->getSelectedProject();
     
     repo::core::model::RepoScene *repoScene = nullptr;
-    if (activeWindow && widget)
+    if (activeWindow && widget && widget->getRepoScene())
     {
         repoScene = widget->getRepoScene();
         
@@ -514,6 +516,7 @@ void repo::gui::RepoGUI::commit(
                 QObject::connect(worker, SIGNAL(progress(int, int)), activeWindow, SLOT(progress(int, int)));
 
             QObject::connect(worker, SIGNAL(finished()), this, SLOT(refresh()));
+            ui->mdiArea->holdScene(scene, worker);
             //connect(worker, SIGNAL(error(QString)), this, SLOT(errorString(QString)));
 
             //----------------------------------------------------------------------
@@ -528,6 +531,7 @@ void repo::gui::RepoGUI::connectDB()
 {
     // Disconnect previous connection if any
     // TODO: remove when expanding to multiple connections
+    ui->mdiArea->forgetConnection(ui->widgetRepository->getSelectedConnection());
     ui->widgetRepository->disconnectDB();
 
     dialog::ConnectManagerDialog connectManager(controller, (QWidget*)this);
@@ -601,6 +605,7 @@ QMenu* repo::gui::RepoGUI::createPanelsMenu()
 
 void repo::gui::RepoGUI::disconnectDB()
 {
+    ui->mdiArea->forgetConnection(ui->widgetRepository->getSelectedConnection());
     if (ui->widgetRepository->disconnectDB())
     {
         // disable buttons
@@ -764,6 +769,8 @@ void repo::gui::RepoGUI::openMetadataManager()
                     "*.csv");
 
         repo::core::model::RepoScene *scene = widget->getRepoScene();
+        if (!scene)
+            return;
         repo::core::model::RepoNodeSet nodeSet = controller->loadMetadataFromFile(filePath.toStdString());
 
         scene->addMetadata(nodeSet, false);
@@ -779,8 +786,11 @@ void repo::gui::RepoGUI::optimizeGraph()
     {
         widget::RepoMdiSubWindow *activeWindow = ui->mdiArea->activeSubWindow();
         repo::core::model::RepoScene* scene = widget->getRepoScene();
+        if (!scene)
+            return;
         repo::worker::OptimizeWorker *worker =
                 new repo::worker::OptimizeWorker(controller, ui->widgetRepository->getSelectedConnection(), scene);
+        ui->mdiArea->holdScene(scene, worker);
 
         if (activeWindow)
         {
@@ -866,12 +876,18 @@ void repo::gui::RepoGUI::saveAs()
                     QString(QDir::separator()) + widget->windowTitle(),
                     tr(controller->getSupportedExportFormats().c_str()));
         const repo::core::model::RepoScene *repoScene = widget->getRepoScene();
+        if (!repoScene)
+        {
+            repoLog("Failed to export model: the scene is still loading.");
+            return;
+        }
 
         //Instantiate worker
         repo::worker::FileExportWorker *worker = new repo::worker::FileExportWorker(
                     path.toStdString(),
                     controller,
                     repoScene);
+        ui->mdiArea->holdScene(repoScene, worker);
 
         QObject::connect(worker, SIGNAL(progress(int, int)), widget, SLOT(progress(int, int)));
 
@@ -903,7 +919,17 @@ void repo::gui::RepoGUI::saveScreenshot()
                     this,
                     tr("Choose a file to save"),
                     QString(QDir::separator()) + widget->windowTitle(),
-                    tr("Image Files (*.bmp *.gif *.jpg *.jpeg *.png *.pbm *.pgm *.ppm *.tiff *.xbm *.xpm)"));
+                    tr("Image Files (*.tif *.tiff *.bmp *.gif *.jpg *.jpeg *.png *.pbm *.pgm *.ppm *.xbm *.xpm)"));
+        if (path.isEmpty())
+            return;
+        // Large images only fit in a TIFF, others are checked per window
+        const QByteArray suffix = QFileInfo(path).suffix().toLower().toLatin1();
+        if (!repo::gui::renderer::RepoImageStreamWriter::isSupported(path) &&
+                !QImageWriter::supportedImageFormats().contains(suffix))
+        {
+            repoLogError(tr("Unsupported image format: %1").arg(path).toStdString());
+            return;
+        }
 
         QFileInfo fileInfo(path);
         for (int i = 0; i < widgets.size(); ++i)
@@ -916,10 +942,8 @@ void repo::gui::RepoGUI::saveScreenshot()
                     newPath += "." + fileInfo.completeSuffix();
 
                 repoLog(tr("Exporting image to ").toStdString() + newPath.toStdString());
-                // See https://bugreports.qt-project.org/browse/QTBUG-33186
-                //QPixmap pixmap = widget->renderPixmap(3840, 2160);
-                QImage image = widget->renderQImage(13440,7560); // HD x 7 res
-                if (!image.save(newPath, 0, 100)) // 100% quality
+                // Tiled so that any resolution renders, TIFF keeps memory flat
+                if (!widget->renderTiledImage(newPath, 13440, 7560)) // HD x 7 res
                     repoLogError(tr("Export failed.").toStdString());
             }
         }
@@ -0,0 +1,68 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_linked_camera.h"
+#include "repo_widget_rendering.h"
+//------------------------------------------------------------------------------
+#include <algorithm>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::widget;
+
+RepoLinkedCamera::RepoLinkedCamera(QObject *parent)
+    : QObject(parent)
+    , camera()
+    , version(0)
+    , source(nullptr)
+{}
+
+RepoLinkedCamera::~RepoLinkedCamera() {}
+
+void RepoLinkedCamera::subscribe(Rendering3DWidget *widget)
+{
+    if (std::find(widgets.begin(), widgets.end(), widget) == widgets.end())
+        widgets.push_back(widget);
+}
+
+void RepoLinkedCamera::unsubscribe(Rendering3DWidget *widget)
+{
+    widgets.erase(std::remove(widgets.begin(), widgets.end(), widget), widgets.end());
+    if (source == widget)
+        source = nullptr;
+}
+
+void RepoLinkedCamera::publish(
+        const renderer::CameraSettings &camera,
+        const Rendering3DWidget *source)
+{
+    this->camera = camera;
+    this->source = source;
+    ++version;
+
+    // Qt merges pending update requests into a single repaint
+    for (Rendering3DWidget *widget : widgets)
+        if (widget != source)
+            widget->update();
+}
+
+void RepoLinkedCamera::forwardKey(QKeyEvent *e, const Rendering3DWidget *source)
+{
+    for (Rendering3DWidget *widget : widgets)
+        if (widget != source)
+            widget->receiveLinkedKey(e);
+}
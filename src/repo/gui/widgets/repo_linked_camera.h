@@ -0,0 +1,96 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+//------------------------------------------------------------------------------
+#include <vector>
+//------------------------------------------------------------------------------
+#include <QObject>
+#include <QKeyEvent>
+//------------------------------------------------------------------------------
+#include "../renderers/repo_renderer_abstract.h"
+//------------------------------------------------------------------------------
+
+namespace repo {
+namespace gui {
+namespace widget {
+
+class Rendering3DWidget;
+
+/**
+ * Single camera shared by linked 3D windows.
+ *
+ * Windows publish their camera when it moves and get a repaint request
+ * when another window did. The camera is only read when a window paints,
+ * so however many moves happen in between, each window applies at most one
+ * per displayed frame, and applying it does not publish it back. Linking N
+ * windows takes N subscriptions instead of N² signal connections.
+ */
+class RepoLinkedCamera : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    RepoLinkedCamera(QObject *parent = 0);
+
+    ~RepoLinkedCamera();
+
+    //! Adds the widget to the linked windows, does nothing if already linked.
+    void subscribe(Rendering3DWidget *widget);
+
+    void unsubscribe(Rendering3DWidget *widget);
+
+    /**
+     * Sets the shared camera and requests a repaint of all other windows.
+     * @param camera new camera
+     * @param source window the camera comes from
+     */
+    void publish(const renderer::CameraSettings &camera,
+                 const Rendering3DWidget *source);
+
+    /**
+     * Passes a key press of the source on to all other windows.
+     */
+    void forwardKey(QKeyEvent *e, const Rendering3DWidget *source);
+
+    const renderer::CameraSettings &getCamera() const { return camera; }
+
+    //! Returns a number incremented on each publish.
+    unsigned long long getVersion() const { return version; }
+
+    const Rendering3DWidget *getSource() const { return source; }
+
+    int getSize() const { return (int) widgets.size(); }
+
+protected:
+
+    std::vector<Rendering3DWidget*> widgets;
+
+    renderer::CameraSettings camera;
+
+    unsigned long long version;
+
+    const Rendering3DWidget *source;
+
+}; // end class
+
+} // end namespace widget
+} // end namespace gui
+} // end namespace repo
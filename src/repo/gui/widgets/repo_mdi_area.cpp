@@ -27,6 +27,7 @@ using namespace repo::gui::widget;
 RepoMdiArea::RepoMdiArea(QWidget * parent)
 	: QMdiArea(parent)
     , logo(":/images/3drepo-bg.png")
+    , memoryBudget(this)
 {
 
 
@@ -64,6 +65,10 @@ RepoMdiArea::RepoMdiArea(QWidget * parent)
 RepoMdiArea::~RepoMdiArea()
 {
     fpsTimer.stop();
+
+    // The camera goes before ~QWidget deletes the sub-windows
+    for (widget::Rendering3DWidget *widget : getWidgets<widget::Rendering3DWidget*>())
+        widget->setLinkedCamera(nullptr);
 }
 
 //------------------------------------------------------------------------------
@@ -74,20 +79,14 @@ RepoMdiArea::~RepoMdiArea()
 
 void RepoMdiArea::chainSubWindows(bool checked)
 {
-    std::vector<widget::Rendering3DWidget *> visited;
-    std::vector<widget::Rendering3DWidget*>::size_type i, j;
-    std::vector<widget::Rendering3DWidget*> widgets = getWidgets<widget::Rendering3DWidget*>();
-    for (j = 0; j < widgets.size(); ++j)
-    {
-        widget::Rendering3DWidget * widget = widgets[j];
-        // dis/connect hooks to all previous windows
-		for(i = 0; i != visited.size(); ++i)
-		{
-			widget->linkCameras(visited.at(i), checked);
-            visited.at(i)->linkCameras(widget, checked);
-		}
-		visited.push_back(widget); // store current window
-	}
+    // Windows subscribe to a single camera instead of hooking to each other
+    for (widget::Rendering3DWidget *widget : getWidgets<widget::Rendering3DWidget*>())
+        widget->setLinkedCamera(checked ? &linkedCamera : nullptr);
+
+    // Align all views with the active one
+    widget::Rendering3DWidget *active = getActiveWidget();
+    if (checked && active)
+        linkedCamera.publish(active->getCamera(), active);
 }
 
 void RepoMdiArea::maximizeSubWindows(WindowOrder order)
@@ -216,6 +215,9 @@ repo::gui::widget::RepoMdiSubWindow * RepoMdiArea::addSubWindow(
 {
     RepoMdiSubWindow* repoSubWindow = new RepoMdiSubWindow(this);
     repoSubWindow->setWidget3D(database + "." +project, navMode, controller, offsetVector);// + " " + id.toString());
+    // Scenes of hidden windows are dropped and fetched again from here
+    if (widget::Rendering3DWidget *widget = repoSubWindow->widget<widget::Rendering3DWidget*>())
+        widget->setSceneSource(token, database, project, id, headRevision);
 	QMdiArea::addSubWindow(repoSubWindow);
 	repoSubWindow->show();
 
@@ -279,12 +281,16 @@ repo::gui::widget::RepoMdiSubWindow* RepoMdiArea::addSceneGraphSubWindow()
 {
     const repo::core::model::RepoScene *scene = nullptr;
     QString title = tr("Empty scene");
-    if (const widget::Rendering3DWidget *widget = getActiveWidget())
+    widget::Rendering3DWidget *widget = getActiveWidget();
+    if (widget)
     {
         scene = widget->getRepoScene();
         title = widget->windowTitle();
     }
-    return addSceneGraphSubWindow(scene, title);
+    RepoMdiSubWindow *repoSubWindow = addSceneGraphSubWindow(scene, title);
+    if (widget)
+        widget->holdScene(repoSubWindow);
+    return repoSubWindow;
 }
 
 repo::gui::widget::RepoMdiSubWindow* RepoMdiArea::addSceneGraphSubWindow(
@@ -327,6 +333,27 @@ Rendering3DWidget* RepoMdiArea::getActiveWidget() const
     return widget;
 }
 
+void RepoMdiArea::holdScene(const core::model::RepoScene *scene, QObject *holder)
+{
+    for (widget::Rendering3DWidget *widget : getWidgets<widget::Rendering3DWidget*>())
+        if (scene && widget->getRepoScene() == scene)
+            widget->holdScene(holder);
+}
+
+void RepoMdiArea::forgetConnection(const repo::RepoController::RepoToken *token)
+{
+    for (RepoMdiSubWindow *subWindow : subWindowList())
+    {
+        widget::Rendering3DWidget *widget = subWindow->widget<widget::Rendering3DWidget*>();
+        if (widget && !widget->clearSceneSource(token))
+        {
+            repoLogError("Closing " + widget->windowTitle().toStdString() +
+                         " as its released scene cannot be fetched again");
+            subWindow->close();
+        }
+    }
+}
+
 void RepoMdiArea::decreaseWindowCount()
 {
 
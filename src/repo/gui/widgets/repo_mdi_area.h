@@ -20,6 +20,8 @@
 //------------------------------------------------------------------------------
 #include "repo_mdi_subwindow.h"
 #include "repo_widget_rendering.h"
+#include "repo_memory_budget_manager.h"
+#include "repo_linked_camera.h"
 //------------------------------------------------------------------------------
 #include <repo/repo_controller.h>
 //------------------------------------------------------------------------------
@@ -169,6 +171,15 @@ public :
 
         repo::gui::widget::Rendering3DWidget* getActiveWidget() const;
 
+        //! Keeps the scene resident in its window until the holder is destroyed.
+        void holdScene(const core::model::RepoScene *scene, QObject *holder);
+
+        /*!
+            * Forgets the connection in the windows fetched through it, closing
+            * those whose released scene cannot be fetched again.
+            */
+        void forgetConnection(const repo::RepoController::RepoToken *token);
+
 	protected:
 
         //! decrease the count for 3D sub windows
@@ -192,6 +203,12 @@ public :
         QMutex offsetMutex; //mutex lock for updating of offsetVector
         std::vector<double> offsetVector; //world coordinates offset
 
+        //! Releases geometry of hidden windows when over the memory budget.
+        RepoMemoryBudgetManager memoryBudget;
+
+        //! Camera shared by chained windows.
+        RepoLinkedCamera linkedCamera;
+
 	};
 }
 } // end namespace gui
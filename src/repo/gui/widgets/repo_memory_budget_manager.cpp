@@ -0,0 +1,142 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "repo_memory_budget_manager.h"
+#include "repo_mdi_subwindow.h"
+#include "repo_widget_rendering.h"
+#include "../../logger/repo_logger.h"
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <vector>
+//------------------------------------------------------------------------------
+#include <QSettings>
+//------------------------------------------------------------------------------
+
+using namespace repo::gui::widget;
+
+const QString RepoMemoryBudgetManager::REPO_SETTINGS_MEMORY_BUDGET = "RepoGUI/memoryBudgetMB";
+
+//! Interval of the periodic budget check in milliseconds.
+static const int REPO_MEMORY_BUDGET_INTERVAL = 5000;
+
+RepoMemoryBudgetManager::RepoMemoryBudgetManager(QMdiArea *mdiArea)
+    : QObject(mdiArea)
+    , mdiArea(mdiArea)
+    , stamp(0)
+{
+    QObject::connect(mdiArea, &QMdiArea::subWindowActivated,
+                     this, &RepoMemoryBudgetManager::touch);
+    QObject::connect(&timer, &QTimer::timeout,
+                     this, &RepoMemoryBudgetManager::enforce);
+    timer.start(REPO_MEMORY_BUDGET_INTERVAL);
+}
+
+RepoMemoryBudgetManager::~RepoMemoryBudgetManager()
+{
+    timer.stop();
+}
+
+qint64 RepoMemoryBudgetManager::getBudget()
+{
+    QSettings settings;
+    return (qint64) settings.value(REPO_SETTINGS_MEMORY_BUDGET, DEFAULT_BUDGET_MB).toInt()
+            * 1024 * 1024;
+}
+
+qint64 RepoMemoryBudgetManager::getFootprint() const
+{
+    qint64 footprint = 0;
+    for (QMdiSubWindow *subWindow : mdiArea->subWindowList())
+    {
+        RepoMdiSubWindow *repoSubWindow = dynamic_cast<RepoMdiSubWindow*>(subWindow);
+        Rendering3DWidget *widget = repoSubWindow ?
+                    repoSubWindow->widget<Rendering3DWidget*>() : nullptr;
+        if (widget)
+            footprint += widget->getModelFootprint();
+    }
+    return footprint;
+}
+
+void RepoMemoryBudgetManager::touch(QMdiSubWindow *subWindow)
+{
+    if (subWindow)
+        lastViewed[subWindow] = ++stamp;
+    enforce();
+}
+
+bool RepoMemoryBudgetManager::isHidden(QMdiSubWindow *subWindow) const
+{
+    QMdiSubWindow *active = mdiArea->activeSubWindow();
+    return subWindow->isMinimized() || !subWindow->isVisible() ||
+            (subWindow != active &&
+             (mdiArea->viewMode() == QMdiArea::TabbedView ||
+              (active && active->isMaximized())));
+}
+
+void RepoMemoryBudgetManager::enforce()
+{
+    //--------------------------------------------------------------------------
+    // Restore visible windows, collect hidden ones
+    std::vector<std::pair<unsigned long long, Rendering3DWidget*>> hidden;
+    std::map<QMdiSubWindow*, unsigned long long> open;
+    for (QMdiSubWindow *subWindow : mdiArea->subWindowList())
+    {
+        RepoMdiSubWindow *repoSubWindow = dynamic_cast<RepoMdiSubWindow*>(subWindow);
+        Rendering3DWidget *widget = repoSubWindow ?
+                    repoSubWindow->widget<Rendering3DWidget*>() : nullptr;
+        if (!widget)
+            continue;
+
+        auto it = lastViewed.find(subWindow);
+        const unsigned long long viewed = it != lastViewed.end() ? it->second : 0;
+        open[subWindow] = viewed;
+
+        if (!isHidden(subWindow))
+            widget->restoreModel();
+        else if (widget->getModelFootprint() > 0)
+            hidden.push_back(std::make_pair(viewed, widget));
+    }
+    // Forget closed windows
+    lastViewed.swap(open);
+
+    //--------------------------------------------------------------------------
+    // Release least recently viewed first until within budget
+    const qint64 budget = getBudget();
+    qint64 footprint = getFootprint();
+    if (footprint <= budget)
+        return;
+
+    std::sort(hidden.begin(), hidden.end(),
+              [](const std::pair<unsigned long long, Rendering3DWidget*> &a,
+                 const std::pair<unsigned long long, Rendering3DWidget*> &b)
+    { return a.first < b.first; });
+
+    for (size_t i = 0; i < hidden.size() && footprint > budget; ++i)
+    {
+        Rendering3DWidget *widget = hidden[i].second;
+        const qint64 windowFootprint = widget->getModelFootprint();
+        const bool modelReleased = widget->releaseModel();
+        if (widget->releaseScene() || modelReleased)
+        {
+            const qint64 released = windowFootprint - widget->getModelFootprint();
+            repoLog("Over memory budget, released " + std::to_string(released / (1024 * 1024))
+                    + " MB of " + widget->windowTitle().toStdString());
+            footprint -= released;
+        }
+    }
+}
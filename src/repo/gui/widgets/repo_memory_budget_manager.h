@@ -0,0 +1,96 @@
+/**
+ *  Copyright (C) 2015 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+//------------------------------------------------------------------------------
+#include <map>
+//------------------------------------------------------------------------------
+#include <QObject>
+#include <QTimer>
+#include <QtWidgets/QMdiArea>
+#include <QtWidgets/QMdiSubWindow>
+//------------------------------------------------------------------------------
+
+namespace repo {
+namespace gui {
+namespace widget {
+
+/**
+ * Keeps the geometry of the 3D windows of an MDI area within a memory budget.
+ *
+ * Windows are stamped whenever they are activated. When the estimated
+ * footprint of all windows exceeds the budget, geometry of hidden windows
+ * (minimised, or behind a maximised or tabbed active window) is released,
+ * least recently viewed first, followed by scenes fetched from a database
+ * that are neither modified nor in use. Both are reloaded as soon as the
+ * window is visible again, the scene fetched anew if it was released.
+ */
+class RepoMemoryBudgetManager : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    //! Settings label of the budget in megabytes.
+    static const QString REPO_SETTINGS_MEMORY_BUDGET;
+
+    //! Budget used if none is set, in megabytes.
+    static const int DEFAULT_BUDGET_MB = 4096;
+
+    RepoMemoryBudgetManager(QMdiArea *mdiArea);
+
+    ~RepoMemoryBudgetManager();
+
+    //! Returns the estimated geometry and scene footprint of all windows in bytes.
+    qint64 getFootprint() const;
+
+    //! Returns the budget in bytes as per the settings.
+    static qint64 getBudget();
+
+public slots :
+
+    //! Stamps the window as the most recently viewed.
+    void touch(QMdiSubWindow *subWindow);
+
+    /**
+     * Restores visible windows and releases hidden ones until back within
+     * budget.
+     */
+    void enforce();
+
+protected:
+
+    //! Returns true if the window cannot currently be seen.
+    bool isHidden(QMdiSubWindow *subWindow) const;
+
+    QMdiArea *mdiArea;
+
+    //! Periodic check as footprints grow while models load.
+    QTimer timer;
+
+    //! Stamp of the last time each window was viewed.
+    std::map<QMdiSubWindow*, unsigned long long> lastViewed;
+
+    unsigned long long stamp;
+
+}; // end class
+
+} // end namespace widget
+} // end namespace gui
+} // end namespace repo
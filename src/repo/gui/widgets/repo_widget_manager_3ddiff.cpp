@@ -157,6 +157,11 @@ void Repo3DDiffManagerWidget::runBouncerDiff(
 	{
 		repo::core::model::RepoScene *sceneA = widgetA->getRepoScene();
 		repo::core::model::RepoScene *sceneB = widgetB->getRepoScene();
+		if (!sceneA || !sceneB)
+		{
+			repoLogError(tr("Both models need to be loaded to be compared.").toStdString());
+			return;
+		}
 
 		repo::worker::DiffWorker *worker = new repo::worker::DiffWorker(
 			controller,
@@ -170,6 +175,8 @@ void Repo3DDiffManagerWidget::runBouncerDiff(
 			widgetA, &repo::gui::widget::Rendering3DWidget::setMeshColor);
 		QObject::connect(worker, &repo::worker::DiffWorker::colorChangeOnB,
 			widgetB, &repo::gui::widget::Rendering3DWidget::setMeshColor);
+		widgetA->holdScene(worker);
+		widgetB->holdScene(worker);
 
 		//----------------------------------------------------------------------
 		// Fire up the asynchronous calculation.
@@ -58,6 +58,19 @@ RepoClippingPlaneWidget::RepoClippingPlaneWidget(QWidget *parent)
 
 	QObject::connect(ui->visibilityGroupBox, &QGroupBox::clicked,
 		this, &RepoClippingPlaneWidget::setClippingPlaneEnabled);
+
+	QObject::connect(ui->sectionBoxGroupBox, &QGroupBox::clicked,
+		this, &RepoClippingPlaneWidget::setSectionBoxEnabled);
+
+	for (QDoubleSpinBox *spinBox : {
+		 ui->xMinSpinBox, ui->xMaxSpinBox,
+		 ui->yMinSpinBox, ui->yMaxSpinBox,
+		 ui->zMinSpinBox, ui->zMaxSpinBox})
+	{
+		QObject::connect(spinBox,
+			static_cast<void (QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged),
+			this, &RepoClippingPlaneWidget::setSectionBox);
+	}
 }
 
 RepoClippingPlaneWidget::~RepoClippingPlaneWidget()
@@ -81,6 +94,9 @@ void RepoClippingPlaneWidget::setClippingPlaneEnabled(bool on)
 {
 	if (on && ui->visibilityGroupBox->isChecked())
 	{
+		// Both share the first clip plane
+		ui->sectionBoxGroupBox->setChecked(false);
+
 		QObject::connect(ui->linkToolButton, &QPushButton::toggled,
 			this, &RepoClippingPlaneWidget::setClippingPlane);
 
@@ -100,7 +116,7 @@ void RepoClippingPlaneWidget::setClippingPlaneEnabled(bool on)
 
 void RepoClippingPlaneWidget::setClippingPlane()
 {
-	if (mdiArea)
+	if (mdiArea && ui->visibilityGroupBox->isChecked())
 	{
 		Axis axis = getAxis();
 		bool reverse = ui->reverseToolButton->isChecked();
@@ -126,6 +142,51 @@ void RepoClippingPlaneWidget::setClippingPlane()
 	}
 }
 
+void RepoClippingPlaneWidget::setSectionBoxEnabled(bool on)
+{
+	if (on && ui->sectionBoxGroupBox->isChecked())
+	{
+		ui->visibilityGroupBox->setChecked(false);
+		setSectionBox();
+	}
+	else
+	{
+		for (auto w : getTargetWidgets())
+			w->setSectionBoxVisibility(false);
+	}
+}
+
+void RepoClippingPlaneWidget::setSectionBox()
+{
+	if (!ui->sectionBoxGroupBox->isChecked())
+		return;
+
+	const std::vector<double> lower = {
+		ui->xMinSpinBox->value() / 100.0,
+		ui->yMinSpinBox->value() / 100.0,
+		ui->zMinSpinBox->value() / 100.0 };
+	const std::vector<double> upper = {
+		ui->xMaxSpinBox->value() / 100.0,
+		ui->yMaxSpinBox->value() / 100.0,
+		ui->zMaxSpinBox->value() / 100.0 };
+
+	for (auto w : getTargetWidgets())
+		w->setSectionBox(lower, upper);
+}
+
+std::vector<Rendering3DWidget*> RepoClippingPlaneWidget::getTargetWidgets() const
+{
+	std::vector<Rendering3DWidget*> widgets;
+	if (mdiArea)
+	{
+		if (ui->linkToolButton->isChecked())
+			widgets = mdiArea->getWidgets<Rendering3DWidget*>();
+		else if (Rendering3DWidget* widget = mdiArea->getActiveWidget())
+			widgets.push_back(widget);
+	}
+	return widgets;
+}
+
 void RepoClippingPlaneWidget::setLinkAction(QAction* actionLink)
 {
 	QObject::connect(ui->linkToolButton, &QPushButton::toggled,
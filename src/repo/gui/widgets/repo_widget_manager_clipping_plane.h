@@ -18,6 +18,7 @@
 #pragma once
 
 #include <QWidget>
+#include <vector>
 
 //------------------------------------------------------------------------------
 // GUI
@@ -48,6 +49,11 @@ public slots:
 
     void setClippingPlane();
 
+    void setSectionBoxEnabled(bool on);
+
+    //! Applies the section box spin box values to the target widgets.
+    void setSectionBox();
+
     void setMdiArea(repo::gui::widget::RepoMdiArea *mdiArea)
     { this->mdiArea = mdiArea; }
 
@@ -55,6 +61,9 @@ public slots:
 
 private:
 
+    //! Returns all 3D widgets if linked, the active one otherwise.
+    std::vector<Rendering3DWidget*> getTargetWidgets() const;
+
     Ui::RepoClippingPlaneWidget *ui;
 
     repo::gui::widget::RepoMdiArea *mdiArea;
@@ -21,14 +21,23 @@
 #include "../primitives/repo_color.h"
 #include "../../logger/repo_logger.h"
 #include "../renderers/repo_renderer_glc.h"
+#include "../renderers/repo_accumulation_buffer.h"
+#include "../renderers/repo_image_stream_writer.h"
+#include "../../workers/repo_worker_scene_graph.h"
 //------------------------------------------------------------------------------
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 //------------------------------------------------------------------------------
 #include <QFile>
+#include <QFileDialog>
+#include <QFileInfo>
 #include <QFont>
+#include <QImageWriter>
 #include <QTime>
 #include <QTimer>
 #include <QScreen>
+#include <QThreadPool>
 //------------------------------------------------------------------------------
 
 
@@ -66,6 +75,9 @@ using namespace repo::gui::widget;
 //------------------------------------------------------------------------------
 const double Rendering3DWidget::ZOOM_FACTOR = 1.2;
 
+//! Largest image assembled in memory for formats that cannot be streamed.
+static const qint64 REPO_MAX_IMAGE_WRITER_BYTES = 512ll * 1024 * 1024;
+
 //QList<GLC_Shader*> Rendering3DWidget::shaders;
 
 Rendering3DWidget::Rendering3DWidget(
@@ -80,7 +92,14 @@ Rendering3DWidget::Rendering3DWidget(
     , isInfoVisible(true)
     , repoScene(0)
      , controller(controller)
-    , partition(std::shared_ptr<repo_partitioning_tree_t>(nullptr))
+    , sceneFootprint(0)
+    , sceneToken(nullptr)
+    , sceneHeadRevision(true)
+    , sceneReleased(false)
+    , sceneRestoring(false)
+    , sceneHolds(0)
+    , linkedCameraVersion(0)
+    , isForwardingKey(false)
 
 {
     // TODO: add to GUI settings
@@ -109,16 +128,21 @@ Rendering3DWidget::Rendering3DWidget(
 
 Rendering3DWidget::~Rendering3DWidget()
 {
+    setLinkedCamera(nullptr);
+
     makeCurrent();
+    pixelReadback.clear();
     renderer->deleteShaders(context());
 
     if (repoScene)
         delete repoScene;
 
-    doneCurrent();
-
+    // Buffers of the world, streamed meshes and point cloud go with the
+    // context current, the shared contexts would keep them otherwise
     if (renderer)
         delete renderer;
+
+    doneCurrent();
 }
 
 //------------------------------------------------------------------------------
@@ -137,6 +161,12 @@ void Rendering3DWidget::initializeGL()
 
 }
 
+void Rendering3DWidget::showEvent(QShowEvent *e)
+{
+    QOpenGLWidget::showEvent(e);
+    restoreModel();
+}
+
 void Rendering3DWidget::instantiateRenderer(Renderer rendType)
 {
     if (rendType == Renderer::GLC)
@@ -158,6 +188,9 @@ void Rendering3DWidget::initializeShaders()
 
     QFile selectVertexShaderFile(":/shaders/select.vert");
     QFile selectFragmentShaderFile(":/shaders/select.frag");
+
+    QFile idVertexShaderFile(":/shaders/id.vert");
+    QFile idFragmentShaderFile(":/shaders/id.frag");
     //--------------------------------------------------------------------------
     QFile defaultVertexShaderFile(":/shaders/default.vert");
     QFile defaultFragmentShaderFile(":/shaders/default.frag");
@@ -180,6 +213,7 @@ void Rendering3DWidget::initializeShaders()
         try
         {
             renderer->setAndInitSelectionShaders(selectVertexShaderFile, selectFragmentShaderFile, context());
+            renderer->setAndInitIdShaders(idVertexShaderFile, idFragmentShaderFile, context());
             //------------------------------------------------------------------
             renderer->appendAndInitRenderingShaders(defaultVertexShaderFile, defaultFragmentShaderFile, context());
             renderer->appendAndInitRenderingShaders(goochVertexShaderFile, goochFragmentShaderFile, context());
@@ -196,6 +230,14 @@ void Rendering3DWidget::initializeShaders()
 
 void Rendering3DWidget::paintGL()
 {
+    // Latest camera of the linked windows, however many moves since last frame
+    if (linkedCamera && linkedCamera->getVersion() != linkedCameraVersion)
+    {
+        if (linkedCamera->getSource() != this)
+            renderer->setCamera(linkedCamera->getCamera());
+        linkedCameraVersion = linkedCamera->getVersion();
+    }
+
     if (isInfoVisible)
     {
         QPainter painter(this);
@@ -206,6 +248,11 @@ void Rendering3DWidget::paintGL()
     else
         renderer->render(nullptr);
 
+    // Captures issued on previous frames, repaint until all are through
+    pixelReadback.poll();
+    if (pixelReadback.getPendingCount())
+        QTimer::singleShot(0, this, SLOT(update()));
+
     // Continuous rendering
     //    QTimer::singleShot(0, this, SLOT(update()));
 }
@@ -243,6 +290,14 @@ void Rendering3DWidget::setMeshColor(
     update();
 }
 
+void Rendering3DWidget::setMeshVisibility(
+        const std::vector<repoUUID> &uniqueIDs,
+        bool visible)
+{
+    renderer->setMeshVisibility(uniqueIDs, visible);
+    update();
+}
+
 void Rendering3DWidget::setInfoVisibility(const bool visible)
 {
     isInfoVisible = visible;
@@ -269,35 +324,59 @@ void Rendering3DWidget::updateClippingPlane(repo::gui::renderer::Axis axis, doub
     update();
 }
 
-void Rendering3DWidget::linkCameras(
-        const Rendering3DWidget *widget,
-        const bool & on) const
+void Rendering3DWidget::setSectionBoxVisibility(bool on)
 {
-    if (on)
-    {
-        QObject::connect(renderer, &renderer::AbstractRenderer::cameraChanged,
-                         widget, &Rendering3DWidget::setCamera);
+    renderer->setSectionBoxVisibility(on);
+    update();
+}
 
-        QObject::connect(this,
-                         &repo::gui::widget::Rendering3DWidget::keyPressed,
-                         widget,
-                         &repo::gui::widget::Rendering3DWidget::keyPressEvent);
+void Rendering3DWidget::setSectionBox(
+        const std::vector<double> &lower,
+        const std::vector<double> &upper)
+{
+    renderer->setSectionBox(lower, upper);
+    update();
+}
 
-        // TODO: align all views
-        //        renderer->notifyCameraChange();
-    }
-    else
+void Rendering3DWidget::setLinkedCamera(RepoLinkedCamera *camera)
+{
+    if (linkedCamera == camera)
+        return;
+
+    if (linkedCamera)
     {
+        linkedCamera->unsubscribe(this);
         QObject::disconnect(renderer, &renderer::AbstractRenderer::cameraChanged,
-                            widget, &Rendering3DWidget::setCamera);
+                            this, &Rendering3DWidget::publishCamera);
+    }
 
-        QObject::disconnect(this,
-                         &repo::gui::widget::Rendering3DWidget::keyPressed,
-                         widget,
-                         &repo::gui::widget::Rendering3DWidget::keyPressEvent);
+    linkedCamera = camera;
+    if (linkedCamera)
+    {
+        linkedCamera->subscribe(this);
+        linkedCameraVersion = linkedCamera->getVersion();
+        QObject::connect(renderer, &renderer::AbstractRenderer::cameraChanged,
+                         this, &Rendering3DWidget::publishCamera);
+    }
+}
+
+void Rendering3DWidget::publishCamera(const repo::gui::renderer::CameraSettings &camera)
+{
+    if (linkedCamera)
+    {
+        linkedCamera->publish(camera, this);
+        // Own camera, nothing to apply on the next paint
+        linkedCameraVersion = linkedCamera->getVersion();
     }
 }
 
+void Rendering3DWidget::receiveLinkedKey(QKeyEvent *e)
+{
+    isForwardingKey = true;
+    keyPressEvent(e);
+    isForwardingKey = false;
+}
+
 //------------------------------------------------------------------------------
 //
 // Setters
@@ -320,6 +399,16 @@ void Rendering3DWidget::setRepoScene(
             delete this->repoScene;
 
         this->repoScene = repoScene;
+        sceneReleased = false;
+
+        sceneFootprint = 0;
+        for (const repo::core::model::RepoScene::GraphType &graph :
+             {repo::core::model::RepoScene::GraphType::DEFAULT,
+              repo::core::model::RepoScene::GraphType::OPTIMIZED})
+        {
+            for (const repo::core::model::RepoNode *node : repoScene->getAllMeshes(graph))
+                sceneFootprint += node->objsize();
+        }
 
         if (renderer)
         {
@@ -337,6 +426,89 @@ void Rendering3DWidget::setRepoScene(
 }
 
 
+void Rendering3DWidget::setSceneSource(
+        const repo::RepoController::RepoToken *token,
+        const QString &database,
+        const QString &project,
+        const QUuid &id,
+        bool headRevision)
+{
+    sceneToken = token;
+    sceneDatabase = database;
+    sceneProject = project;
+    sceneId = id;
+    sceneHeadRevision = headRevision;
+}
+
+bool Rendering3DWidget::clearSceneSource(const repo::RepoController::RepoToken *token)
+{
+    if (!sceneToken || sceneToken != token)
+        return true;
+    sceneToken = nullptr;
+    return !sceneReleased;
+}
+
+void Rendering3DWidget::holdScene(QObject *holder)
+{
+    // Workers are deleted by the pool thread, the decrement is queued back here
+    ++sceneHolds;
+    QObject::connect(holder, &QObject::destroyed, this, [this]() { --sceneHolds; });
+}
+
+//------------------------------------------------------------------------------
+//
+// Memory management
+//
+//------------------------------------------------------------------------------
+
+bool Rendering3DWidget::releaseScene()
+{
+    // Changes would be lost, and files cannot be fetched again
+    if (!repoScene || !sceneToken || sceneHolds > 0 || repoScene->getTotalNodesChanged() ||
+            !renderer || !renderer->releaseScene())
+        return false;
+
+    delete repoScene;
+    repoScene = nullptr;
+    sceneReleased = true;
+    return true;
+}
+
+void Rendering3DWidget::restoreModel()
+{
+    if (!renderer)
+        return;
+
+    if (!sceneReleased)
+        renderer->restoreModel();
+    else if (!sceneRestoring && sceneToken)
+    {
+        sceneRestoring = true;
+        repoLog("Fetching " + windowTitle().toStdString() + " again...");
+        repo::worker::SceneGraphWorker *worker = new repo::worker::SceneGraphWorker(
+                    controller, sceneToken, sceneDatabase, sceneProject, sceneId, sceneHeadRevision);
+        connect(worker, &repo::worker::SceneGraphWorker::finished,
+                this, &Rendering3DWidget::setRestoredScene);
+        connect(worker, &repo::worker::SceneGraphWorker::progress,
+                this, &Rendering3DWidget::rendererProgress);
+        QThreadPool::globalInstance()->start(worker);
+    }
+}
+
+void Rendering3DWidget::setRestoredScene(repo::core::model::RepoScene *scene)
+{
+    sceneRestoring = false;
+    if (!scene)
+    {
+        repoLogError("Failed to fetch " + windowTitle().toStdString() + " again");
+        return;
+    }
+
+    repoScene = scene;
+    sceneReleased = false;
+    renderer->restoreModel(scene);
+}
+
 //------------------------------------------------------------------------------
 //
 // Getters
@@ -380,13 +552,15 @@ QImage Rendering3DWidget::renderFrameBufferQImage(int w, int h, GLvoid *data)
     QOpenGLFramebufferObjectFormat format;
     format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
     // Note that it is not possible to set more samples, aka antialiasing, here
-    // as that will not produce any rendering!
+    // as that will not produce any rendering! Jittered passes are averaged
+    // instead.
     QOpenGLFramebufferObject m_fbo(w, h, format);
     resizeGL(w, h);
 
     m_fbo.bind();
     isInfoVisible = false;
-    paintGL();
+    QImage image = paintAccumulated(m_fbo, QRect(0, 0, w, h),
+                                    renderer::RepoAccumulationBuffer::getSampleCount());
     isInfoVisible = true;
 
     // https://www.opengl.org/sdk/docs/man2/xhtml/glReadPixels.xml
@@ -394,7 +568,6 @@ QImage Rendering3DWidget::renderFrameBufferQImage(int w, int h, GLvoid *data)
         context()->functions()->glReadPixels(0, 0, w, h, GL_DEPTH_COMPONENT, GL_FLOAT, data);
 
     m_fbo.release();
-    QImage image = m_fbo.toImage();
     m_fbo.bindDefault();
     doneCurrent();
 
@@ -403,6 +576,132 @@ QImage Rendering3DWidget::renderFrameBufferQImage(int w, int h, GLvoid *data)
     return image;
 }
 
+bool Rendering3DWidget::renderTiledImage(const QString &path, int w, int h, int tileSize)
+{
+    //--------------------------------------------------------------------------
+    // TIFF is streamed, anything else is held whole for QImageWriter
+    const bool streamed = renderer::RepoImageStreamWriter::isSupported(path);
+    renderer::RepoImageStreamWriter writer(path, w, h);
+    QImage image;
+    if (streamed && !writer.open())
+    {
+        repoLogError(writer.getErrorString().toStdString());
+        return false;
+    }
+    else if (!streamed)
+    {
+        const QByteArray suffix = QFileInfo(path).suffix().toLower().toLatin1();
+        if (!QImageWriter::supportedImageFormats().contains(suffix))
+        {
+            repoLogError(tr("Unsupported image format: %1").arg(path).toStdString());
+            return false;
+        }
+        if ((qint64) w * h * 3 > REPO_MAX_IMAGE_WRITER_BYTES)
+        {
+            repoLogError(tr("Image of %1x%2 too large for %3, save as TIFF instead.")
+                         .arg(w).arg(h).arg(QString(suffix)).toStdString());
+            return false;
+        }
+        image = QImage(w, h, QImage::Format_RGB888);
+        if (image.isNull())
+        {
+            repoLogError(tr("Out of memory for an image of %1x%2.").arg(w).arg(h).toStdString());
+            return false;
+        }
+    }
+
+    makeCurrent();
+
+    GLint maxSize = 0;
+    context()->functions()->glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+    if (maxSize > 0)
+        tileSize = std::min(tileSize, (int) maxSize);
+    const int tileWidth = std::min(tileSize, w);
+    const int tileHeight = std::min(tileSize, h);
+
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    QOpenGLFramebufferObject fbo(tileWidth, tileHeight, format);
+
+    fbo.bind();
+    isInfoVisible = false;
+    const int samples = renderer::RepoAccumulationBuffer::getSampleCount();
+
+    //--------------------------------------------------------------------------
+    // One band of tiles at a time, handed to the encoder while the next
+    // band renders
+    for (int y = 0; y < h; y += tileHeight)
+    {
+        const int bandHeight = std::min(tileHeight, h - y);
+        QImage band(w, bandHeight, QImage::Format_RGB888);
+        for (int x = 0; x < w; x += tileWidth)
+        {
+            const QRect tile(x, y, std::min(tileWidth, w - x), bandHeight);
+            renderer->setTile(w, h, tile);
+
+            // The tile is drawn into the lower left corner of the buffer
+            const QImage tileImage = paintAccumulated(
+                        fbo,
+                        QRect(0, tileHeight - bandHeight, tile.width(), bandHeight),
+                        samples).convertToFormat(QImage::Format_RGB888);
+            for (int row = 0; row < bandHeight; ++row)
+                memcpy(band.scanLine(row) + x * 3, tileImage.constScanLine(row), tile.width() * 3);
+        }
+        if (streamed)
+            writer.writeRows(band);
+        else
+            for (int row = 0; row < bandHeight; ++row)
+                memcpy(image.scanLine(y + row), band.constScanLine(row), w * 3);
+    }
+
+    renderer->setTile(w, h, QRect());
+    isInfoVisible = true;
+
+    fbo.release();
+    fbo.bindDefault();
+    doneCurrent();
+
+    if (!streamed)
+    {
+        QImageWriter imageWriter(path);
+        imageWriter.setQuality(100);
+        if (!imageWriter.write(image))
+        {
+            repoLogError(imageWriter.errorString().toStdString());
+            return false;
+        }
+        return true;
+    }
+
+    const bool success = writer.close();
+    if (!success)
+        repoLogError(writer.getErrorString().toStdString());
+    return success;
+}
+
+QImage Rendering3DWidget::paintAccumulated(
+        QOpenGLFramebufferObject &fbo,
+        const QRect &area,
+        int samples)
+{
+    if (samples <= 1)
+    {
+        paintGL();
+        return fbo.toImage().copy(area);
+    }
+
+    renderer::RepoAccumulationBuffer buffer(area.width(), area.height());
+    for (int pass = samples - 1; pass >= 0; --pass)
+    {
+        const QPointF jitter = renderer::RepoAccumulationBuffer::getJitter(pass);
+        renderer->setSubPixelOffset(jitter.x(), jitter.y());
+        paintGL();
+        buffer.accumulate(fbo.toImage().copy(area));
+    }
+    renderer->setSubPixelOffset(0, 0);
+    return buffer.resolve();
+}
+
 int Rendering3DWidget::getSelectedID(int x, int y)
 {
     makeCurrent();
@@ -434,6 +733,11 @@ int Rendering3DWidget::getSelectedID(int x, int y)
     fbo.bindDefault();
     doneCurrent();
 
+    return decodeSelectedID(colorId.data(), squareSize);
+}
+
+int Rendering3DWidget::decodeSelectedID(const GLubyte *pixels, int count)
+{
 
     QHash<GLC_uint, int> idHash;
     QList<int> idWeight;
@@ -443,9 +747,9 @@ int Rendering3DWidget::getSelectedID(int x, int y)
     // There is nothing at the center
     int maxWeight= 0;
     int currentIndex= 0;
-    for (int i= 0; i < squareSize; ++i)
+    for (int i= 0; i < count; ++i)
     {
-        GLC_uint id= glc::decodeRgbId(&colorId[i * 4]);
+        GLC_uint id= glc::decodeRgbId(&pixels[i * 4]);
         if (idHash.contains(id))
         {
             const int currentWeight= ++(idWeight[idHash.value(id)]);
@@ -559,6 +863,35 @@ void Rendering3DWidget::keyPressEvent(QKeyEvent *e)
         break;
     }
 
+    case  Qt::Key_T:
+    {
+        if ((e->modifiers() == Qt::ControlModifier))
+        {
+            // Only the window the key was pressed in asks for a file
+            if (!isForwardingKey)
+            {
+                QString path = QFileDialog::getSaveFileName(
+                            this, tr("Export frame timings"),
+                            windowTitle() + "_timings.csv", tr("CSV (*.csv)"));
+                if (!path.isEmpty() && !renderer->exportFrameTimings(path))
+                    repoLogError("Failed to export frame timings to " + path.toStdString());
+            }
+        }
+        else
+        {
+            renderer->toggleFrameTimings();
+            update();
+        }
+        break;
+    }
+
+    case  Qt::Key_U:
+    {
+        renderer->toggleOcclusionCulling();
+        update();
+        break;
+    }
+
     case  Qt::Key_K:
     {
         if ((e->modifiers() == Qt::ControlModifier))
@@ -567,13 +900,14 @@ void Rendering3DWidget::keyPressEvent(QKeyEvent *e)
             renderer->toggleMeshBoundingBoxes(repoScene);
             update();
         }
+        else if (e->modifiers() == (Qt::ControlModifier | Qt::ShiftModifier))
+        {
+            renderer->cycleMeshBoundingBoxLevel();
+            update();
+        }
         else
         {
-            if(!sceneBbox.size())
-                sceneBbox = repoScene->getSceneBoundingBox();
-            if(!partition)
-                partition = controller->getScenePartitioning(repoScene);
-            renderer->toggleGenericPartitioning(sceneBbox, partition);
+            renderer->toggleGenericPartitioning(controller, repoScene);
             update();
         }
 
@@ -642,12 +976,10 @@ void Rendering3DWidget::keyPressEvent(QKeyEvent *e)
     // Pass on the event to parent.
     QOpenGLWidget::keyPressEvent(e);
 
-    // The original widget that caused the key press is null sender.
-    // However, whichever subsequently linked widget that receives this
-    // information will have a non-null sender() so in that case it will stop
-    // emitting any further to avoid infinite looping across all linked widgets.
-    if (!sender())
-        emit keyPressed(e);
+    // Only the original widget that caused the key press passes it on to
+    // avoid infinite looping across all linked widgets.
+    if (!isForwardingKey && linkedCamera)
+        linkedCamera->forwardKey(e, this);
 }
 
 void Rendering3DWidget::mousePressEvent(QMouseEvent *e)
@@ -754,8 +1086,10 @@ void Rendering3DWidget::wheelEvent(QWheelEvent * e)
 void Rendering3DWidget::select(
         int x, int y, bool multiSelection, QMouseEvent *)
 {
+    // Highlighted once the readback is polled by a later frame
     makeCurrent();
-    renderer->selectComponent(context(), x, y, multiSelection);
+    renderer->selectComponent(pixelReadback, x, y, multiSelection);
+    doneCurrent();
     update();
 }
 
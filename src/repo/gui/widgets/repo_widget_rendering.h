@@ -27,10 +27,14 @@
 // GUI
 #include "../renderers/repo_renderer_abstract.h"
 #include "repo_widget_rendering_abstract.h"
+#include "repo_linked_camera.h"
 
 //------------------------------------------------------------------------------
 #include <QGLWidget>
 #include <QOpenGLWidget>
+#include <QOpenGLFramebufferObject>
+#include <QPointer>
+#include <QUuid>
 //------------------------------------------------------------------------------
 
 
@@ -89,12 +93,27 @@ protected:
     //! Renders the current scene.
     void paintGL();
 
+    //! Returns the most frequent non-zero selection ID of the RGBA pixels.
+    static int decodeSelectedID(const GLubyte *pixels, int count);
+
+    /**
+     * Renders into the bound framebuffer the given number of sub-pixel
+     * jittered passes and returns their average over the area. The last
+     * pass is the unjittered one so that the depth buffer matches the view.
+     */
+    QImage paintAccumulated(QOpenGLFramebufferObject &fbo,
+                            const QRect &area,
+                            int samples);
+
     //! Displays the colored XYZ axes in the bottom right corner.
     void paintInfo();
 
     //! Resizes the OpenGL window.
     void resizeGL(int width, int height);
 
+    //! Reloads geometry released while the widget was hidden.
+    void showEvent(QShowEvent *e);
+
     //void reframe(const GLC_BoundingBox& boundingBox);
 
 public:
@@ -119,6 +138,9 @@ public slots :
 
     void cancelOperations() { emit cancelRenderingOps(); }
 
+    //! Publishes the camera of this widget to the linked windows.
+    void publishCamera(const repo::gui::renderer::CameraSettings &camera);
+
 
     /**
                 * Reset mesh colours to its original
@@ -136,6 +158,9 @@ public slots :
             const qreal &opacity,
             const QColor &color);
 
+    //! Shows or hides the meshes of the given unique IDs and repaints.
+    void setMeshVisibility(const std::vector<repoUUID> &uniqueIDs, bool visible);
+
     //! Sets the visibility of the XYZ axes
     void setInfoVisibility(const bool visible);
 
@@ -146,6 +171,11 @@ public slots :
 
     void updateClippingPlane(repo::gui::renderer::Axis axis, double value, bool reverse = false);
 
+    void setSectionBoxVisibility(bool on);
+
+    //! Sets the section box from per-axis fractions of the scene bounding box.
+    void setSectionBox(const std::vector<double> &lower, const std::vector<double> &upper);
+
 signals:
 
     void cancelRenderingOps();
@@ -154,12 +184,19 @@ signals:
 
     void selectionChanged(const Rendering3DWidget *, std::vector<std::string>);
 
-    void keyPressed(QKeyEvent *);
-
 public:
 
-    //! Sets the widget to hook with
-    void linkCameras(const Rendering3DWidget *widget, const bool& link = true) const;
+    /**
+     * Links the camera and key presses of this widget with the other
+     * subscribers of the given camera, nullptr to unlink.
+     */
+    void setLinkedCamera(RepoLinkedCamera *camera);
+
+    //! Processes a key press forwarded from a linked widget.
+    void receiveLinkedKey(QKeyEvent *e);
+
+    //! Returns the current camera of the renderer.
+    renderer::CameraSettings getCamera() const { return renderer->getCurrentCamera(); }
 
     //--------------------------------------------------------------------------
     //
@@ -234,8 +271,65 @@ public:
 
     QImage renderFrameBufferQImage(int w, int h, GLvoid *data);
 
+    /**
+     * Renders the current view at any resolution as tiles through a single
+     * small framebuffer. TIFF files are streamed band by band so that memory
+     * does not grow with the image height, other formats supported by
+     * QImageWriter are assembled in memory up to a size limit.
+     * @param path file to write, its suffix selects the format
+     * @param w width of the image
+     * @param h height of the image
+     * @param tileSize largest tile edge, bounded by the GL limits
+     * @return returns true upon success
+     */
+    bool renderTiledImage(const QString &path, int w, int h, int tileSize = 1024);
+
     int getSelectedID(int x, int y);
 
+    //--------------------------------------------------------------------------
+    //
+    // Memory management
+    //
+    //--------------------------------------------------------------------------
+
+    //! Releases the geometry, see AbstractRenderer::releaseModel().
+    bool releaseModel() { return renderer && renderer->releaseModel(); }
+
+    //! Reloads released geometry, fetching the scene again if it was released.
+    void restoreModel();
+
+    bool isModelReleased() const { return renderer && renderer->isModelReleased(); }
+
+    /**
+     * Deletes the scene once its geometry is released, provided it can be
+     * fetched again from its source and is neither modified nor held.
+     * @return returns true if the scene was deleted
+     */
+    bool releaseScene();
+
+    //! Records the revision the scene was fetched from, see releaseScene().
+    void setSceneSource(const repo::RepoController::RepoToken *token,
+                        const QString &database,
+                        const QString &project,
+                        const QUuid &id,
+                        bool headRevision);
+
+    /**
+     * Forgets the source if fetched through the given connection, which is
+     * about to close.
+     * @return returns false if the scene was released and is now lost
+     */
+    bool clearSceneSource(const repo::RepoController::RepoToken *token);
+
+    //! Keeps the scene resident until the holder is destroyed.
+    void holdScene(QObject *holder);
+
+    //! Returns the estimated geometry and scene footprint in bytes.
+    qint64 getModelFootprint() const
+    {
+        return (renderer ? renderer->getModelFootprint() : 0) + (repoScene ? sceneFootprint : 0);
+    }
+
 public:
 
     //--------------------------------------------------------------------------
@@ -270,6 +364,9 @@ public:
                 */
     void instantiateRenderer(Renderer rendType);
 
+    //! Hands a scene fetched again over to the released geometry.
+    void setRestoredScene(repo::core::model::RepoScene *scene);
+
 
 
     //--------------------------------------------------------------------------
@@ -282,9 +379,40 @@ public:
     repo::core::model::RepoScene *repoScene;
     repo::RepoController *controller;
 
+    //! Estimated size of the mesh nodes of the scene.
+    qint64 sceneFootprint;
+
+    //! Revision the scene was fetched from, no token if not from a database.
+    const repo::RepoController::RepoToken *sceneToken;
+    QString sceneDatabase;
+    QString sceneProject;
+    QUuid sceneId;
+    bool sceneHeadRevision;
+
+    //! True while the scene is deleted, see releaseScene().
+    bool sceneReleased;
+
+    //! True while the scene is being fetched again.
+    bool sceneRestoring;
+
+    //! Number of live objects holding the scene, see holdScene().
+    int sceneHolds;
+
     //! Renderer for this instance of rendering widget
     renderer::AbstractRenderer* renderer;
 
+    //! Camera shared with linked windows, null if not linked.
+    QPointer<RepoLinkedCamera> linkedCamera;
+
+    //! Version of the linked camera last applied to the renderer.
+    unsigned long long linkedCameraVersion;
+
+    //! True while processing a key press forwarded from a linked widget.
+    bool isForwardingKey;
+
+    //! Pending captures, polled on every frame.
+    renderer::RepoPixelReadback pixelReadback;
+
     ////! Dictionary of meshes pointed to by their associated unique name.
     //QHash<QString, GLC_Mesh*> glcMeshes;
 
@@ -303,9 +431,6 @@ public:
     bool isInfoVisible;
 
     bool mousePressed;
-
-    std::vector<repo_vector_t> sceneBbox;
-    std::shared_ptr<repo_partitioning_tree_t> partition;
 }; // end
 
 
@@ -19,14 +19,21 @@
 #include "repo_widget_tree_dock.h"
 #include "ui_repo_widget_tree_dock.h"
 #include "../primitives/repo_sort_filter_proxy_model.h"
+//------------------------------------------------------------------------------
+#include <QTimer>
+//------------------------------------------------------------------------------
 
 using namespace repo::gui::widget;
 
+//! Nodes added to the tree per turn of the event loop.
+static const int REPO_TREE_BATCH_SIZE = 1000;
+
 TreeDockWidget::TreeDockWidget(
         Rendering3DWidget *glcWidget,
         QWidget *parent)
     : QDockWidget(parent)
     , glcWidget(glcWidget)
+    , repoScene(nullptr)
     , ui(new Ui::TreeDockWidget)
 {
     ui->setupUi(this);
@@ -35,13 +42,14 @@ TreeDockWidget::TreeDockWidget(
 
     this->setAttribute(Qt::WA_DeleteOnClose);
 
-    //const core::RepoGraphScene* repoScene = 0;
     if (glcWidget)
     {
         QObject::connect(glcWidget, SIGNAL(destroyed()),
                          this, SLOT(close()));
         this->setWindowTitle(windowTitle() + ": " + glcWidget->windowTitle());
-        //repoScene = glcWidget->getRepoScene();
+        repoScene = glcWidget->getRepoScene();
+        // Items point into the scene
+        glcWidget->holdScene(this);
     }
 
     QList<QString> headers;
@@ -49,26 +57,30 @@ TreeDockWidget::TreeDockWidget(
     headers << tr("Type");
     headers << tr("Unique ID");
     headers << tr("Shared ID");
-    //ui->filterableTreeWidget->setHeaders(headers);
-    //ui->filterableTreeWidget->setProxyModel(new RepoSortFilterProxyModel(this, true));
-    //ui->filterableTreeWidget->setExtendedSelection();
-    //ui->filterableTreeWidget->getTreeView()->setExpandsOnDoubleClick(false);
-
-    //if (repoScene)
-    //{
-    //    // TODO: make asynchronous
-    //    addNode(ui->filterableTreeWidget->getModel()->invisibleRootItem(),
-    //        repoScene->getRoot());
-    //}
+    ui->filterableTreeWidget->setHeaders(headers);
+    ui->filterableTreeWidget->setProxyModel(
+                new repo::gui::primitive::RepoSortFilterProxyModel(this, true));
+    ui->filterableTreeWidget->setExtendedSelection();
+    ui->filterableTreeWidget->getTreeView()->setExpandsOnDoubleClick(false);
 
-  /*  QObject::connect(ui->filterableTreeWidget->getSelectionModel(),
-                     SIGNAL(selectionChanged(QItemSelection, QItemSelection)),
-                     this, SLOT(changeSelection(QItemSelection, QItemSelection)));
+    if (repoScene)
+    {
+        // Built in batches so that large scenes do not freeze the GUI
+        pendingNodes.push_back(std::make_pair(
+                                   ui->filterableTreeWidget->getModel()->invisibleRootItem(),
+                                   repoScene->getRoot(repoScene->getViewGraph())));
+        addPendingNodes();
+        ui->filterableTreeWidget->expandTopLevelItems();
+    }
 
     QObject::connect(ui->filterableTreeWidget->getModel(),
                      SIGNAL(itemChanged(QStandardItem*)),
                      this, SLOT(changeItem(QStandardItem*)));
 
+  /*  QObject::connect(ui->filterableTreeWidget->getSelectionModel(),
+                     SIGNAL(selectionChanged(QItemSelection, QItemSelection)),
+                     this, SLOT(changeSelection(QItemSelection, QItemSelection)));
+
     QObject::connect(
                 ui->filterableTreeWidget->getTreeView(),
                 SIGNAL(doubleClicked(QModelIndex)),
@@ -86,6 +98,97 @@ TreeDockWidget::~TreeDockWidget()
 }
 
 
+void TreeDockWidget::addPendingNodes()
+{
+    //--------------------------------------------------------------------------
+    // Depth first with the children queued in reverse so that rows are
+    // appended in the order of the scene
+    std::vector<repoUUID> hiddenMeshes;
+    for (int i = 0; i < REPO_TREE_BATCH_SIZE && !pendingNodes.empty(); ++i)
+    {
+        const std::pair<QStandardItem*, repo::core::model::RepoNode*> pending =
+                pendingNodes.back();
+        pendingNodes.pop_back();
+
+        QStandardItem *item = addNode(pending.first, pending.second);
+        if (!item)
+            continue;
+
+        // Meshes below a subtree hidden while loading are hidden too
+        if (Qt::Unchecked == item->checkState() &&
+                repo::core::model::NodeType::MESH == pending.second->getTypeAsEnum())
+            hiddenMeshes.push_back(pending.second->getUniqueID());
+
+        const auto children = repoScene->getChildrenAsNodes(
+                    repoScene->getViewGraph(), pending.second->getSharedID());
+        for (auto it = children.rbegin(); it != children.rend(); ++it)
+            pendingNodes.push_back(std::make_pair(item, *it));
+    }
+
+    if (glcWidget && !hiddenMeshes.empty())
+        glcWidget->setMeshVisibility(hiddenMeshes, false);
+    if (!pendingNodes.empty())
+        QTimer::singleShot(0, this, &TreeDockWidget::addPendingNodes);
+}
+
+QStandardItem *TreeDockWidget::addNode(
+        QStandardItem *parentItem,
+        repo::core::model::RepoNode *node)
+{
+    if (!node)
+        return nullptr;
+
+    const repo::core::model::NodeType type = node->getTypeAsEnum();
+    if (repo::core::model::NodeType::MATERIAL == type ||
+            repo::core::model::NodeType::TEXTURE == type)
+        return nullptr;
+
+    QList<QStandardItem*> row;
+
+    //--------------------------------------------------------------------------
+    // Name
+    QString name = QString::fromStdString(node->getName());
+    if (name.isEmpty())
+        name = tr("<empty>");
+    QStandardItem *nameItem = new QStandardItem(name);
+    nameItem->setEditable(false);
+    nameItem->setCheckable(true);
+    nameItem->setData(qVariantFromValue((void *) node));
+    nameItem->setCheckState(parentItem->isCheckable() &&
+                            Qt::Unchecked == parentItem->checkState() ?
+                                Qt::Unchecked : Qt::Checked);
+    if (repo::core::model::NodeType::METADATA == type)
+        nameItem->setIcon(repo::gui::primitive::RepoFontAwesome::getMetadataIcon());
+    row << nameItem;
+
+    //--------------------------------------------------------------------------
+    // Type
+    const QString typeName = QString::fromStdString(node->getType());
+    QStandardItem *typeItem = new QStandardItem(typeName);
+    typeItem->setEditable(false);
+    typeItem->setToolTip(typeName);
+    row << typeItem;
+
+    //--------------------------------------------------------------------------
+    // Unique ID
+    const QString uid = QString::fromStdString(UUIDtoString(node->getUniqueID()));
+    QStandardItem *uidItem = new QStandardItem(uid);
+    uidItem->setEditable(false);
+    uidItem->setToolTip(uid);
+    row << uidItem;
+
+    //--------------------------------------------------------------------------
+    // Shared ID
+    const QString sid = QString::fromStdString(UUIDtoString(node->getSharedID()));
+    QStandardItem *sidItem = new QStandardItem(sid);
+    sidItem->setEditable(false);
+    sidItem->setToolTip(sid);
+    row << sidItem;
+
+    parentItem->appendRow(row);
+    return nameItem;
+}
+
 //void TreeDockWidget::addNode(
 //        QStandardItem* parentItem,
 //        const core::RepoNodeAbstract* node)
@@ -181,26 +284,82 @@ void TreeDockWidget::attachPDF()
 
 void TreeDockWidget::changeItem(QStandardItem* item)
 {
-  /*  QObject::disconnect(ui->filterableTreeWidget->getModel(),
-                     SIGNAL(itemChanged(QStandardItem*)),
-                     this, SLOT(changeItem(QStandardItem*)));
+    if (!item || item->column() != Columns::NAME || !item->isCheckable())
+        return;
+
+    //--------------------------------------------------------------------------
+    // Check states are set silently, the proxy model and the view are told
+    // once per range of siblings instead of once per item
+    QStandardItemModel *model = ui->filterableTreeWidget->getModel();
+    const Qt::CheckState state = item->checkState() == Qt::Unchecked ?
+                Qt::Unchecked : Qt::Checked;
+    std::vector<repoUUID> meshes;
+    std::vector<QStandardItem*> parents;
+    std::vector<QStandardItem*> ancestors;
+    const bool blocked = model->blockSignals(true);
+    setSubtreeCheckState(item, state, meshes, parents);
+    updateParentCheckState(item->parent(), ancestors);
+    model->blockSignals(blocked);
+
+    const QVector<int> roles = { Qt::CheckStateRole };
+    emit model->dataChanged(item->index(), item->index(), roles);
+    for (QStandardItem *parent : parents)
+        emit model->dataChanged(parent->child(0, Columns::NAME)->index(),
+                                parent->child(parent->rowCount() - 1, Columns::NAME)->index(),
+                                roles);
+    for (QStandardItem *ancestor : ancestors)
+        emit model->dataChanged(ancestor->index(), ancestor->index(), roles);
+
+    if (glcWidget && !meshes.empty())
+        glcWidget->setMeshVisibility(meshes, Qt::Checked == state);
+}
+
+void TreeDockWidget::setSubtreeCheckState(
+        QStandardItem *item,
+        Qt::CheckState state,
+        std::vector<repoUUID> &meshes,
+        std::vector<QStandardItem*> &parents)
+{
+    if (item->checkState() != state)
+        item->setCheckState(state);
+
+    repo::core::model::RepoNode *node = getNode(item);
+    if (node && repo::core::model::NodeType::MESH == node->getTypeAsEnum())
+        meshes.push_back(node->getUniqueID());
 
-    switch(item->checkState())
+    if (item->rowCount() > 0)
+        parents.push_back(item);
+    for (int i = 0; i < item->rowCount(); ++i)
     {
-        case Qt::Checked :
-            std::cerr << "checked" << std::endl;
-            break;
-        case Qt::Unchecked :
-            std::cerr << "unchecked" << std::endl;
-            break;
-        case Qt::PartiallyChecked :
-            std::cerr << "partially checked" << std::endl;
-            break;
-    }*/
+        QStandardItem *child = item->child(i, Columns::NAME);
+        if (child)
+            setSubtreeCheckState(child, state, meshes, parents);
+    }
+}
+
+void TreeDockWidget::updateParentCheckState(
+        QStandardItem *item,
+        std::vector<QStandardItem*> &changed)
+{
+    for (; item; item = item->parent())
+    {
+        bool checked = false;
+        bool unchecked = false;
+        for (int i = 0; i < item->rowCount(); ++i)
+        {
+            const QStandardItem *child = item->child(i, Columns::NAME);
+            const Qt::CheckState state = child ? child->checkState() : Qt::Checked;
+            checked |= Qt::Unchecked != state;
+            unchecked |= Qt::Checked != state;
+        }
 
-    //QObject::connect(ui->filterableTreeWidget->getModel(),
-    //                 SIGNAL(itemChanged(QStandardItem*)),
-    //                 this, SLOT(changeItem(QStandardItem*)));
+        const Qt::CheckState state = !unchecked ? Qt::Checked :
+                                     !checked ? Qt::Unchecked : Qt::PartiallyChecked;
+        if (item->checkState() == state)
+            break; // ancestors are up to date
+        item->setCheckState(state);
+        changed.push_back(item);
+    }
 }
 
 void TreeDockWidget::changeSelection(
@@ -306,6 +465,14 @@ void TreeDockWidget::showContextMenu(const QPoint &point)
 }
 
 
+repo::core::model::RepoNode *TreeDockWidget::getNode(const QStandardItem *item) const
+{
+    repo::core::model::RepoNode *node = nullptr;
+    if (item)
+        node = (repo::core::model::RepoNode*) item->data().value<void*>();
+    return node;
+}
+
 //repo::core::RepoNodeTransformation *TreeDockWidget::getTransformationFromSource(
 //        const QModelIndex &sourceIndex) const
 //{
@@ -318,14 +485,6 @@ void TreeDockWidget::showContextMenu(const QPoint &point)
 //    return getTransformation(ui->filterableTreeWidget->getItemFromProxy(proxyIndex, Columns::NAME));
 //}
 //
-//repo::core::RepoNodeAbstract *TreeDockWidget::getNode(const QStandardItem * item) const
-//{
-//    core::RepoNodeAbstract *node = 0;
-//    if (item)
-//        node = (core::RepoNodeAbstract*)item->data(Qt::UserRole+1).value<void*>();
-//    return node;
-//}
-//
 //repo::core::RepoNodeTransformation *TreeDockWidget::getTransformation(
 //        const QStandardItem *item) const
 //{
@@ -23,6 +23,9 @@
 #include <QDockWidget>
 #include <QStandardItem>
 #include <QItemSelection>
+//------------------------------------------------------------------------------
+#include <utility>
+#include <vector>
 
 
 //------------------------------------------------------------------------------
@@ -59,6 +62,10 @@ namespace widget {
 
 		void attachPDF();
 
+		/*!
+		* Shows or hides the meshes below the item as its check state
+		* changes, checking or unchecking all of its descendants alike.
+		*/
 		void changeItem(QStandardItem*);
 
 		void changeSelection(
@@ -81,6 +88,41 @@ namespace widget {
 
 	protected:
 
+		/*!
+		* Adds the row of the node, unchecked if the parent is, and returns
+		* its name item. Returns nullptr for materials and textures.
+		*/
+		QStandardItem *addNode(
+			QStandardItem *parentItem,
+			repo::core::model::RepoNode *node);
+
+		/*!
+		* Adds the next batch of pending nodes and queues their children, then
+		* yields to the event loop until the whole tree is built.
+		*/
+		void addPendingNodes();
+
+		/*!
+		* Sets the check state of all descendants of the item and collects
+		* the unique IDs of the meshes below it, the item included, as well as
+		* the items whose children changed. Emits no signals.
+		*/
+		void setSubtreeCheckState(
+			QStandardItem *item,
+			Qt::CheckState state,
+			std::vector<repoUUID> &meshes,
+			std::vector<QStandardItem*> &parents);
+
+		/*!
+		* Sets ancestors checked, unchecked or partially by their children and
+		* collects those that changed. Emits no signals.
+		*/
+		void updateParentCheckState(
+			QStandardItem *item,
+			std::vector<QStandardItem*> &changed);
+
+		repo::core::model::RepoNode *getNode(const QStandardItem *item) const;
+
 		std::string getType(const QStandardItem *) const;
 
 	private:
@@ -89,6 +131,12 @@ namespace widget {
 
 		Rendering3DWidget* glcWidget;
 
+		//! Scene of the widget, held for as long as the dock is open.
+		repo::core::model::RepoScene *repoScene;
+
+		//! Nodes still to be added below their parent items.
+		std::vector<std::pair<QStandardItem*, repo::core::model::RepoNode*>> pendingNodes;
+
 	};
 }
 } // end namespace gui
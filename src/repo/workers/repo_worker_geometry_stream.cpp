@@ -0,0 +1,225 @@
+/**
+*  Copyright (C) 2015 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "repo_worker_geometry_stream.h"
+#include "../logger/repo_logger.h"
+//------------------------------------------------------------------------------
+#include <set>
+//------------------------------------------------------------------------------
+#include <QElapsedTimer>
+//------------------------------------------------------------------------------
+using namespace repo::worker;
+namespace repoModel = repo::core::model;
+
+GeometryStreamWorker::GeometryStreamWorker(
+	repo::core::model::RepoScene *scene,
+	const std::vector<repo::gui::renderer::RepoStreamIndexEntry> &entries,
+	const std::vector<int> &positions,
+	const std::vector<repo::gui::renderer::RepoCompressedMesh> &compressed)
+	: GLCExportWorker(scene, std::vector<double>()) // offset is in the matrices
+	, entries(entries)
+	, positions(positions)
+	, compressed(compressed)
+{
+	qRegisterMetaType<repo::gui::renderer::RepoStreamedMeshes>();
+}
+
+GeometryStreamWorker::~GeometryStreamWorker() {}
+
+void GeometryStreamWorker::run()
+{
+	repo::gui::renderer::RepoStreamedMeshes meshes;
+
+	if (!cancelled && scene && scene->getRoot(scene->getViewGraph()))
+	{
+		auto gType = scene->getViewGraph();
+		jobsCount = entries.size();
+		done = 0;
+
+		//-------------------------------------------------------------------------
+		// Only meshes without a compressed copy are looked up and converted
+		compressed.resize(entries.size());
+		std::vector<const repoModel::MeshNode*> nodes;
+		std::vector<const repoModel::MeshNode*> found;
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			nodes.push_back(compressed[i].isEmpty() ?
+				dynamic_cast<const repoModel::MeshNode*>(
+					scene->getNodeBySharedID(gType, entries[i].sharedID)) : nullptr);
+			if (nodes.back())
+				found.push_back(nodes.back());
+		}
+
+		std::map<repoUUID, std::vector<GLC_Material*>> mapMaterials = convertMaterials(found);
+
+		for (size_t i = 0; i < entries.size() && !cancelled; ++i)
+		{
+			// Missing meshes come back empty so that they are not asked for again
+			repo::gui::renderer::RepoStreamedMesh mesh;
+			if (!compressed[i].isEmpty())
+				mesh = decodeMesh(compressed[i], entries[i]);
+			else if (nodes[i])
+				mesh = convertMesh(nodes[i], entries[i], mapMaterials);
+			mesh.entry = positions[i];
+			meshes.push_back(mesh);
+			emit progress(++done, jobsCount);
+		}
+
+		//-------------------------------------------------------------------------
+		// Meshes hold copies of the materials they use
+		std::set<GLC_Material*> materials;
+		for (const auto &pair : mapMaterials)
+			materials.insert(pair.second.begin(), pair.second.end());
+		for (GLC_Material *material : materials)
+			if (material->isUnused())
+				delete material;
+	}
+
+	if (cancelled)
+	{
+		for (const auto &mesh : meshes)
+			delete mesh.occurrence;
+	}
+	else
+		emit finished(meshes);
+
+	//-------------------------------------------------------------------------
+	// Done
+	emit RepoAbstractWorker::finished();
+}
+
+std::map<repoUUID, std::vector<GLC_Material*>> GeometryStreamWorker::convertMaterials(
+	const std::vector<const repo::core::model::MeshNode*> &meshes)
+{
+	auto gType = scene->getViewGraph();
+	std::map<repoUUID, std::vector<GLC_Material*>> parentToGLCMaterial;
+	std::map<repoUUID, GLC_Material*> converted;
+
+	for (const repoModel::MeshNode *mesh : meshes)
+	{
+		for (auto child : scene->getChildrenAsNodes(gType, mesh->getSharedID()))
+		{
+			if (cancelled)
+				return parentToGLCMaterial;
+			if (!child || child->getTypeAsEnum() != repoModel::NodeType::MATERIAL)
+				continue;
+
+			// Materials shared by several meshes are converted once per batch
+			auto it = converted.find(child->getUniqueID());
+			if (it == converted.end())
+			{
+				std::map<repoUUID, std::vector<GLC_Texture*>> parentToGLCTexture;
+				for (auto texture : scene->getChildrenAsNodes(gType, child->getSharedID()))
+				{
+					if (!texture || texture->getTypeAsEnum() != repoModel::NodeType::TEXTURE)
+						continue;
+					GLC_Texture* glcTexture = convertGLCTexture((repoModel::TextureNode*)texture);
+					if (glcTexture)
+						parentToGLCTexture[child->getSharedID()].push_back(glcTexture);
+				}
+				it = converted.insert(std::make_pair(child->getUniqueID(), convertGLCMaterial(
+					(repoModel::MaterialNode*)child, parentToGLCTexture))).first;
+			}
+
+			if (!it->second)
+				continue;
+			if (gType == repoModel::RepoScene::GraphType::DEFAULT)
+				parentToGLCMaterial[mesh->getSharedID()].push_back(it->second);
+			else
+				//if stash, use its own unique ID as mapping
+				parentToGLCMaterial[child->getUniqueID()] = std::vector<GLC_Material*>(1, it->second);
+		}
+	}
+	return parentToGLCMaterial;
+}
+
+repo::gui::renderer::RepoStreamedMesh GeometryStreamWorker::convertMesh(
+	const repo::core::model::MeshNode *mesh,
+	const repo::gui::renderer::RepoStreamIndexEntry &entry,
+	std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials)
+{
+	repo::gui::renderer::RepoStreamedMesh streamed;
+	GLC_3DRep *rep = convertGLCMesh(mesh, mapMaterials, streamed.matMap);
+	if (!rep || rep->isEmpty())
+	{
+		delete rep;
+		return streamed;
+	}
+
+	//-------------------------------------------------------------------------
+	// Encoded while the arrays are still in client memory
+	if (repo::gui::renderer::RepoMeshCodec::encode(*rep, streamed.compressed))
+	{
+		for (const auto &pair : streamed.matMap)
+			if (pair.second)
+				streamed.compressed.materialKeys[pair.first] = pair.second->id();
+	}
+
+	placeMesh(rep, entry, streamed);
+	return streamed;
+}
+
+repo::gui::renderer::RepoStreamedMesh GeometryStreamWorker::decodeMesh(
+	const repo::gui::renderer::RepoCompressedMesh &compressed,
+	const repo::gui::renderer::RepoStreamIndexEntry &entry)
+{
+	repo::gui::renderer::RepoStreamedMesh streamed;
+	QElapsedTimer timer;
+	timer.start();
+	GLC_3DRep *rep = repo::gui::renderer::RepoMeshCodec::decode(compressed, streamed.matMap);
+	if (!rep || rep->isEmpty())
+	{
+		delete rep;
+		return streamed;
+	}
+	streamed.decodeTime = timer.nsecsElapsed() / 1000;
+
+	placeMesh(rep, entry, streamed);
+	return streamed;
+}
+
+void GeometryStreamWorker::placeMesh(
+	GLC_3DRep *rep,
+	const repo::gui::renderer::RepoStreamIndexEntry &entry,
+	repo::gui::renderer::RepoStreamedMesh &streamed)
+{
+	for (int i = 0; i < rep->numberOfBody(); ++i)
+	{
+		GLC_Mesh *meshObj = dynamic_cast<GLC_Mesh*>(rep->geomAt(i));
+		if (meshObj)
+			streamed.meshMap[rep->name()] = meshObj;
+	}
+	streamed.vertexCount = rep->numberOfVertex();
+	streamed.faceCount = rep->numberOfFaces();
+
+	//-------------------------------------------------------------------------
+	// One reference instanced at every placement
+	const QString name = rep->name();
+	GLC_StructReference *reference = new GLC_StructReference(rep);
+	streamed.occurrence = new GLC_StructOccurrence(
+		new GLC_StructInstance(new GLC_StructReference(name)));
+	streamed.occurrence->setName(name);
+	for (const std::vector<float> &matrix : entry.matrices)
+	{
+		GLC_StructInstance *instance = new GLC_StructInstance(reference);
+		instance->move(GLC_Matrix4x4(matrix.data()));
+		GLC_StructOccurrence *placement = new GLC_StructOccurrence(instance);
+		placement->setName(name);
+		streamed.occurrence->addChild(placement);
+	}
+}
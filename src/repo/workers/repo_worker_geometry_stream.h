@@ -0,0 +1,105 @@
+/**
+*  Copyright (C) 2015 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+//-----------------------------------------------------------------------------
+#include "repo_worker_glc_export.h"
+#include "../gui/renderers/repo_geometry_streamer.h"
+//-----------------------------------------------------------------------------
+
+namespace repo {
+	namespace worker {
+
+		/*!
+		* Converts a batch of meshes of the streaming index into standalone
+		* occurrences, each holding every placement of its mesh, to be
+		* attached to the root of a live world. Materials and textures are
+		* converted only for the meshes of the batch. Meshes given with a
+		* compressed copy are decoded instead, others are encoded after
+		* conversion. Use with QThreadPool.
+		*/
+		class GeometryStreamWorker : public GLCExportWorker
+		{
+			Q_OBJECT
+
+		public:
+
+			/*!
+			* @param scene scene the index was built from
+			* @param entries index entries to convert
+			* @param positions positions of the entries in the index
+			* @param compressed compressed copies of the entries, empty if none
+			*/
+			GeometryStreamWorker(
+				repo::core::model::RepoScene *scene,
+				const std::vector<repo::gui::renderer::RepoStreamIndexEntry> &entries,
+				const std::vector<int> &positions,
+				const std::vector<repo::gui::renderer::RepoCompressedMesh> &compressed);
+
+			//! Default empty destructor.
+			~GeometryStreamWorker();
+
+			public slots :
+
+			/*!
+			* Converts the meshes and emits finished with all of them unless
+			* cancelled, in which case the converted ones are deleted.
+			*/
+			void run();
+
+		signals:
+
+			//! Emitted with the converted meshes, owned by the receiver.
+			void finished(const repo::gui::renderer::RepoStreamedMeshes &meshes);
+
+		protected:
+
+			/**
+			* Converts the materials below the meshes of the batch, and their
+			* textures, keyed as expected by the mesh conversion.
+			*/
+			std::map<repoUUID, std::vector<GLC_Material*>> convertMaterials(
+				const std::vector<const repo::core::model::MeshNode*> &meshes);
+
+			//! Converts a single mesh, keeping a compressed copy of it.
+			repo::gui::renderer::RepoStreamedMesh convertMesh(
+				const repo::core::model::MeshNode *mesh,
+				const repo::gui::renderer::RepoStreamIndexEntry &entry,
+				std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials);
+
+			//! Decodes a compressed copy of a mesh, timing the decoding.
+			repo::gui::renderer::RepoStreamedMesh decodeMesh(
+				const repo::gui::renderer::RepoCompressedMesh &compressed,
+				const repo::gui::renderer::RepoStreamIndexEntry &entry);
+
+			//! Places the representation at each of the matrices of the entry.
+			void placeMesh(
+				GLC_3DRep *rep,
+				const repo::gui::renderer::RepoStreamIndexEntry &entry,
+				repo::gui::renderer::RepoStreamedMesh &streamed);
+
+			std::vector<repo::gui::renderer::RepoStreamIndexEntry> entries;
+
+			std::vector<int> positions;
+
+			std::vector<repo::gui::renderer::RepoCompressedMesh> compressed;
+
+		}; // end class
+
+	} // end namespace worker
+} // end namespace repo
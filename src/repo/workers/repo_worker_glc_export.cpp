@@ -19,8 +19,11 @@
 // GUI
 #include "repo_worker_glc_export.h"
 #include "../logger/repo_logger.h"
+#include "../gui/renderers/repo_mesh_batch.h"
 #include <maths/glc_geomtools.h>
 
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 
 using namespace repo::worker;
@@ -31,6 +34,69 @@ namespace repoModel = repo::core::model;
 
 //------------------------------------------------------------------------------
 
+//! Meshes with more vertices than this are drawn on their own.
+static const size_t REPO_BATCH_MAX_MESH_VERTICES = 1024;
+
+//! Upper bound of vertices in a single combined mesh.
+static const size_t REPO_BATCH_MAX_BATCH_VERTICES = 65536;
+
+//! Number of grid cells along the longest side of the batchable extent.
+static const int REPO_BATCH_GRID_DIVISIONS = 16;
+
+//! Merged meshes with at least this many mappings are split into chunks.
+static const size_t REPO_CHUNK_MIN_MAPPINGS = 16;
+
+//! Number of chunk grid cells along each axis of a merged mesh.
+static const int REPO_CHUNK_GRID_DIVISIONS = 4;
+
+//! Determinant of the upper 3x3 part of a column major 4x4 matrix.
+static double determinant3x3(const double *m)
+{
+    return m[0] * (m[5] * m[10] - m[9] * m[6])
+            - m[4] * (m[1] * m[10] - m[9] * m[2])
+            + m[8] * (m[1] * m[6] - m[5] * m[2]);
+}
+
+//! Bakes a column major matrix into positions and normals, 3 floats each.
+static void transformGLCVectors(
+    QVector<GLfloat> &positions,
+    QVector<GLfloat> &normals,
+    const GLC_Matrix4x4 &transform)
+{
+    const double *m = transform.getData();
+    for (int i = 0; i + 2 < positions.size(); i += 3)
+    {
+        const double x = positions[i], y = positions[i + 1], z = positions[i + 2];
+        positions[i]     = (GLfloat)(m[0] * x + m[4] * y + m[8] * z + m[12]);
+        positions[i + 1] = (GLfloat)(m[1] * x + m[5] * y + m[9] * z + m[13]);
+        positions[i + 2] = (GLfloat)(m[2] * x + m[6] * y + m[10] * z + m[14]);
+    }
+
+    // Normals go through the cofactor matrix (inverse transpose up to
+    // scale) so that non-uniform scaling keeps them perpendicular
+    const double c[9] = {
+        m[5] * m[10] - m[9] * m[6], m[9] * m[2] - m[1] * m[10], m[1] * m[6] - m[5] * m[2],
+        m[8] * m[6] - m[4] * m[10], m[0] * m[10] - m[8] * m[2], m[4] * m[2] - m[0] * m[6],
+        m[4] * m[9] - m[8] * m[5], m[8] * m[1] - m[0] * m[9], m[0] * m[5] - m[4] * m[1] };
+    for (int i = 0; i + 2 < normals.size(); i += 3)
+    {
+        const double x = normals[i], y = normals[i + 1], z = normals[i + 2];
+        double nx = c[0] * x + c[1] * y + c[2] * z;
+        double ny = c[3] * x + c[4] * y + c[5] * z;
+        double nz = c[6] * x + c[7] * y + c[8] * z;
+        const double length = std::sqrt(nx * nx + ny * ny + nz * nz);
+        if (length > 0)
+        {
+            nx /= length;
+            ny /= length;
+            nz /= length;
+        }
+        normals[i] = (GLfloat)nx;
+        normals[i + 1] = (GLfloat)ny;
+        normals[i + 2] = (GLfloat)nz;
+    }
+}
+
 
 GLCExportWorker::GLCExportWorker(
     repo::core::model::RepoScene* scene,
@@ -213,9 +279,15 @@ GLC_StructOccurrence* GLCExportWorker::convertSceneToOccurance(
     }
 
     //-------------------------------------------------------------------------
-    // Allocate Meshes
+    // Batch small meshes
 
     repoModel::RepoNodeSet meshes = scene->getAllMeshes(repoViewGraph);
+    std::vector<GLC_3DRep*> batches = batchSmallMeshes(
+                scene, meshes, parentToGLCMaterial, meshMap, matMap);
+
+    //-------------------------------------------------------------------------
+    // Allocate Meshes
+
     std::map<repoUUID, std::vector<GLC_3DRep*>> parentToGLCMeshes;
     for (auto &mesh : meshes)
     {
@@ -279,6 +351,7 @@ GLC_StructOccurrence* GLCExportWorker::convertSceneToOccurance(
   //      }
   //  }
 
+    GLC_StructOccurrence *rootOccurrence = nullptr;
     auto rootNode = scene->getRoot(repoViewGraph);
     if(rootNode && offsetVector.size())
     {
@@ -299,11 +372,263 @@ GLC_StructOccurrence* GLCExportWorker::convertSceneToOccurance(
                                 + std::to_string(dOffset[1]) + ", "
                                 + std::to_string(dOffset[2]));
 
-        return createOccurrenceFromNode(scene, &transFormedRoot, parentToGLCMeshes, parentToGLCCameras, meshMap, matMap);
+        rootOccurrence = createOccurrenceFromNode(scene, &transFormedRoot, parentToGLCMeshes, parentToGLCCameras, meshMap, matMap);
+
+    }
+    else
+        rootOccurrence = createOccurrenceFromNode(scene, rootNode, parentToGLCMeshes, parentToGLCCameras, meshMap, matMap);
+
+    //-------------------------------------------------------------------------
+    // Batches are baked relative to the root, hence placed directly below it
+    for (GLC_3DRep *batch : batches)
+    {
+        if (rootOccurrence)
+        {
+            GLC_StructOccurrence *batchOccurrence = new GLC_StructOccurrence(
+                        new GLC_StructInstance(new GLC_StructReference(batch)));
+            batchOccurrence->setName(batch->name());
+            rootOccurrence->addChild(batchOccurrence);
+        }
+        else
+            delete batch;
+    }
+
+    return rootOccurrence;
+}
+
+std::vector<GLC_3DRep*> GLCExportWorker::batchSmallMeshes(
+    repo::core::model::RepoScene *scene,
+    repo::core::model::RepoNodeSet &meshes,
+    std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials,
+    std::map<QString, GLC_Mesh*>     &meshMap,
+    std::map<QString, GLC_Material*> &matMap)
+{
+    std::vector<GLC_3DRep*> batches;
+
+    const repoModel::RepoNode *rootNode = scene->getRoot(scene->getViewGraph());
+    if (cancelled || !rootNode ||
+            rootNode->getTypeAsEnum() != repoModel::NodeType::TRANSFORMATION)
+        return batches;
+
+    //-------------------------------------------------------------------------
+    // Transformations relative to the root
+    std::map<repoUUID, GLC_Matrix4x4> matrices;
+    std::set<repoUUID> ambiguous;
+    matrices[rootNode->getSharedID()] = GLC_Matrix4x4();
+    for (auto child : scene->getChildrenAsNodes(scene->getViewGraph(), rootNode->getSharedID()))
+        collectRootMatrices(scene, child, GLC_Matrix4x4(), matrices, ambiguous);
+
+    //-------------------------------------------------------------------------
+    // Candidates: small, untextured, single parent with a direct transform
+    struct Candidate
+    {
+        const repoModel::MeshNode *mesh;
+        const GLC_Matrix4x4 *matrix;
+        QString materialKey;
+        double center[3];
+        size_t vertices;
+    };
+    std::vector<Candidate> candidates;
+    double lower[3] = { 0, 0, 0 }, upper[3] = { 0, 0, 0 };
+
+    for (auto &node : meshes)
+    {
+        const repoModel::MeshNode *mesh = (const repoModel::MeshNode*)node;
+        if (!mesh || cancelled)
+            continue;
+
+        std::vector<repoUUID> parents = mesh->getParentIDs();
+        if (parents.size() != 1 || ambiguous.count(parents[0]))
+            continue;
+
+        auto matrixIt = matrices.find(parents[0]);
+        if (matrixIt == matrices.end() || determinant3x3(matrixIt->second.getData()) <= 0)
+            continue; // mirrored transformations would flip the winding
+
+        std::vector<repo_vector_t> vertices = mesh->getVertices();
+        if (vertices.empty() || vertices.size() > REPO_BATCH_MAX_MESH_VERTICES
+                || mesh->getNormals().size() != vertices.size()
+                || !mesh->getColors().empty()
+                || !mesh->getUVChannels().empty()
+                || !mesh->getMeshMapping().empty())
+            continue;
+
+        QString materialKey = getBatchMaterialKey(mesh, mapMaterials);
+        if (materialKey.isEmpty())
+            continue;
+
+        double localLower[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+        double localUpper[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+        for (const repo_vector_t &v : vertices)
+        {
+            const double p[3] = { v.x, v.y, v.z };
+            for (int i = 0; i < 3; ++i)
+            {
+                localLower[i] = std::min(localLower[i], p[i]);
+                localUpper[i] = std::max(localUpper[i], p[i]);
+            }
+        }
+
+        Candidate candidate;
+        candidate.mesh = mesh;
+        candidate.matrix = &matrixIt->second;
+        candidate.materialKey = materialKey;
+        candidate.vertices = vertices.size();
+
+        const double *m = matrixIt->second.getData();
+        const double x = (localLower[0] + localUpper[0]) / 2;
+        const double y = (localLower[1] + localUpper[1]) / 2;
+        const double z = (localLower[2] + localUpper[2]) / 2;
+        for (int i = 0; i < 3; ++i)
+        {
+            candidate.center[i] = m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i];
+            lower[i] = candidates.empty() ? candidate.center[i] : std::min(lower[i], candidate.center[i]);
+            upper[i] = candidates.empty() ? candidate.center[i] : std::max(upper[i], candidate.center[i]);
+        }
+        candidates.push_back(candidate);
+    }
+
+    if (candidates.size() < 2)
+        return batches;
+
+    //-------------------------------------------------------------------------
+    // Group by material and grid cell
+    const double extent = std::max(upper[0] - lower[0],
+                                   std::max(upper[1] - lower[1], upper[2] - lower[2]));
+    const double cellSize = extent > 0 ? extent / REPO_BATCH_GRID_DIVISIONS : 1.0;
+
+    std::map<QString, std::vector<const Candidate*>> groups;
+    for (const Candidate &candidate : candidates)
+    {
+        QString key = candidate.materialKey;
+        for (int i = 0; i < 3; ++i)
+            key += "|" + QString::number((int) std::floor((candidate.center[i] - lower[i]) / cellSize));
+        groups[key].push_back(&candidate);
+    }
+
+    //-------------------------------------------------------------------------
+    // Combine
+    size_t batchedMeshes = 0;
+    for (auto &group : groups)
+    {
+        std::vector<const Candidate*> &members = group.second;
+        size_t first = 0;
+        while (first < members.size() && !cancelled)
+        {
+            size_t last = first;
+            size_t vertexCount = 0;
+            while (last < members.size() &&
+                   vertexCount + members[last]->vertices <= REPO_BATCH_MAX_BATCH_VERTICES)
+                vertexCount += members[last++]->vertices;
+
+            if (last - first > 1)
+            {
+                // Members render alike, hence share the first one's material
+                auto mapIt = mapMaterials.find(members[first]->mesh->getSharedID());
+                GLC_Material *material = mapIt != mapMaterials.end() && !mapIt->second.empty() ?
+                            new GLC_Material(*mapIt->second.at(0)) : new GLC_Material();
+                material->setId(glc::GLC_GenID());
+                repo::gui::renderer::RepoMeshBatch *glcMesh =
+                        new repo::gui::renderer::RepoMeshBatch(material);
+                glcMesh->setName("batch_" + QString::number(batches.size()));
+                material->setName(glcMesh->name());
+                matMap[glcMesh->name()] = material;
+
+                for (size_t i = first; i < last; ++i)
+                {
+                    const repoModel::MeshNode *mesh = members[i]->mesh;
+                    QVector<GLfloat> glcVec = createGLCVector(mesh->getVertices());
+                    QVector<GLfloat> glcNorm = createGLCVector(mesh->getNormals());
+                    const QList<GLuint> glcFaces = createGLCFaceList(mesh->getFaces(), glcVec);
+                    transformGLCVectors(glcVec, glcNorm, *members[i]->matrix);
+                    glcMesh->addMember(QString::fromStdString(UUIDtoString(mesh->getUniqueID())),
+                                       glcVec, glcNorm, glcFaces);
+                }
+                glcMesh->build();
 
+                for (size_t i = first; i < last; ++i)
+                {
+                    meshMap[QString::fromStdString(UUIDtoString(members[i]->mesh->getUniqueID()))] = glcMesh;
+                    meshes.erase((repoModel::RepoNode*)members[i]->mesh);
+                }
+                meshMap[glcMesh->name()] = glcMesh;
+                batchedMeshes += last - first;
+
+                GLC_3DRep *pRep = new GLC_3DRep(glcMesh);
+                pRep->setName(glcMesh->name());
+                pRep->clean();
+                batches.push_back(pRep);
+            }
+            first = last > first ? last : first + 1;
+        }
     }
+
+    if (batches.size())
+        repoLog("Batched " + std::to_string(batchedMeshes) + " small meshes into "
+                + std::to_string(batches.size()) + " combined meshes");
+
+    return batches;
+}
+
+void GLCExportWorker::collectRootMatrices(
+    repo::core::model::RepoScene *scene,
+    const repo::core::model::RepoNode *node,
+    const GLC_Matrix4x4 &parentMatrix,
+    std::map<repoUUID, GLC_Matrix4x4> &matrices,
+    std::set<repoUUID> &ambiguous)
+{
+    if (!node || node->getTypeAsEnum() != repoModel::NodeType::TRANSFORMATION)
+        return;
+
+    GLC_Matrix4x4 matrix = parentMatrix;
+    auto mat = ((const repoModel::TransformationNode*) node)->getTransMatrix(true);
+    if (mat.size() == 16)
+        matrix = parentMatrix * GLC_Matrix4x4(mat.data());
+
+    const repoUUID sharedID = node->getSharedID();
+    if (matrices.find(sharedID) != matrices.end())
+        ambiguous.insert(sharedID);
     else
-        return createOccurrenceFromNode(scene, rootNode, parentToGLCMeshes, parentToGLCCameras, meshMap, matMap);
+        matrices[sharedID] = matrix;
+
+    for (auto child : scene->getChildrenAsNodes(scene->getViewGraph(), sharedID))
+        collectRootMatrices(scene, child, matrix, matrices, ambiguous);
+}
+
+QString GLCExportWorker::getBatchMaterialKey(
+    const repo::core::model::MeshNode *mesh,
+    std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials)
+{
+    std::vector<repoUUID> materialIDs;
+    auto mapping = mesh->getMeshMapping();
+    if (mapping.size() > 0)
+        for (const repo_mesh_mapping_t &map : mapping)
+            materialIDs.push_back(map.material_id);
+    else
+        materialIDs.push_back(mesh->getSharedID());
+
+    QString key;
+    for (const repoUUID &id : materialIDs)
+    {
+        auto mapIt = mapMaterials.find(id);
+        if (mapIt == mapMaterials.end() || mapIt->second.empty())
+        {
+            key += "default;";
+            continue;
+        }
+
+        const GLC_Material *material = mapIt->second.at(0);
+        if (material->hasTexture())
+            return QString();
+
+        key += material->ambientColor().name(QColor::HexArgb)
+                + material->diffuseColor().name(QColor::HexArgb)
+                + material->specularColor().name(QColor::HexArgb)
+                + material->emissiveColor().name(QColor::HexArgb)
+                + QString::number(material->shininess())
+                + QString::number(material->opacity()) + ";";
+    }
+    return key;
 }
 
 GLC_StructOccurrence* GLCExportWorker::createOccurrenceFromNode(
@@ -599,144 +924,309 @@ GLC_3DRep* GLCExportWorker::convertGLCMesh(
     std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials,
     std::map<QString, GLC_Material*> &matMap)
 {
+	// Merged stash meshes are split so that the renderer can cull parts
+	if (mesh && mesh->getMeshMapping().size() >= REPO_CHUNK_MIN_MAPPINGS)
+	{
+		GLC_3DRep *chunked = convertGLCMeshChunks(mesh, mapMaterials, matMap);
+		if (chunked)
+			return chunked;
+	}
 
 	GLC_Mesh * glcMesh = new GLC_Mesh;
-    if (mesh)
+	// Meshes without faces are point clouds, drawn by RepoPointCloud
+    if (mesh && !mesh->getFaces().empty())
     {
-		std::string name = mesh->getName();
 		glcMesh->setName(QString::fromStdString(UUIDtoString(mesh->getUniqueID())));
+		appendGLCMesh(glcMesh, mesh, mapMaterials, matMap);
+		glcMesh->finish();
+    }
+
+	GLC_3DRep* pRep = new GLC_3DRep(glcMesh);
+	glcMesh = NULL;
+	pRep->clean();
+	return pRep;
+}
+
+GLC_3DRep* GLCExportWorker::convertGLCMeshChunks(
+	const repo::core::model::MeshNode *mesh,
+	std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials,
+	std::map<QString, GLC_Material*> &matMap)
+{
+	auto mapping = mesh->getMeshMapping();
+	std::vector<repo_vector_t> vertices = mesh->getVertices();
+	std::vector<repo_vector_t> normals = mesh->getNormals();
+	std::vector<repo_color4d_t> colors = mesh->getColors();
+	std::vector<repo_vector2d_t> uvs = mesh->getUVChannels();
+	std::vector<repo_face_t> faces = mesh->getFaces();
+
+	const bool hasNormals = normals.size() == vertices.size();
+	const bool hasColors = colors.size() == vertices.size();
+	const bool hasUVs = uvs.size() == vertices.size();
+
+	//-------------------------------------------------------------------------
+	// Mesh bounds from the mapping bounds, the ranges must be consistent
+	double lower[3], upper[3];
+	for (size_t m = 0; m < mapping.size(); ++m)
+	{
+		const repo_mesh_mapping_t &map = mapping[m];
+		if (map.vertFrom < 0 || map.vertTo > (int32_t)vertices.size() || map.vertFrom > map.vertTo
+			|| map.triFrom < 0 || map.triTo > (int32_t)faces.size() || map.triFrom > map.triTo)
+		{
+			repoLogError("Invalid mesh mapping range, the mesh will not be split");
+			return nullptr;
+		}
+		const double mapLower[3] = { map.min.x, map.min.y, map.min.z };
+		const double mapUpper[3] = { map.max.x, map.max.y, map.max.z };
+		for (int i = 0; i < 3; ++i)
+		{
+			lower[i] = m ? std::min(lower[i], mapLower[i]) : mapLower[i];
+			upper[i] = m ? std::max(upper[i], mapUpper[i]) : mapUpper[i];
+		}
+	}
+
+	//-------------------------------------------------------------------------
+	// Group mappings into chunks by the grid cell of their centre
+	std::map<int, std::vector<const repo_mesh_mapping_t*>> chunks;
+	for (const repo_mesh_mapping_t &map : mapping)
+	{
+		const double center[3] = {
+			(map.min.x + map.max.x) / 2, (map.min.y + map.max.y) / 2, (map.min.z + map.max.z) / 2 };
+		int cell = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			const double extent = upper[i] - lower[i];
+			int c = extent > 0 ?
+				(int)((center[i] - lower[i]) / extent * REPO_CHUNK_GRID_DIVISIONS) : 0;
+			c = std::max(0, std::min(REPO_CHUNK_GRID_DIVISIONS - 1, c));
+			cell = cell * REPO_CHUNK_GRID_DIVISIONS + c;
+		}
+		chunks[cell].push_back(&map);
+	}
+
+	//-------------------------------------------------------------------------
+	// One body per chunk holding only the vertices of its mappings
+	const QString name = QString::fromStdString(UUIDtoString(mesh->getUniqueID()));
+	GLC_3DRep* pRep = nullptr;
+	for (const auto &chunk : chunks)
+	{
+		GLC_Mesh *glcMesh = new GLC_Mesh;
+		glcMesh->setName(name);
+
+		QVector<GLfloat> glcVec, glcNorm, glcCol, glcUV;
+		std::vector<std::pair<GLC_Material*, QList<GLuint>>> triangles;
+		GLfloatVector faceVertices;
+		std::vector<GLfloatVector> wireframe;
 
-        std::vector<repo_vector_t> vector3d;
-		//Vertices
-		vector3d = mesh->getVertices();
-		QVector<GLfloat> glcVec = createGLCVector(vector3d);
-		if (glcVec.size() > 0)
-			glcMesh->addVertice(glcVec);
+		for (const repo_mesh_mapping_t *map : chunk.second)
+		{
+			const int32_t base = glcVec.size() / 3;
+			for (int32_t v = map->vertFrom; v < map->vertTo; ++v)
+			{
+				glcVec << vertices[v].x << vertices[v].y << vertices[v].z;
+				if (hasNormals)
+					glcNorm << normals[v].x << normals[v].y << normals[v].z;
+				if (hasColors)
+					glcCol << colors[v].r << colors[v].g << colors[v].b << colors[v].a;
+				if (hasUVs)
+					glcUV << uvs[v].x << uvs[v].y;
+			}
 
-		//Normals
-        std::vector<repo_vector_t> normal3d = mesh->getNormals();
-		QVector<GLfloat> glcNorm = createGLCVector(normal3d);
+			// Stash faces index the whole mesh, rebase onto the chunk
+			std::vector<repo_face_t> chunkFaces(faces.begin() + map->triFrom, faces.begin() + map->triTo);
+			for (repo_face_t &face : chunkFaces)
+			{
+				for (uint32_t j = 0; j < face.size(); ++j)
+				{
+					// Faces reaching outside their mapping cannot be rebased
+					if (face[j] < (uint32_t)map->vertFrom || face[j] >= (uint32_t)map->vertTo)
+					{
+						repoLogError("Face index outside its mesh mapping, the mesh will not be split");
+						delete glcMesh;
+						delete pRep;
+						return nullptr;
+					}
+					face[j] = face[j] - map->vertFrom + base;
+					const int v = face[j] * 3;
+					faceVertices << glcVec[v] << glcVec[v + 1] << glcVec[v + 2];
+				}
+				wireframe.push_back(faceVertices);
+				faceVertices.clear();
+			}
+
+			triangles.push_back(std::make_pair(
+				getMappingMaterial(*map, mapMaterials, matMap),
+				createGLCFaceList(chunkFaces, glcVec)));
+		}
+
+		glcMesh->addVertice(glcVec);
 		if (glcNorm.size() > 0)
 			glcMesh->addNormals(glcNorm);
-
-		//Colors
-        std::vector<repo_color4d_t> colors;
-		colors = mesh->getColors();
-		QVector<GLfloat> glcCol = createGLCVector(colors);
 		if (glcCol.size() > 0)
 		{
 			glcMesh->setColorPearVertex(true);
 			glcMesh->addColors(glcCol);
 		}
+		if (glcUV.size() > 0)
+			glcMesh->addTexels(glcUV);
+		for (auto &group : triangles)
+			glcMesh->addTriangles(group.first, group.second);
+		for (const GLfloatVector &group : wireframe)
+			glcMesh->addVerticeGroup(group);
+		glcMesh->finish();
 
-		//faces
-        std::vector<repo_face_t> faces;
-		faces = mesh->getFaces();
+		if (pRep)
+			pRep->addGeom(glcMesh);
+		else
+			pRep = new GLC_3DRep(glcMesh);
+	}
+
+	if (pRep)
+	{
+		pRep->setName(name);
+		pRep->clean();
+	}
+	return pRep;
+}
 
-		auto mapping = mesh->getMeshMapping();
-		if (mapping.size() > 0)
+GLC_Material* GLCExportWorker::getMappingMaterial(
+	const repo_mesh_mapping_t &map,
+	std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials,
+	std::map<QString, GLC_Material*> &matMap)
+{
+	GLC_Material* material = nullptr;
+	QString meshId = QString::fromStdString(UUIDtoString(map.mesh_id));
+	std::map<repoUUID, std::vector<GLC_Material*>>::iterator mapIt =
+		mapMaterials.find(map.material_id);
+	if (matMap.find(meshId) != matMap.end())
+	{
+		//We've seen this meshId before -> an instance.
+		//apply the same GLC_Material instance
+		material = matMap[meshId];
+	}
+	else
+	{
+		if (mapIt != mapMaterials.end())
 		{
-			for (const repo_mesh_mapping_t &map : mapping)
-			{
-				
-				QList<GLuint> glcFaces = createGLCFaceList(faces, glcVec, map.triFrom, map.triTo);
-
-				GLC_Material* material = nullptr;
-                QString meshId = QString::fromStdString(UUIDtoString(map.mesh_id));
-				std::map<repoUUID, std::vector<GLC_Material*>>::iterator mapIt =
-					mapMaterials.find(map.material_id);
-                if(matMap.find(meshId) != matMap.end())
-                {
-                    //We've seen this meshId before -> an instance.
-                    //apply the same GLC_Material instance
-                    material = matMap[meshId];
-                }
-                else
-                {
-                    if (mapIt != mapMaterials.end())
-                    {
-                        material = new GLC_Material(*mapIt->second.at(0));
+			material = new GLC_Material(*mapIt->second.at(0));
 
-                        material->setId(glc::GLC_GenID());
-                    }
-                    else
-                    {
-                        material = new GLC_Material();
-                    }
-                    material->setName(meshId);
-                    matMap[meshId] = material;
-                }
-
-				glcMesh->addTriangles(material, glcFaces);
-
-			}
+			material->setId(glc::GLC_GenID());
 		}
 		else
 		{
+			material = new GLC_Material();
+		}
+		material->setName(meshId);
+		matMap[meshId] = material;
+	}
+	return material;
+}
 
+void GLCExportWorker::appendGLCMesh(
+	GLC_Mesh *glcMesh,
+	const repo::core::model::MeshNode *mesh,
+	std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials,
+	std::map<QString, GLC_Material*> &matMap)
+{
+	if (!glcMesh || !mesh)
+		return;
+
+	//Vertices
+	std::vector<repo_vector_t> vector3d = mesh->getVertices();
+	QVector<GLfloat> glcVec = createGLCVector(vector3d);
+
+	//Normals
+	std::vector<repo_vector_t> normal3d = mesh->getNormals();
+	QVector<GLfloat> glcNorm = createGLCVector(normal3d);
+
+	if (glcVec.size() > 0)
+		glcMesh->addVertice(glcVec);
+
+	if (glcNorm.size() > 0)
+		glcMesh->addNormals(glcNorm);
+
+	//Colors
+    std::vector<repo_color4d_t> colors;
+	colors = mesh->getColors();
+	QVector<GLfloat> glcCol = createGLCVector(colors);
+	if (glcCol.size() > 0)
+	{
+		glcMesh->setColorPearVertex(true);
+		glcMesh->addColors(glcCol);
+	}
+
+	//faces
+    std::vector<repo_face_t> faces;
+	faces = mesh->getFaces();
+
+	auto mapping = mesh->getMeshMapping();
+	if (mapping.size() > 0)
+	{
+		for (const repo_mesh_mapping_t &map : mapping)
+		{
+			
+			QList<GLuint> glcFaces = createGLCFaceList(faces, glcVec, map.triFrom, map.triTo);
 
-			QList<GLuint> glcFaces = createGLCFaceList(faces, glcVec);
+			GLC_Material* material = getMappingMaterial(map, mapMaterials, matMap);
+			glcMesh->addTriangles(material, glcFaces);
 
-            QString meshUniqueID = QString::fromStdString(UUIDtoString(mesh->getUniqueID()));
-			if (glcFaces.size() > 0)
-			{
-				GLC_Material* material = nullptr;
-				std::map<repoUUID, std::vector<GLC_Material*>>::iterator mapIt =
-					mapMaterials.find(mesh->getSharedID());
-				if (mapIt != mapMaterials.end())
-				{
-                    material = new GLC_Material(*mapIt->second.at(0));
-				}
-                else
-                {
-                    material = new GLC_Material();
-
-                }
-                material->setName(meshUniqueID);
-				glcMesh->addTriangles(material, glcFaces);
-                matMap[meshUniqueID] = material;
-			}
 		}
+	}
+	else
+	{
 
 
-		//---------------------------------------------------------------------
-		// Wireframe
-		// Since GLC_Lib renders only triangles, the wireframe for polygon
-		// faces has to be created separately.
-		GLfloatVector faceVertices;
-        for (auto &face : faces)
+		QList<GLuint> glcFaces = createGLCFaceList(faces, glcVec);
+
+        QString meshUniqueID = QString::fromStdString(UUIDtoString(mesh->getUniqueID()));
+		if (glcFaces.size() > 0)
 		{
-            for (uint32_t j = 0; j < face.size(); ++j)
+			GLC_Material* material = nullptr;
+			std::map<repoUUID, std::vector<GLC_Material*>>::iterator mapIt =
+				mapMaterials.find(mesh->getSharedID());
+			if (mapIt != mapMaterials.end())
 			{
-				//FIXME: this is assuming order in assimp's mVertice = vector3d's order
-                repo_vector_t vertex = vector3d[face[j]];
-				faceVertices << vertex.x << vertex.y << vertex.z;
+                material = new GLC_Material(*mapIt->second.at(0));
 			}
+            else
+            {
+                material = new GLC_Material();
 
-			glcMesh->addVerticeGroup(faceVertices);
-			faceVertices.clear();
+            }
+            material->setName(meshUniqueID);
+			glcMesh->addTriangles(material, glcFaces);
+            matMap[meshUniqueID] = material;
 		}
-		
+	}
 
-        std::vector<repo_vector2d_t> uvVectors = mesh->getUVChannels();
-		QVector<GLfloat> glcUVVec = createGLCVector(uvVectors);
 
-		if (glcUVVec.size() > 0)
+	//---------------------------------------------------------------------
+	// Wireframe
+	// Since GLC_Lib renders only triangles, the wireframe for polygon
+	// faces has to be created separately.
+	GLfloatVector faceVertices;
+    for (auto &face : faces)
+	{
+        for (uint32_t j = 0; j < face.size(); ++j)
 		{
-			glcMesh->addTexels(glcUVVec);
+			//FIXME: this is assuming order in assimp's mVertice = vector3d's order
+			const int v = face[j] * 3;
+			faceVertices << glcVec[v] << glcVec[v + 1] << glcVec[v + 2];
 		}
 
-		glcMesh->finish();
+		glcMesh->addVerticeGroup(faceVertices);
+		faceVertices.clear();
+	}
+	
 
-    }
+    std::vector<repo_vector2d_t> uvVectors = mesh->getUVChannels();
+	QVector<GLfloat> glcUVVec = createGLCVector(uvVectors);
 
-	GLC_3DRep* pRep = new GLC_3DRep(glcMesh);
-	glcMesh = NULL;
-	pRep->clean();
-	return pRep;
+	if (glcUVVec.size() > 0)
+	{
+		glcMesh->addTexels(glcUVVec);
+	}
 }
 
-
 QList<GLuint> GLCExportWorker::createGLCFaceList(
     const std::vector<repo_face_t> &faces,
     const QVector<GLfloat>         &vertices,
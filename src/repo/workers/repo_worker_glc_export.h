@@ -26,6 +26,8 @@
 #include <repo/core/model/bson/repo_node_texture.h>
 #include <repo/core/model/bson/repo_node_transformation.h>
 
+#include <set>
+
 #include <QImage>
 #include <GLC_World>
 #include <glc_factory.h>
@@ -95,7 +97,7 @@ namespace repo {
                           std::map<QString, GLC_Mesh*>&,
                           std::map<QString, GLC_Material*>&);
 
-		private:
+		protected:
 			repo::core::model::RepoScene* scene;
             const std::vector<double> offsetVector;
 
@@ -104,6 +106,55 @@ namespace repo {
                 std::map<QString, GLC_Mesh*>     &meshMap,
                 std::map<QString, GLC_Material*> &matMap);
 
+			/**
+			* Merges small static meshes that share a material and a spatial
+			* cell into combined meshes baked into the root coordinate space,
+			* so tens of thousands of tiny meshes cost a handful of bodies,
+			* instances and draws rather than one each. Members share one
+			* material group registered under the batch name and are kept as
+			* sub-ranges (see RepoMeshBatch). Their meshMap entries point to
+			* the combined mesh, hence picking, highlighting and recolouring
+			* still address individual meshes.
+			* Batched meshes are removed from the given set.
+			* @return returns the combined representations, identity placed
+			*         under the root
+			*/
+			std::vector<GLC_3DRep*> batchSmallMeshes(
+				repo::core::model::RepoScene *scene,
+				repo::core::model::RepoNodeSet &meshes,
+				std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials,
+				std::map<QString, GLC_Mesh*>     &meshMap,
+				std::map<QString, GLC_Material*> &matMap);
+
+			/**
+			* Collects matrices of all transformations below the root relative
+			* to the root. Transformations reachable along several paths are
+			* recorded as ambiguous.
+			*/
+			void collectRootMatrices(
+				repo::core::model::RepoScene *scene,
+				const repo::core::model::RepoNode *node,
+				const GLC_Matrix4x4 &parentMatrix,
+				std::map<repoUUID, GLC_Matrix4x4> &matrices,
+				std::set<repoUUID> &ambiguous);
+
+			/**
+			* Returns a key identical for meshes whose materials render the same,
+			* empty if the mesh cannot be batched (e.g. textured).
+			*/
+			QString getBatchMaterialKey(
+				const repo::core::model::MeshNode *mesh,
+				std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials);
+
+			/**
+			* Appends geometry and materials of a repo mesh to a GLC mesh.
+			*/
+			void appendGLCMesh(
+				GLC_Mesh *glcMesh,
+				const repo::core::model::MeshNode *mesh,
+				std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials,
+				std::map<QString, GLC_Material*> &matMap);
+
 			GLC_3DRep* convertGLCCamera(
 				const repo::core::model::CameraNode *camera);
 
@@ -116,6 +167,26 @@ namespace repo {
                 std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials,
                  std::map<QString, GLC_Material*> &matMap);
 
+			/**
+			* Converts a merged (stash) mesh into one body per spatial chunk of
+			* its mappings, so that the bounds of each chunk can be culled on
+			* their own.
+			* @return returns nullptr if the mappings are inconsistent
+			*/
+			GLC_3DRep* convertGLCMeshChunks(
+				const repo::core::model::MeshNode *mesh,
+				std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials,
+				std::map<QString, GLC_Material*> &matMap);
+
+			/**
+			* Returns the material of a mapping, named after its mesh ID and
+			* shared by all instances of that mesh.
+			*/
+			GLC_Material* getMappingMaterial(
+				const repo_mesh_mapping_t &map,
+				std::map<repoUUID, std::vector<GLC_Material*>> &mapMaterials,
+				std::map<QString, GLC_Material*> &matMap);
+
 			GLC_Texture* convertGLCTexture(
 				const repo::core::model::TextureNode *texture);
 
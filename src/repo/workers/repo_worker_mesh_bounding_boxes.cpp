@@ -0,0 +1,111 @@
+/**
+*  Copyright (C) 2015 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "repo_worker_mesh_bounding_boxes.h"
+#include "../logger/repo_logger.h"
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <repo/core/model/repo_node_utils.h>
+//------------------------------------------------------------------------------
+using namespace repo::worker;
+
+//! Appends the axis aligned box of two transformed corners.
+static void appendBox(
+	std::vector<float> &boxes,
+	const std::vector<float> &matrix,
+	const repo_vector_t &min,
+	const repo_vector_t &max)
+{
+	const repo_vector_t a = multiplyMatVec(matrix, min);
+	const repo_vector_t b = multiplyMatVec(matrix, max);
+	boxes.push_back(std::min(a.x, b.x));
+	boxes.push_back(std::min(a.y, b.y));
+	boxes.push_back(std::min(a.z, b.z));
+	boxes.push_back(std::max(a.x, b.x));
+	boxes.push_back(std::max(a.y, b.y));
+	boxes.push_back(std::max(a.z, b.z));
+}
+
+MeshBoundingBoxesWorker::MeshBoundingBoxesWorker(
+	const repo::core::model::RepoScene *scene,
+	const std::vector<double> &offset)
+	: SceneMeshWorker(scene, offset)
+{
+	qRegisterMetaType<repo::gui::renderer::RepoLineOverlayData>();
+}
+
+MeshBoundingBoxesWorker::~MeshBoundingBoxesWorker() {}
+
+void MeshBoundingBoxesWorker::run()
+{
+	repo::gui::renderer::RepoLineOverlayData data;
+
+	//-------------------------------------------------------------------------
+	// Start
+	// Min and max corners of the boxes of every level, 6 floats per box
+	std::vector<std::vector<float>> levels;
+	if (traverseMeshes([&](const repo::core::model::MeshNode *mesh,
+		const std::vector<float> &matrix, size_t level)
+		{ collectBoxes(mesh, matrix, level, levels); }))
+	{
+		// Empty levels are dropped so that every level has something to show
+		for (const std::vector<float> &boxes : levels)
+		{
+			if (boxes.empty())
+				continue;
+			for (size_t i = 0; i + 5 < boxes.size(); i += 6)
+				data.addBox(&boxes[i], &boxes[i + 3]);
+			data.endLevel();
+		}
+
+		repoLog("Collected " + std::to_string(data.vertices.size() / 72)
+			+ " mesh bounding boxes in " + std::to_string(data.levelOffsets.size()) + " levels");
+		emit progress(getJobsCount(), getJobsCount());
+	}
+
+	if (!cancelled)
+		emit finished(data);
+
+	//-------------------------------------------------------------------------
+	// Done
+	emit RepoAbstractWorker::finished();
+}
+
+void MeshBoundingBoxesWorker::collectBoxes(
+	const repo::core::model::MeshNode *meshPtr,
+	const std::vector<float> &matrix,
+	size_t level,
+	std::vector<std::vector<float>> &levels)
+{
+	if (levels.size() <= level)
+		levels.resize(level + 1);
+
+	auto mappings = meshPtr->getMeshMapping();
+	if (mappings.size() > 1)
+	{
+		for (const auto &map : mappings)
+			appendBox(levels[level], matrix, map.min, map.max);
+	}
+	else
+	{
+		//single mesh, visualise this mesh's bounding box
+		auto currentBox = meshPtr->getBoundingBox();
+		if (currentBox.size() >= 2)
+			appendBox(levels[level], matrix, currentBox[0], currentBox[1]);
+	}
+}
@@ -0,0 +1,87 @@
+/**
+*  Copyright (C) 2015 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Collects bounding boxes of all meshes (or mesh mappings) of a scene into a
+* single line overlay.
+*/
+#pragma once
+
+//------------------------------------------------------------------------------
+// Core
+#include <repo/core/model/collection/repo_scene.h>
+
+//-----------------------------------------------------------------------------
+#include "repo_worker_scene_mesh.h"
+#include "../gui/renderers/repo_line_overlay.h"
+//-----------------------------------------------------------------------------
+
+namespace repo {
+	namespace worker {
+
+		/*!
+		* Worker class to gather the bounding boxes of every mesh of a scene as
+		* a single line list, grouped by the depth of the mesh in the scene
+		* graph. Use with QThreadPool.
+		*/
+		class MeshBoundingBoxesWorker : public SceneMeshWorker {
+
+			Q_OBJECT
+
+		public:
+
+			/*!
+			* @param scene scene to collect the bounding boxes of
+			* @param offset translation applied to all boxes, can be empty
+			*/
+			MeshBoundingBoxesWorker(
+				const repo::core::model::RepoScene *scene,
+				const std::vector<double> &offset);
+
+			//! Default empty destructor.
+			~MeshBoundingBoxesWorker();
+
+			public slots :
+
+			/*!
+			* Collects the boxes and emits finished with the result unless
+			* cancelled.
+			*/
+			void run();
+
+		signals:
+
+			//! Emitted with all boxes once the collection is finished.
+			void finished(const repo::gui::renderer::RepoLineOverlayData &data);
+
+		private:
+
+			/**
+			* Collects the box of the mesh, or of each of its mappings.
+			* @param matrix world transformation, row major
+			* @param level depth of the mesh below the root
+			*/
+			void collectBoxes(
+				const repo::core::model::MeshNode *meshPtr,
+				const std::vector<float> &matrix,
+				size_t level,
+				std::vector<std::vector<float>> &levels);
+
+		}; // end class
+
+	} // end namespace worker
+} // end namespace repo
@@ -0,0 +1,137 @@
+/**
+*  Copyright (C) 2015 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "repo_worker_mesh_index.h"
+#include "../logger/repo_logger.h"
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <limits>
+#include <repo/core/model/repo_node_utils.h>
+//------------------------------------------------------------------------------
+using namespace repo::worker;
+
+//! Grows the entry bounds by the transformed corners of a box.
+static void growBounds(
+	repo::gui::renderer::RepoStreamIndexEntry &entry,
+	const std::vector<float> &matrix,
+	const repo_vector_t &min,
+	const repo_vector_t &max)
+{
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		repo_vector_t v;
+		v.x = (corner & 1) ? max.x : min.x;
+		v.y = (corner & 2) ? max.y : min.y;
+		v.z = (corner & 4) ? max.z : min.z;
+		const repo_vector_t p = multiplyMatVec(matrix, v);
+		const float point[3] = { p.x, p.y, p.z };
+		for (int i = 0; i < 3; ++i)
+		{
+			entry.lower[i] = std::min(entry.lower[i], point[i]);
+			entry.upper[i] = std::max(entry.upper[i], point[i]);
+		}
+	}
+}
+
+MeshIndexWorker::MeshIndexWorker(
+	const repo::core::model::RepoScene *scene,
+	const std::vector<double> &offset)
+	: SceneMeshWorker(scene, offset)
+{
+	qRegisterMetaType<repo::gui::renderer::RepoStreamIndex>();
+}
+
+MeshIndexWorker::~MeshIndexWorker() {}
+
+void MeshIndexWorker::run()
+{
+	repo::gui::renderer::RepoStreamIndex index;
+
+	//-------------------------------------------------------------------------
+	// Start
+	std::map<repoUUID, int> entries;
+	if (traverseMeshes([&](const repo::core::model::MeshNode *mesh,
+		const std::vector<float> &matrix, size_t)
+		{ collectMesh(mesh, matrix, entries, index); }))
+	{
+		// Meshes without bounds cannot be placed in view
+		index.meshes.erase(std::remove_if(index.meshes.begin(), index.meshes.end(),
+			[](const repo::gui::renderer::RepoStreamIndexEntry &entry)
+			{ return entry.lower[0] > entry.upper[0]; }), index.meshes.end());
+
+		repoLog("Indexed " + std::to_string(index.meshes.size()) + " meshes for streaming");
+		emit progress(getJobsCount(), getJobsCount());
+	}
+
+	if (!cancelled)
+		emit finished(index);
+
+	//-------------------------------------------------------------------------
+	// Done
+	emit RepoAbstractWorker::finished();
+}
+
+void MeshIndexWorker::collectMesh(
+	const repo::core::model::MeshNode *meshPtr,
+	const std::vector<float> &matrix,
+	std::map<repoUUID, int> &entries,
+	repo::gui::renderer::RepoStreamIndex &index)
+{
+	auto it = entries.find(meshPtr->getSharedID());
+	if (it == entries.end())
+	{
+		repo::gui::renderer::RepoStreamIndexEntry entry;
+		entry.sharedID = meshPtr->getSharedID();
+		for (int i = 0; i < 3; ++i)
+		{
+			entry.lower[i] = std::numeric_limits<float>::max();
+			entry.upper[i] = -std::numeric_limits<float>::max();
+		}
+
+		// Keys of the material map once converted
+		auto mappings = meshPtr->getMeshMapping();
+		for (const auto &map : mappings)
+			entry.components.push_back(QString::fromStdString(UUIDtoString(map.mesh_id)));
+		if (mappings.empty())
+			entry.components.push_back(QString::fromStdString(UUIDtoString(meshPtr->getUniqueID())));
+
+		it = entries.insert(std::make_pair(entry.sharedID, (int) index.meshes.size())).first;
+		index.meshes.push_back(entry);
+	}
+
+	repo::gui::renderer::RepoStreamIndexEntry &entry = index.meshes[it->second];
+	auto mappings = meshPtr->getMeshMapping();
+	if (mappings.size() > 1)
+	{
+		for (const auto &map : mappings)
+			growBounds(entry, matrix, map.min, map.max);
+	}
+	else
+	{
+		auto currentBox = meshPtr->getBoundingBox();
+		if (currentBox.size() >= 2)
+			growBounds(entry, matrix, currentBox[0], currentBox[1]);
+	}
+
+	// Column major as taken by GLC
+	std::vector<float> placement(16);
+	for (int row = 0; row < 4; ++row)
+		for (int column = 0; column < 4; ++column)
+			placement[column * 4 + row] = matrix[row * 4 + column];
+	entry.matrices.push_back(placement);
+}
@@ -0,0 +1,89 @@
+/**
+*  Copyright (C) 2015 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Collects the placements and world bounds of all meshes of a scene without
+* touching their geometry, for streaming it in later.
+*/
+#pragma once
+
+//------------------------------------------------------------------------------
+// Core
+#include <repo/core/model/collection/repo_scene.h>
+
+//-----------------------------------------------------------------------------
+#include "repo_worker_scene_mesh.h"
+#include "../gui/renderers/repo_geometry_streamer.h"
+//-----------------------------------------------------------------------------
+
+#include <map>
+
+namespace repo {
+	namespace worker {
+
+		/*!
+		* Worker class to build the streaming index of a scene, one entry per
+		* mesh with the world matrix of each transformation above it. Only
+		* bounding boxes and mappings are read. Use with QThreadPool.
+		*/
+		class MeshIndexWorker : public SceneMeshWorker {
+
+			Q_OBJECT
+
+		public:
+
+			/*!
+			* @param scene scene to index
+			* @param offset translation applied to all placements, can be empty
+			*/
+			MeshIndexWorker(
+				const repo::core::model::RepoScene *scene,
+				const std::vector<double> &offset);
+
+			//! Default empty destructor.
+			~MeshIndexWorker();
+
+			public slots :
+
+			/*!
+			* Collects the index and emits finished with the result unless
+			* cancelled.
+			*/
+			void run();
+
+		signals:
+
+			//! Emitted with the index once all meshes are collected.
+			void finished(const repo::gui::renderer::RepoStreamIndex &index);
+
+		private:
+
+			/**
+			* Adds a placement of the mesh to its index entry.
+			* @param matrix world transformation, row major
+			* @param entries index entry of each mesh by shared ID
+			*/
+			void collectMesh(
+				const repo::core::model::MeshNode *meshPtr,
+				const std::vector<float> &matrix,
+				std::map<repoUUID, int> &entries,
+				repo::gui::renderer::RepoStreamIndex &index);
+
+		}; // end class
+
+	} // end namespace worker
+} // end namespace repo
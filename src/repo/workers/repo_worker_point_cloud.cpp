@@ -0,0 +1,160 @@
+/**
+*  Copyright (C) 2015 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "repo_worker_point_cloud.h"
+#include "../logger/repo_logger.h"
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <limits>
+#include <repo/core/model/repo_node_utils.h>
+//------------------------------------------------------------------------------
+using namespace repo::worker;
+
+//! Colour of points without colours, mid grey.
+static const unsigned char REPO_POINT_DEFAULT_COLOR = 128;
+
+//! Points transformed before they are handed to the builder.
+static const size_t REPO_POINT_BATCH_SIZE = 65536;
+
+PointCloudWorker::PointCloudWorker(
+	const repo::core::model::RepoScene *scene,
+	const std::vector<double> &offset,
+	const QString &path)
+	: SceneMeshWorker(scene, offset)
+	, path(path)
+{
+	qRegisterMetaType<repo::gui::renderer::RepoPointCloudData>();
+}
+
+PointCloudWorker::~PointCloudWorker() {}
+
+void PointCloudWorker::run()
+{
+	//-------------------------------------------------------------------------
+	// Start
+	// Bounds first so that points are sorted into the hierarchy as they are
+	// read, mesh by mesh, rather than gathered in memory
+	float lower[3], upper[3];
+	std::fill(lower, lower + 3, std::numeric_limits<float>::max());
+	std::fill(upper, upper + 3, -std::numeric_limits<float>::max());
+	if (traverseMeshes([&](const repo::core::model::MeshNode *mesh,
+		const std::vector<float> &matrix, size_t)
+		{ growBounds(mesh, matrix, lower, upper); }) && lower[0] <= upper[0])
+	{
+		repo::gui::renderer::RepoPointCloudBuilder builder(path, lower, upper);
+		bool added = true;
+		traverseMeshes([&](const repo::core::model::MeshNode *mesh,
+			const std::vector<float> &matrix, size_t)
+			{ added = added && collectPoints(mesh, matrix, builder); });
+
+		repo::gui::renderer::RepoPointCloudData data;
+		if (!cancelled && added && builder.finish(data, &cancelled))
+		{
+			repoLog("Sorted " + std::to_string(data.pointCount) + " points into "
+				+ std::to_string(data.nodes.size()) + " chunks");
+			emit finished(data);
+		}
+		else
+			QFile::remove(path);
+		emit progress(getJobsCount(), getJobsCount());
+	}
+
+	//-------------------------------------------------------------------------
+	// Done
+	emit RepoAbstractWorker::finished();
+}
+
+void PointCloudWorker::growBounds(
+	const repo::core::model::MeshNode *meshPtr,
+	const std::vector<float> &matrix,
+	float lower[3],
+	float upper[3])
+{
+	if (!meshPtr->getFaces().empty())
+		return;
+
+	// Corners of the box where there is one, otherwise every vertex
+	std::vector<repo_vector_t> corners;
+	auto box = meshPtr->getBoundingBox();
+	if (box.size() >= 2)
+	{
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			repo_vector_t v;
+			v.x = (corner & 1) ? box[1].x : box[0].x;
+			v.y = (corner & 2) ? box[1].y : box[0].y;
+			v.z = (corner & 4) ? box[1].z : box[0].z;
+			corners.push_back(v);
+		}
+	}
+	else
+		corners = meshPtr->getVertices();
+
+	for (const repo_vector_t &corner : corners)
+	{
+		const repo_vector_t v = multiplyMatVec(matrix, corner);
+		const float point[3] = { v.x, v.y, v.z };
+		for (int i = 0; i < 3; ++i)
+		{
+			lower[i] = std::min(lower[i], point[i]);
+			upper[i] = std::max(upper[i], point[i]);
+		}
+	}
+}
+
+bool PointCloudWorker::collectPoints(
+	const repo::core::model::MeshNode *meshPtr,
+	const std::vector<float> &matrix,
+	repo::gui::renderer::RepoPointCloudBuilder &builder)
+{
+	if (!meshPtr->getFaces().empty())
+		return true;
+
+	const std::vector<repo_vector_t> vertices = meshPtr->getVertices();
+	const std::vector<repo_color4d_t> colors = meshPtr->getColors();
+	const bool hasColors = colors.size() == vertices.size();
+
+	// Handed over in batches, a single scan can hold most of the points
+	std::vector<repo::gui::renderer::RepoPoint> points;
+	points.reserve(std::min(vertices.size(), REPO_POINT_BATCH_SIZE));
+	for (size_t i = 0; i < vertices.size() && !cancelled; ++i)
+	{
+		const repo_vector_t v = multiplyMatVec(matrix, vertices[i]);
+		repo::gui::renderer::RepoPoint point;
+		point.position[0] = v.x;
+		point.position[1] = v.y;
+		point.position[2] = v.z;
+		if (hasColors)
+		{
+			point.color[0] = (unsigned char)(std::max(0.0f, std::min(1.0f, colors[i].r)) * 255);
+			point.color[1] = (unsigned char)(std::max(0.0f, std::min(1.0f, colors[i].g)) * 255);
+			point.color[2] = (unsigned char)(std::max(0.0f, std::min(1.0f, colors[i].b)) * 255);
+		}
+		else
+			std::fill(point.color, point.color + 3, REPO_POINT_DEFAULT_COLOR);
+		point.color[3] = 255;
+		points.push_back(point);
+
+		if (points.size() == REPO_POINT_BATCH_SIZE || i + 1 == vertices.size())
+		{
+			if (!builder.add(points.data(), points.size()))
+				return false;
+			points.clear();
+		}
+	}
+	return true;
+}
@@ -0,0 +1,100 @@
+/**
+*  Copyright (C) 2015 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Collects the meshes without faces of a scene, i.e. point clouds, into a
+* single point hierarchy for level of detail rendering.
+*/
+#pragma once
+
+//------------------------------------------------------------------------------
+// Core
+#include <repo/core/model/collection/repo_scene.h>
+
+//-----------------------------------------------------------------------------
+#include "repo_worker_scene_mesh.h"
+#include "../gui/renderers/repo_point_cloud.h"
+//-----------------------------------------------------------------------------
+
+namespace repo {
+	namespace worker {
+
+		/*!
+		* Worker class to gather the points of every mesh without faces in
+		* world coordinates and sort them into the chunk file of a
+		* RepoPointCloud out of core. Use with QThreadPool.
+		*/
+		class PointCloudWorker : public SceneMeshWorker {
+
+			Q_OBJECT
+
+		public:
+
+			/*!
+			* @param scene scene to collect the points of
+			* @param offset translation applied to all points, can be empty
+			* @param path chunk file to write
+			*/
+			PointCloudWorker(
+				const repo::core::model::RepoScene *scene,
+				const std::vector<double> &offset,
+				const QString &path);
+
+			//! Default empty destructor.
+			~PointCloudWorker();
+
+			public slots :
+
+			/*!
+			* Collects and sorts the points and emits finished with the
+			* result unless cancelled. Nothing is emitted without points.
+			*/
+			void run();
+
+		signals:
+
+			//! Emitted with the hierarchy once the chunk file is written.
+			void finished(const repo::gui::renderer::RepoPointCloudData &data);
+
+		private:
+
+			/**
+			* Grows the bounds by the points of the mesh if it has no faces.
+			* @param matrix world transformation, row major
+			*/
+			void growBounds(
+				const repo::core::model::MeshNode *meshPtr,
+				const std::vector<float> &matrix,
+				float lower[3],
+				float upper[3]);
+
+			/**
+			* Adds the points of the mesh to the builder if it has no faces.
+			* @param matrix world transformation, row major
+			* @return returns false if the builder failed to take them
+			*/
+			bool collectPoints(
+				const repo::core::model::MeshNode *meshPtr,
+				const std::vector<float> &matrix,
+				repo::gui::renderer::RepoPointCloudBuilder &builder);
+
+			const QString path;
+
+		}; // end class
+
+	} // end namespace worker
+} // end namespace repo
@@ -0,0 +1,107 @@
+/**
+*  Copyright (C) 2015 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "repo_worker_scene_mesh.h"
+//------------------------------------------------------------------------------
+#include <repo/core/model/repo_node_utils.h>
+#include <repo/core/model/bson/repo_node_transformation.h>
+//------------------------------------------------------------------------------
+using namespace repo::worker;
+namespace repoModel = repo::core::model;
+
+SceneMeshWorker::SceneMeshWorker(
+	const repo::core::model::RepoScene *scene,
+	const std::vector<double> &offset)
+	: RepoAbstractWorker()
+	, scene(scene)
+	, offset(offset)
+	, done(0)
+	, jobsCount(0)
+{}
+
+SceneMeshWorker::~SceneMeshWorker() {}
+
+bool SceneMeshWorker::traverseMeshes(const MeshCallback &callback)
+{
+	if (cancelled || !scene || !scene->getRoot(scene->getViewGraph()))
+		return false;
+
+	auto gType = scene->getViewGraph();
+	jobsCount = scene->getItemsInCurrentGraph(gType);
+	done = 0;
+	emit progress(0, jobsCount);
+
+	std::vector<float> matrix = {
+		1, 0, 0, 0,
+		0, 1, 0, 0,
+		0, 0, 1, 0,
+		0, 0, 0, 1
+	};
+
+	if (offset.size() >= 3)
+	{
+		matrix[3] += offset[0];
+		matrix[7] += offset[1];
+		matrix[11] += offset[2];
+	}
+
+	traverse(scene->getRoot(gType), matrix, 0, callback);
+	return true;
+}
+
+void SceneMeshWorker::traverse(
+	const repo::core::model::RepoNode *node,
+	const std::vector<float> &matrix,
+	size_t level,
+	const MeshCallback &callback)
+{
+	if (!node || cancelled)
+		return;
+
+	if (++done % 1000 == 0)
+		emit progress(done, jobsCount);
+
+	switch (node->getTypeAsEnum())
+	{
+	case repoModel::NodeType::MESH:
+	{
+		auto meshPtr = dynamic_cast<const repoModel::MeshNode*>(node);
+		if (meshPtr)
+			callback(meshPtr, matrix, level);
+		break;
+	}
+	case repoModel::NodeType::TRANSFORMATION:
+	{
+		auto transPtr = dynamic_cast<const repoModel::TransformationNode*>(node);
+		if (transPtr)
+		{
+			auto newTrans = matMult(matrix, transPtr->getTransMatrix(false));
+			// Meshes sit at the level of their parent transformation
+			auto children = scene->getChildrenAsNodes(scene->getViewGraph(), transPtr->getSharedID());
+			for (const auto &child : children)
+			{
+				const bool isMesh = child->getTypeAsEnum() == repoModel::NodeType::MESH;
+				traverse(child, newTrans, isMesh ? level : level + 1, callback);
+			}
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
@@ -0,0 +1,101 @@
+/**
+*  Copyright (C) 2015 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Base of the workers that visit every mesh of a scene with its world matrix.
+*/
+#pragma once
+
+//------------------------------------------------------------------------------
+// Core
+#include <repo/core/model/collection/repo_scene.h>
+#include <repo/core/model/bson/repo_node_mesh.h>
+
+//-----------------------------------------------------------------------------
+#include "repo_worker_abstract.h"
+//-----------------------------------------------------------------------------
+
+#include <functional>
+
+namespace repo {
+	namespace worker {
+
+		/*!
+		* Abstract worker walking the view graph of a scene from its root down
+		* through the transformations, reporting progress per node visited.
+		* Subclasses implement run() and call traverseMeshes() from it.
+		*/
+		class SceneMeshWorker : public RepoAbstractWorker {
+
+			Q_OBJECT
+
+		public:
+
+			/**
+			* Called once per placement of a mesh.
+			* @param mesh mesh node
+			* @param matrix world transformation including the offset, row major
+			* @param level depth of the parent transformation below the root
+			*/
+			typedef std::function<void(
+				const repo::core::model::MeshNode *mesh,
+				const std::vector<float> &matrix,
+				size_t level)> MeshCallback;
+
+			/*!
+			* @param scene scene to traverse
+			* @param offset translation applied to all meshes, can be empty
+			*/
+			SceneMeshWorker(
+				const repo::core::model::RepoScene *scene,
+				const std::vector<double> &offset);
+
+			virtual ~SceneMeshWorker() = 0;
+
+		protected:
+
+			/**
+			* Visits all meshes of the scene unless cancelled, emitting progress
+			* from zero. Returns false if there is no scene to traverse.
+			*/
+			bool traverseMeshes(const MeshCallback &callback);
+
+			//! Number of nodes in the view graph, the progress maximum.
+			int getJobsCount() const { return jobsCount; }
+
+			const repo::core::model::RepoScene *scene;
+
+			const std::vector<double> offset;
+
+		private:
+
+			//! Recursively visits the node and its children.
+			void traverse(
+				const repo::core::model::RepoNode *node,
+				const std::vector<float> &matrix,
+				size_t level,
+				const MeshCallback &callback);
+
+			//! Number of nodes processed, for progress reporting.
+			int done;
+
+			int jobsCount;
+
+		}; // end class
+
+	} // end namespace worker
+} // end namespace repo
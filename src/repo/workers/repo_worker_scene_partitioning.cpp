@@ -0,0 +1,133 @@
+/**
+*  Copyright (C) 2015 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "repo_worker_scene_partitioning.h"
+#include "../logger/repo_logger.h"
+//------------------------------------------------------------------------------
+#include <cmath>
+//------------------------------------------------------------------------------
+using namespace repo::worker;
+
+//! Hue step between consecutive tree depths.
+static const double REPO_PARTITION_HUE_STEP = 0.13;
+
+ScenePartitioningWorker::ScenePartitioningWorker(
+	repo::RepoController *controller,
+	repo::core::model::RepoScene *scene,
+	const std::vector<double> &offset)
+	: RepoAbstractWorker()
+	, controller(controller)
+	, scene(scene)
+	, offset(offset)
+{
+	qRegisterMetaType<repo::gui::renderer::RepoLineOverlayData>();
+}
+
+ScenePartitioningWorker::~ScenePartitioningWorker() {}
+
+void ScenePartitioningWorker::run()
+{
+	repo::gui::renderer::RepoLineOverlayData data;
+
+	if (!cancelled && controller && scene)
+	{
+		//-------------------------------------------------------------------------
+		// Start
+		emit progress(0, 0); // undetermined (moving) progress bar
+
+		std::vector<repo_vector_t> sceneBbox = scene->getSceneBoundingBox();
+
+		// The partitioning itself cannot be interrupted, a cancelled result
+		// is simply dropped
+		std::shared_ptr<repo_partitioning_tree_t> tree;
+		if (!cancelled && sceneBbox.size() >= 2)
+			tree = controller->getScenePartitioning(scene);
+
+		if (!cancelled && tree)
+		{
+			std::vector<std::vector<float>> bbox = {
+				{ sceneBbox[0].x, sceneBbox[0].y, sceneBbox[0].z },
+				{ sceneBbox[1].x, sceneBbox[1].y, sceneBbox[1].z }
+			};
+
+			for (size_t i = 0; i < offset.size() && i < 3; ++i)
+			{
+				bbox[0][i] += offset[i];
+				bbox[1][i] += offset[i];
+			}
+
+			std::vector<std::vector<float>> levels;
+			collectBoxes(tree, bbox, 0, levels);
+
+			for (size_t depth = 0; depth < levels.size() && !cancelled; ++depth)
+			{
+				double hue = std::fmod(depth * REPO_PARTITION_HUE_STEP, 1.0);
+				QColor color = QColor::fromHsvF(hue, 0.9, 0.9);
+				const std::vector<float> &boxes = levels[depth];
+				for (size_t i = 0; i + 5 < boxes.size(); i += 6)
+					data.addBox(&boxes[i], &boxes[i + 3], color);
+				data.endLevel();
+			}
+
+			repoLog("Partitioning: " + std::to_string(data.vertices.size() / 72)
+				+ " boxes in " + std::to_string(levels.size()) + " levels");
+		}
+		else if (!cancelled)
+		{
+			repoLogError("Failed to partition the scene");
+		}
+
+		emit progress(1, 1);
+	}
+
+	if (!cancelled)
+		emit finished(data);
+
+	//-------------------------------------------------------------------------
+	// Done
+	emit RepoAbstractWorker::finished();
+}
+
+void ScenePartitioningWorker::collectBoxes(
+	const std::shared_ptr<repo_partitioning_tree_t> &tree,
+	const std::vector<std::vector<float>> &box,
+	const size_t &depth,
+	std::vector<std::vector<float>> &levels)
+{
+	if (!tree || cancelled)
+		return;
+
+	if (levels.size() <= depth)
+		levels.resize(depth + 1);
+	levels[depth].insert(levels[depth].end(), box[0].begin(), box[0].end());
+	levels[depth].insert(levels[depth].end(), box[1].begin(), box[1].end());
+
+	if (tree->type != repo::PartitioningTreeType::LEAF_NODE)
+	{
+		auto median = tree->pValue;
+		auto rightBox = box;
+		auto leftBox = box;
+		int axis = tree->type == repo::PartitioningTreeType::PARTITION_X ? 0 :
+			(tree->type == repo::PartitioningTreeType::PARTITION_Y ? 1 : 2);
+		double offsetAxis = (int) offset.size() > axis ? offset[axis] : 0;
+		rightBox[0][axis] = median + offsetAxis;
+		leftBox[1][axis] = median + offsetAxis;
+		collectBoxes(tree->left, leftBox, depth + 1, levels);
+		collectBoxes(tree->right, rightBox, depth + 1, levels);
+	}
+}
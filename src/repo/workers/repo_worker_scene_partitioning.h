@@ -0,0 +1,94 @@
+/**
+*  Copyright (C) 2015 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Computes the spatial partitioning of a scene and its wireframe overlay.
+*/
+#pragma once
+
+//------------------------------------------------------------------------------
+// Core
+#include <repo/repo_controller.h>
+
+//-----------------------------------------------------------------------------
+#include "repo_worker_abstract.h"
+#include "../gui/renderers/repo_line_overlay.h"
+//-----------------------------------------------------------------------------
+
+namespace repo {
+	namespace worker {
+
+		/*!
+		* Worker class to partition a scene off the GUI thread and turn the
+		* partitioning tree into a single line list with one level per tree
+		* depth, coloured by depth. Use with QThreadPool.
+		*/
+		class ScenePartitioningWorker : public RepoAbstractWorker {
+
+			Q_OBJECT
+
+		public:
+
+			/*!
+			* @param controller controller to the core library
+			* @param scene scene to partition
+			* @param offset translation applied to all boxes, can be empty
+			*/
+			ScenePartitioningWorker(
+				repo::RepoController *controller,
+				repo::core::model::RepoScene *scene,
+				const std::vector<double> &offset);
+
+			//! Default empty destructor.
+			~ScenePartitioningWorker();
+
+			public slots :
+
+			/*!
+			* Partitions the scene and emits finished with the overlay unless
+			* cancelled.
+			*/
+			void run();
+
+		signals:
+
+			//! Emitted with the partition boxes once finished.
+			void finished(const repo::gui::renderer::RepoLineOverlayData &data);
+
+		private:
+
+			/**
+			* Recursively collects boxes of the tree node and its children.
+			* @param box lower and upper corner of the node
+			* @param depth depth of the node in the tree
+			*/
+			void collectBoxes(
+				const std::shared_ptr<repo_partitioning_tree_t> &tree,
+				const std::vector<std::vector<float>> &box,
+				const size_t &depth,
+				std::vector<std::vector<float>> &levels);
+
+			repo::RepoController *controller;
+
+			repo::core::model::RepoScene *scene;
+
+			const std::vector<double> offset;
+
+		}; // end class
+
+	} // end namespace worker
+} // end namespace repo